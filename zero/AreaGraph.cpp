@@ -0,0 +1,464 @@
+#include "AreaGraph.h"
+
+#include <zero/path/WallDistanceField.h>
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+namespace zero {
+
+// Areas smaller than this are always merged into their neighbor, so small nooks don't become their own area.
+constexpr u32 kMinAreaTiles = 128;
+// Two areas are merged if the tile that joins them is at least this open compared to the smaller area's peak.
+constexpr float kMergeRatio = 0.9f;
+// Openings this far from the walls are too wide to be a chokepoint no matter how large the areas are. Single solid tiles
+// in open space would otherwise split it into areas around them.
+constexpr float kMaxChokepointDistance = 8.0f;
+// Chokepoint tiles between the same areas that are this close are part of the same chokepoint.
+constexpr s32 kChokepointGap = 2;
+// Wormholes and spawn points can be in tiles the ship doesn't fit in, so the closest area around them is used.
+constexpr s32 kWormholeReach = 4;
+constexpr s32 kSpawnReach = 8;
+
+namespace {
+
+struct BuildArea {
+  MapCoord peak;
+  float peak_distance;
+  u32 tile_count;
+  RegionIndex region;
+};
+
+struct Frontier {
+  AreaIndex first;
+  AreaIndex second;
+  u32 tile;
+  float distance;
+};
+
+}  // namespace
+
+void AreaGraph::Build(const Map& map, const RegionRegistry& regions, const path::WallDistanceField& distances) {
+  tile_areas_.Clear();
+  areas_.clear();
+  edges_.clear();
+  chokepoint_count_ = 0;
+  wormholes_.clear();
+  built_ = false;
+
+  if (!map.tiles || !distances.IsBuilt()) return;
+
+  std::vector<u32> tiles;
+
+  for (const RegionDescriptor& descriptor : regions.GetDescriptors()) {
+    descriptor.ForEachTile([&tiles](MapCoord coord) { tiles.push_back((u32)coord.y * 1024 + coord.x); });
+  }
+
+  auto get_distance = [&distances](u32 tile) { return distances.GetDistance(tile % 1024, tile / 1024); };
+
+  std::sort(tiles.begin(), tiles.end(), [&get_distance](u32 a, u32 b) {
+    float distance_a = get_distance(a);
+    float distance_b = get_distance(b);
+
+    if (distance_a != distance_b) return distance_a > distance_b;
+
+    return a < b;
+  });
+
+  std::vector<AreaIndex> labels(1024 * 1024, kUndefinedArea);
+  std::vector<BuildArea> build_areas;
+  std::vector<AreaIndex> parents;
+  std::vector<Frontier> frontiers;
+
+  auto find = [&parents](AreaIndex index) {
+    while (parents[index] != index) {
+      parents[index] = parents[parents[index]];
+      index = parents[index];
+    }
+
+    return index;
+  };
+
+  for (u32 tile : tiles) {
+    u16 x = tile % 1024;
+    u16 y = tile / 1024;
+    float distance = get_distance(tile);
+    RegionIndex region = regions.GetRegionIndex(MapCoord(x, y));
+
+    AreaIndex neighbors[4];
+    size_t neighbor_count = 0;
+
+    const s32 kOffsets[][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+    for (const auto& offset : kOffsets) {
+      s32 neighbor_x = x + offset[0];
+      s32 neighbor_y = y + offset[1];
+
+      if (neighbor_x < 0 || neighbor_y < 0 || neighbor_x >= 1024 || neighbor_y >= 1024) continue;
+
+      AreaIndex label = labels[(size_t)neighbor_y * 1024 + neighbor_x];
+
+      if (label == kUndefinedArea) continue;
+      if (regions.GetRegionIndex(MapCoord((u16)neighbor_x, (u16)neighbor_y)) != region) continue;
+
+      AreaIndex root = find(label);
+
+      if (std::find(neighbors, neighbors + neighbor_count, root) == neighbors + neighbor_count) {
+        neighbors[neighbor_count++] = root;
+      }
+    }
+
+    if (neighbor_count == 0) {
+      AreaIndex index = (AreaIndex)build_areas.size();
+
+      build_areas.push_back({MapCoord(x, y), distance, 1, region});
+      parents.push_back(index);
+      labels[tile] = index;
+      continue;
+    }
+
+    // The largest area absorbs the others, so it's checked against each of them.
+    std::sort(neighbors, neighbors + neighbor_count, [&build_areas](AreaIndex a, AreaIndex b) {
+      return build_areas[a].tile_count > build_areas[b].tile_count;
+    });
+
+    AreaIndex area = neighbors[0];
+
+    for (size_t i = 1; i < neighbor_count; ++i) {
+      BuildArea& first = build_areas[area];
+      BuildArea& second = build_areas[neighbors[i]];
+
+      u32 smaller_count = std::min(first.tile_count, second.tile_count);
+      float smaller_peak = std::min(first.peak_distance, second.peak_distance);
+
+      if (smaller_count < kMinAreaTiles || distance >= kMaxChokepointDistance ||
+          distance >= smaller_peak * kMergeRatio) {
+        parents[neighbors[i]] = area;
+        first.tile_count += second.tile_count;
+
+        if (second.peak_distance > first.peak_distance) {
+          first.peak = second.peak;
+          first.peak_distance = second.peak_distance;
+        }
+      } else {
+        frontiers.push_back({area, neighbors[i], tile, distance});
+      }
+    }
+
+    labels[tile] = area;
+    ++build_areas[area].tile_count;
+  }
+
+  // Give the final areas indexes in scan order so they're stable between builds.
+  std::vector<AreaIndex> area_indexes(build_areas.size(), kUndefinedArea);
+
+  for (const RegionDescriptor& descriptor : regions.GetDescriptors()) {
+    descriptor.ForEachTile([&](MapCoord coord) {
+      AreaIndex root = find(labels[(size_t)coord.y * 1024 + coord.x]);
+
+      if (area_indexes[root] == kUndefinedArea) {
+        const BuildArea& build_area = build_areas[root];
+        Area area;
+
+        area.index = (AreaIndex)areas_.size();
+        area.region = build_area.region;
+        area.peak = build_area.peak;
+        area.peak_distance = build_area.peak_distance;
+        area.min = MapCoord(1023, 1023);
+
+        area_indexes[root] = area.index;
+        areas_.push_back(area);
+      }
+
+      Area& area = areas_[area_indexes[root]];
+
+      ++area.tile_count;
+      area.min.x = std::min(area.min.x, coord.x);
+      area.min.y = std::min(area.min.y, coord.y);
+      area.max.x = std::max(area.max.x, coord.x);
+      area.max.y = std::max(area.max.y, coord.y);
+
+      tile_areas_.Set(coord.x, coord.y, area.index);
+    });
+  }
+
+  // Areas that were separated when the frontier was found might have been merged later.
+  for (Frontier& frontier : frontiers) {
+    AreaIndex first = area_indexes[find(frontier.first)];
+    AreaIndex second = area_indexes[find(frontier.second)];
+
+    frontier.first = std::min(first, second);
+    frontier.second = std::max(first, second);
+  }
+
+  frontiers.erase(std::remove_if(frontiers.begin(), frontiers.end(),
+                                 [](const Frontier& frontier) { return frontier.first == frontier.second; }),
+                  frontiers.end());
+
+  std::sort(frontiers.begin(), frontiers.end(), [](const Frontier& a, const Frontier& b) {
+    if (a.first != b.first) return a.first < b.first;
+    if (a.second != b.second) return a.second < b.second;
+    return a.tile < b.tile;
+  });
+
+  // Two areas can be joined by more than one passage, so the frontier tiles between them are grouped by distance.
+  size_t group_start = 0;
+
+  while (group_start < frontiers.size()) {
+    size_t group_end = group_start + 1;
+
+    while (group_end < frontiers.size() && frontiers[group_end].first == frontiers[group_start].first &&
+           frontiers[group_end].second == frontiers[group_start].second) {
+      ++group_end;
+    }
+
+    size_t count = group_end - group_start;
+    std::vector<u32> cluster_parents(count);
+
+    for (u32 i = 0; i < (u32)count; ++i) {
+      cluster_parents[i] = i;
+    }
+
+    auto find_cluster = [&cluster_parents](u32 index) {
+      while (cluster_parents[index] != index) {
+        cluster_parents[index] = cluster_parents[cluster_parents[index]];
+        index = cluster_parents[index];
+      }
+
+      return index;
+    };
+
+    // The tiles are sorted by row, so only the next few rows need to be checked.
+    for (size_t i = 0; i < count; ++i) {
+      u32 tile = frontiers[group_start + i].tile;
+      s32 x = tile % 1024;
+      s32 y = tile / 1024;
+
+      for (size_t j = i + 1; j < count; ++j) {
+        u32 other_tile = frontiers[group_start + j].tile;
+        s32 other_x = other_tile % 1024;
+        s32 other_y = other_tile / 1024;
+
+        if (other_y - y > kChokepointGap) break;
+        if (std::abs(other_x - x) > kChokepointGap) continue;
+
+        u32 a = find_cluster((u32)i);
+        u32 b = find_cluster((u32)j);
+
+        if (a != b) {
+          cluster_parents[std::max(a, b)] = std::min(a, b);
+        }
+      }
+    }
+
+    std::unordered_map<u32, size_t> cluster_edges;
+
+    for (size_t i = 0; i < count; ++i) {
+      const Frontier& frontier = frontiers[group_start + i];
+      u32 cluster = find_cluster((u32)i);
+      MapCoord coord(frontier.tile % 1024, frontier.tile / 1024);
+
+      auto iter = cluster_edges.find(cluster);
+
+      if (iter == cluster_edges.end()) {
+        cluster_edges[cluster] = edges_.size();
+        edges_.push_back({AreaEdgeType::Chokepoint, frontier.first, frontier.second, coord, coord,
+                          frontier.distance * 2.0f, 1});
+        continue;
+      }
+
+      AreaEdge& edge = edges_[iter->second];
+
+      // The center of the passage is the tile that is farthest from the walls.
+      if (frontier.distance * 2.0f > edge.width) {
+        edge.position = coord;
+        edge.destination = coord;
+        edge.width = frontier.distance * 2.0f;
+      }
+
+      ++edge.tile_count;
+    }
+
+    group_start = group_end;
+  }
+
+  chokepoint_count_ = edges_.size();
+
+  for (u32 i = 0; i < (u32)edges_.size(); ++i) {
+    areas_[edges_[i].from].edges.push_back(i);
+    areas_[edges_[i].to].edges.push_back(i);
+  }
+
+  for (u16 y = 0; y < 1024; ++y) {
+    for (u16 x = 0; x < 1024; ++x) {
+      if (map.GetTileId(x, y) != kTileIdWormhole) continue;
+
+      AreaIndex area = FindNearbyArea(MapCoord(x, y), kWormholeReach);
+
+      if (area != kUndefinedArea) {
+        wormholes_.push_back({MapCoord(x, y), area});
+      }
+    }
+  }
+
+  BuildTeleportEdges();
+
+  built_ = true;
+}
+
+void AreaGraph::SetTeleportDestinations(const std::vector<MapCoord>& destinations) {
+  destinations_ = destinations;
+
+  edges_.resize(chokepoint_count_);
+
+  for (Area& area : areas_) {
+    auto end = std::remove_if(area.edges.begin(), area.edges.end(),
+                              [this](u32 edge_index) { return edge_index >= chokepoint_count_; });
+
+    area.edges.erase(end, area.edges.end());
+  }
+
+  BuildTeleportEdges();
+}
+
+AreaIndex AreaGraph::GetAreaIndex(MapCoord coord) const {
+  if (coord.x >= 1024 || coord.y >= 1024) return kUndefinedArea;
+
+  return tile_areas_.Get(coord.x, coord.y);
+}
+
+bool AreaGraph::FindPath(MapCoord start, MapCoord goal, bool use_teleports, std::vector<u32>& edges) const {
+  constexpr u32 kNoEdge = 0xFFFFFFFF;
+
+  edges.clear();
+
+  AreaIndex start_area = GetAreaIndex(start);
+  AreaIndex goal_area = GetAreaIndex(goal);
+
+  if (start_area == kUndefinedArea || goal_area == kUndefinedArea) return false;
+  if (start_area == goal_area) return true;
+
+  std::vector<float> costs(areas_.size(), std::numeric_limits<float>::max());
+  std::vector<MapCoord> entries(areas_.size());
+  std::vector<u32> previous_edges(areas_.size(), kNoEdge);
+
+  using Node = std::pair<float, AreaIndex>;
+  std::priority_queue<Node, std::vector<Node>, std::greater<Node>> openset;
+
+  costs[start_area] = 0.0f;
+  entries[start_area] = start;
+  openset.push(Node(0.0f, start_area));
+
+  while (!openset.empty()) {
+    Node node = openset.top();
+    openset.pop();
+
+    AreaIndex area = node.second;
+
+    if (area == goal_area) break;
+    if (node.first > costs[area]) continue;
+
+    for (u32 edge_index : areas_[area].edges) {
+      const AreaEdge& edge = edges_[edge_index];
+
+      if (edge.type == AreaEdgeType::Teleport && (!use_teleports || edge.to == kUndefinedArea)) continue;
+
+      AreaIndex next = edge.GetOther(area);
+      float cost = node.first + entries[area].ToVector().Distance(edge.position.ToVector());
+
+      if (cost < costs[next]) {
+        costs[next] = cost;
+        entries[next] = edge.destination;
+        previous_edges[next] = edge_index;
+        openset.push(Node(cost, next));
+      }
+    }
+  }
+
+  if (previous_edges[goal_area] == kNoEdge) return false;
+
+  for (AreaIndex area = goal_area; area != start_area;) {
+    u32 edge_index = previous_edges[area];
+
+    edges.push_back(edge_index);
+    area = edges_[edge_index].GetOther(area);
+  }
+
+  std::reverse(edges.begin(), edges.end());
+
+  return true;
+}
+
+size_t AreaGraph::GetMemoryUsage() const {
+  size_t size = sizeof(*this) - sizeof(tile_areas_) + tile_areas_.GetMemoryUsage();
+
+  size += areas_.capacity() * sizeof(Area);
+  size += edges_.capacity() * sizeof(AreaEdge);
+  size += wormholes_.capacity() * sizeof(Wormhole);
+  size += destinations_.capacity() * sizeof(MapCoord);
+
+  for (const Area& area : areas_) {
+    size += area.edges.capacity() * sizeof(u32);
+  }
+
+  return size;
+}
+
+AreaIndex AreaGraph::FindNearbyArea(MapCoord coord, s32 reach) const {
+  AreaIndex best_area = kUndefinedArea;
+  s32 best_distance_sq = std::numeric_limits<s32>::max();
+
+  for (s32 y = (s32)coord.y - reach; y <= (s32)coord.y + reach; ++y) {
+    for (s32 x = (s32)coord.x - reach; x <= (s32)coord.x + reach; ++x) {
+      if (x < 0 || y < 0 || x >= 1024 || y >= 1024) continue;
+
+      AreaIndex area = tile_areas_.Get((u16)x, (u16)y);
+
+      if (area == kUndefinedArea) continue;
+
+      s32 distance_sq = (x - coord.x) * (x - coord.x) + (y - coord.y) * (y - coord.y);
+
+      if (distance_sq < best_distance_sq) {
+        best_distance_sq = distance_sq;
+        best_area = area;
+      }
+    }
+  }
+
+  return best_area;
+}
+
+void AreaGraph::BuildTeleportEdges() {
+  for (const Wormhole& wormhole : wormholes_) {
+    std::vector<AreaIndex> destination_areas;
+
+    for (MapCoord destination : destinations_) {
+      AreaIndex area = FindNearbyArea(destination, kSpawnReach);
+
+      if (area == kUndefinedArea) continue;
+      if (std::find(destination_areas.begin(), destination_areas.end(), area) != destination_areas.end()) continue;
+
+      destination_areas.push_back(area);
+      AddEdge({AreaEdgeType::Teleport, wormhole.area, area, wormhole.position, destination, 0.0f, 1});
+    }
+
+    if (destination_areas.empty()) {
+      AddEdge({AreaEdgeType::Teleport, wormhole.area, kUndefinedArea, wormhole.position, wormhole.position, 0.0f, 1});
+    }
+  }
+}
+
+void AreaGraph::AddEdge(const AreaEdge& edge) {
+  u32 index = (u32)edges_.size();
+
+  edges_.push_back(edge);
+  areas_[edge.from].edges.push_back(index);
+
+  if (edge.type == AreaEdgeType::Chokepoint) {
+    areas_[edge.to].edges.push_back(index);
+  }
+}
+
+}  // namespace zero
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <zero/RegionRegistry.h>
+#include <zero/TileGrid.h>
+#include <zero/Types.h>
+#include <zero/game/Map.h>
+
+#include <vector>
+
+namespace zero {
+
+namespace path {
+class WallDistanceField;
+}  // namespace path
+
+using AreaIndex = u32;
+
+constexpr static AreaIndex kUndefinedArea = -1;
+
+enum class AreaEdgeType { Chokepoint, Teleport };
+
+// A connection between two areas.
+// Chokepoints are the narrowest tiles between two areas of the same region and can be crossed in either direction.
+// Teleports start at a wormhole and only go one way. A wormhole respawns the ship, so it has an edge to every area that
+// the ship can spawn in, or a single edge without a destination if the spawn areas aren't known.
+struct AreaEdge {
+  AreaEdgeType type;
+  AreaIndex from;
+  AreaIndex to;
+  // The center of the chokepoint or the wormhole tile.
+  MapCoord position;
+  // Where the ship ends up after crossing. This is the position for chokepoints and the spawn point for teleports.
+  MapCoord destination;
+  // The approximate number of tiles across the chokepoint. This is zero for teleports.
+  float width;
+  u32 tile_count;
+
+  inline AreaIndex GetOther(AreaIndex area) const { return area == from ? to : from; }
+};
+
+// A part of a region that is bounded by walls and chokepoints, such as a room or a base.
+struct Area {
+  AreaIndex index = kUndefinedArea;
+  RegionIndex region = kUndefinedRegion;
+  // The tile that is farthest from any wall.
+  MapCoord peak;
+  float peak_distance = 0.0f;
+  u32 tile_count = 0;
+  MapCoord min;
+  MapCoord max;
+  // The indexes of the edges that touch this area. Teleports are only listed in the area they start in.
+  std::vector<u32> edges;
+};
+
+// Splits each region into areas at its chokepoints and connects them into a graph, so routing between parts of the map
+// and finding bases can be done on a few nodes instead of flooding tiles.
+// Tiles are added from the farthest from walls to the closest. Each new tile joins the area next to it, and when it
+// touches two areas they're only merged if the tile is nearly as open as the smaller area's peak. Otherwise the tile is
+// part of the chokepoint between them.
+class AreaGraph {
+ public:
+  AreaGraph() : tile_areas_(kUndefinedArea) {}
+
+  // Builds the areas from the registry's regions. This is slow, so it's done with the graph build.
+  void Build(const Map& map, const RegionRegistry& regions, const path::WallDistanceField& distances);
+
+  // Replaces the teleport edges with ones that lead to the areas around each position. These are the spawn points that
+  // a wormhole can send the ship to.
+  void SetTeleportDestinations(const std::vector<MapCoord>& destinations);
+
+  AreaIndex GetAreaIndex(MapCoord coord) const;
+
+  inline const Area* GetArea(AreaIndex index) const {
+    if (index >= areas_.size()) return nullptr;
+    return &areas_[index];
+  }
+
+  inline const Area* GetArea(MapCoord coord) const { return GetArea(GetAreaIndex(coord)); }
+
+  inline const std::vector<Area>& GetAreas() const { return areas_; }
+  inline const std::vector<AreaEdge>& GetEdges() const { return edges_; }
+
+  // Finds the shortest list of edges to cross to get from the start's area to the goal's area. The cost of each step is
+  // the distance from where the ship entered the area to the next edge.
+  // Teleports are skipped unless requested, since the ship can spawn in any of their destinations.
+  // Returns false if the goal can't be reached.
+  bool FindPath(MapCoord start, MapCoord goal, bool use_teleports, std::vector<u32>& edges) const;
+
+  inline bool IsBuilt() const { return built_; }
+
+  size_t GetMemoryUsage() const;
+
+ private:
+  struct Wormhole {
+    MapCoord position;
+    AreaIndex area;
+  };
+
+  // Returns the area of the closest tile that has one within the reach, since wormholes and spawn points can be in
+  // tiles that the ship can't fit in.
+  AreaIndex FindNearbyArea(MapCoord coord, s32 reach) const;
+
+  void BuildTeleportEdges();
+  void AddEdge(const AreaEdge& edge);
+
+  SparseTileGrid<AreaIndex> tile_areas_;
+  std::vector<Area> areas_;
+
+  // Chokepoints come first so the teleports can be replaced without touching them.
+  std::vector<AreaEdge> edges_;
+  size_t chokepoint_count_ = 0;
+
+  std::vector<Wormhole> wormholes_;
+  std::vector<MapCoord> destinations_;
+
+  bool built_ = false;
+};
+
+}  // namespace zero
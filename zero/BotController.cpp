@@ -1,17 +1,44 @@
 #include "BotController.h"
 
+#include <zero/AreaGraph.h>
 #include <zero/Utility.h>
 #include <zero/behavior/BehaviorBuilder.h>
 #include <zero/behavior/BehaviorTree.h>
 #include <zero/game/Logger.h>
 
+#include <algorithm>
+
 namespace zero {
 
-BotController::BotController(Game& game) : game(game), chat_queue(game.chat), energy_tracker(game.player_manager) {
+// The influence map is populated by the behavior tree every tick, but searches only need it to be roughly current.
+constexpr s32 kThreatUpdateTicks = 10;
+
+// Returns the center of each team's spawn area. This matches how PlayerManager::Spawn places the ship.
+static std::vector<MapCoord> GetSpawnCenters(const ArenaSettings& settings) {
+  std::vector<MapCoord> centers;
+
+  for (size_t i = 0; i < ZERO_ARRAY_SIZE(settings.SpawnSettings); ++i) {
+    const SpawnSettings& spawn = settings.SpawnSettings[i];
+
+    if (spawn.X == 0 && spawn.Y == 0 && spawn.Radius == 0) continue;
+
+    s32 x = spawn.X == 0 ? 512 : (spawn.X < 0 ? spawn.X + 1024 : spawn.X);
+    s32 y = spawn.Y == 0 ? 512 : (spawn.Y < 0 ? spawn.Y + 1024 : spawn.Y);
+
+    centers.emplace_back((u16)x, (u16)y);
+  }
+
+  return centers;
+}
+
+BotController::BotController(Game& game)
+    : game(game), graph_pool(game), chat_queue(game.chat), energy_tracker(game.player_manager) {
   this->input = nullptr;
 
   this->enable_dynamic_path = true;
   this->door_solid_method = path::DoorSolidMethod::Dynamic;
+  this->threat_weight = 0.0f;
+  this->threat_replan_threshold = 100.0f;
 }
 
 void BotController::HandleEvent(const JoinGameEvent& event) {
@@ -19,11 +46,15 @@ void BotController::HandleEvent(const JoinGameEvent& event) {
 
   behaviors.Clear();
 
-  // Clear the pathfinder so it will rebuild on ship change.
-  pathfinder = nullptr;
+  // Clear the pathfinder so it will be swapped in again once the new map loads.
+  // The pool keeps the old graphs so they can be reused if the new arena has the same map.
+  DetachGraph();
+  pending_radius_ = 0.0f;
 
   this->enable_dynamic_path = true;
   this->door_solid_method = path::DoorSolidMethod::Dynamic;
+  this->threat_weight = 0.0f;
+  this->threat_replan_threshold = 100.0f;
 }
 
 void BotController::HandleEvent(const PlayerEnterEvent& event) {
@@ -37,12 +68,29 @@ void BotController::HandleEvent(const PlayerEnterEvent& event) {
   float radius = game.connection.settings.ShipSettings[event.player.ship].GetRadius();
 
   current_path.Clear();
+  CancelPathRequest();
 
   Log(LogLevel::Debug, "Creating pathfinder from enter event.");
   UpdatePathfinder(radius);
 }
 
 void BotController::HandleEvent(const MapLoadEvent& event) {
+  // The map can load before the join event, and prebuilding a different map frees the graphs we still point at.
+  DetachGraph();
+
+  // Start building the graph for every ship in the background so ship changes don't have to wait for them.
+  std::vector<float> radii;
+
+  for (size_t i = 0; i < 8; ++i) {
+    float radius = game.connection.settings.ShipSettings[i].GetRadius();
+
+    if (std::find(radii.begin(), radii.end(), radius) == radii.end()) {
+      radii.push_back(radius);
+    }
+  }
+
+  graph_pool.Prebuild(event.map, radii);
+
   // Send a request for the arena list so we can know the name of the current arena.
   game.chat.SendMessage(ChatType::Public, "?arena");
 }
@@ -54,53 +102,141 @@ void BotController::HandleEvent(const PlayerFreqAndShipChangeEvent& event) {
   float radius = game.connection.settings.ShipSettings[event.new_ship].GetRadius();
 
   current_path.Clear();
+  CancelPathRequest();
 
   UpdatePathfinder(radius);
 }
 
-void BotController::UpdatePathfinder(float radius) {
+void BotController::DetachGraph() {
+  current_path.Clear();
+  CancelPathRequest();
+
+  // Swap the same radius back in once the new graphs are ready.
+  if (pathfinder && pending_radius_ == 0.0f) {
+    pending_radius_ = pathfinder->config.ship_radius;
+  }
+
+  pathfinder = nullptr;
+  region_registry = nullptr;
+  graph_pool.WaitForBuilds();
+}
+
+void BotController::CancelPathRequest() {
+  if (path_request) {
+    path_request->Cancel();
+    path_request = nullptr;
+  }
+}
+
+void BotController::UpdatePathfinder(float radius, bool wait) {
   if (pathfinder && pathfinder->config.ship_radius == radius) {
+    pending_radius_ = 0.0f;
     pathfinder->SetDoorSolidMethod(door_solid_method);
     return;
   }
 
-  Log(LogLevel::Info, "Creating new registry and pathfinder.");
+  // The map for a new arena might not be loaded yet, so wait for the builds that start once it is.
+  if (game.connection.login_state != Connection::LoginState::Complete) {
+    pending_radius_ = radius;
+    return;
+  }
 
-  auto processor = std::make_unique<path::NodeProcessor>(game);
+  const Map& map = game.GetMap();
+  path::GraphPool::Graph* graph = wait ? graph_pool.Wait(map, radius) : graph_pool.Get(map, radius);
 
-  region_registry = std::make_unique<RegionRegistry>();
-  region_registry->CreateAll(game.GetMap(), radius);
+  if (!graph) {
+    if (pending_radius_ != radius) {
+      Log(LogLevel::Info, "Pathfinder for radius %f is still building. Using steering until it's ready.", radius);
+    }
 
-  pathfinder = std::make_unique<path::Pathfinder>(std::move(processor), *region_registry);
+    pending_radius_ = radius;
+    return;
+  }
 
-  path::Pathfinder::WeightConfig cfg = {};
+  ActivateGraph(*graph);
+}
+
+void BotController::ActivateGraph(path::GraphPool::Graph& graph) {
+  CancelPathRequest();
+  current_path.Clear();
 
-  cfg.ship_radius = radius;
-  cfg.wall_distance = 5;
-  cfg.weight_type = path::Pathfinder::WeightType::Exponential;
+  pathfinder = graph.pathfinder.get();
+  region_registry = graph.region_registry.get();
+  pending_radius_ = 0.0f;
 
-  pathfinder->CreateMapWeights(game.temp_arena, game.GetMap(), cfg);
+  // Doors might have changed while this graph wasn't active, and bricks might have dropped before it was ready.
+  pathfinder->MarkDynamicNodes();
+  pathfinder->SetBricks(game.brick_manager);
   pathfinder->SetDoorSolidMethod(door_solid_method);
+  pathfinder->SetThreatLayer(threat_grid_, threat_weight);
+
+  region_registry->UpdateDoors(game.GetMap());
+  // Wormholes respawn the ship, so the spawn settings decide where their teleport edges lead.
+  region_registry->GetAreaGraph().SetTeleportDestinations(GetSpawnCenters(game.connection.settings));
+  region_registry->DispatchEvents();
+}
+
+void BotController::UpdateThreatLayer() {
+  if (threat_weight <= 0.0f) {
+    if (threat_grid_) {
+      threat_grid_ = nullptr;
+      pathfinder->SetThreatLayer(nullptr, 0.0f);
+    }
+
+    return;
+  }
+
+  Tick tick = GetCurrentTick();
+
+  if (threat_grid_ && TICK_DIFF(tick, last_threat_tick_) < kThreatUpdateTicks) return;
+
+  last_threat_tick_ = tick;
+
+  // Searches on the request threads can still be reading the old grid, so a new one is built instead of reusing it.
+  auto grid = std::make_shared<path::ThreatGrid>();
+
+  grid->Build(influence_map);
+
+  // Only the part of the path that hasn't been traveled yet matters, so it's checked from the current point.
+  if (!current_path.Empty() &&
+      grid->GetPathThreat(current_path, current_path.index) > current_path.threat + threat_replan_threshold) {
+    Log(LogLevel::Debug, "Clearing path because the threat along it increased.");
+    CancelPathRequest();
+    current_path.Clear();
+  }
+
+  pathfinder->SetThreatLayer(grid, threat_weight);
+  threat_grid_ = std::move(grid);
 }
 
 void BotController::HandleEvent(const DoorToggleEvent& event) {
   if (pathfinder) {
-    pathfinder->GetProcessor().MarkDynamicNodes();
+    pathfinder->MarkDynamicNodes();
+  }
+
+  if (region_registry) {
+    region_registry->UpdateDoors(game.GetMap());
   }
 
   if (enable_dynamic_path && current_path.dynamic) {
     Log(LogLevel::Debug, "Clearing current path from door update.");
     current_path.Clear();
   }
+
+  // The pending search might have started before the door changed. Time expanded searches already predicted it.
+  if (enable_dynamic_path && path_request && path_request->GetMode() != path::Pathfinder::SearchMode::TimeExpanded) {
+    CancelPathRequest();
+  }
 }
 
 void BotController::HandleEvent(const BrickTileEvent& event) {
   auto self = game.player_manager.GetSelf();
   if (!self || self->ship >= 8) return;
 
-  if (pathfinder) {
-    pathfinder->SetBrickNode(event.brick.tile.x, event.brick.tile.y, true);
-  }
+  // Every built graph is kept up to date so it has the bricks if the ship changes.
+  graph_pool.ForEachReady([&event](path::GraphPool::Graph& graph) {
+    graph.pathfinder->SetBrick(event.brick.tile.x, event.brick.tile.y, event.brick.team);
+  });
 
   s32 x = event.brick.tile.x;
   s32 y = event.brick.tile.y;
@@ -109,17 +245,23 @@ void BotController::HandleEvent(const BrickTileEvent& event) {
     Log(LogLevel::Debug, "Clearing current path from brick drop.");
     current_path.Clear();
   }
+
+  if (event.brick.team != self->frequency) {
+    CancelPathRequest();
+  }
 }
 
 void BotController::HandleEvent(const BrickTileClearEvent& event) {
-  if (pathfinder) {
-    pathfinder->SetBrickNode(event.brick.tile.x, event.brick.tile.y, false);
-  }
+  graph_pool.ForEachReady([&event](path::GraphPool::Graph& graph) {
+    graph.pathfinder->ClearBrick(event.brick.tile.x, event.brick.tile.y);
+  });
 
   if (current_path.dynamic) {
     Log(LogLevel::Debug, "Clearing current path from brick clear.");
     current_path.Clear();
   }
+
+  CancelPathRequest();
 }
 
 void BotController::HandleEvent(const LoginResponseEvent& event) {
@@ -137,6 +279,23 @@ void BotController::Update(RenderContext& rc, float dt, InputState& input, behav
 
   steering.Reset();
 
+  if (IsPathfinderPending()) {
+    UpdatePathfinder(pending_radius_);
+  }
+
+  if (pathfinder) {
+    // Keep the door prediction in sync with the doors for time expanded searches.
+    pathfinder->UpdateDoorSchedule(game.GetMap(), game.connection.settings);
+
+    auto self = game.player_manager.GetSelf();
+
+    if (self && self->ship < 8) {
+      float speed = game.connection.settings.ShipSettings[self->ship].InitialSpeed / 10.0f / 16.0f;
+
+      pathfinder->SetTravelSpeed(speed);
+    }
+  }
+
   execute_ctx.blackboard.Set("world_camera", game.camera);
   execute_ctx.blackboard.Set("ui_camera", game.ui_camera);
 
@@ -166,6 +325,8 @@ void BotController::Update(RenderContext& rc, float dt, InputState& input, behav
       tree_printer.Render(rc);
       tree_printer.Reset();
     }
+
+    UpdateThreatLayer();
   }
 
   actuator.Update(game, input, steering.force, steering.rotation, steering.rotation_threshold);
@@ -9,6 +9,7 @@
 #include <zero/behavior/Behavior.h>
 #include <zero/game/Game.h>
 #include <zero/game/GameEvent.h>
+#include <zero/path/GraphPool.h>
 #include <zero/path/Pathfinder.h>
 
 #include <memory>
@@ -38,8 +39,10 @@ struct BotController : EventHandler<PlayerFreqAndShipChangeEvent>,
                        EventHandler<BrickTileClearEvent> {
   Game& game;
 
-  std::unique_ptr<path::Pathfinder> pathfinder;
-  std::unique_ptr<RegionRegistry> region_registry;
+  // The graph for the current ship radius. These are owned by the graph pool.
+  path::Pathfinder* pathfinder = nullptr;
+  RegionRegistry* region_registry = nullptr;
+  path::GraphPool graph_pool;
   std::string behavior_name;
   InputState* input;
   InputState last_input = {};
@@ -49,12 +52,19 @@ struct BotController : EventHandler<PlayerFreqAndShipChangeEvent>,
   Steering steering;
   Actuator actuator;
   path::Path current_path;
+  // The search that will replace current_path once it finishes.
+  path::Pathfinder::PathRequestHandle path_request;
 
   bool enable_dynamic_path;
   path::DoorSolidMethod door_solid_method;
 
   HeuristicEnergyTracker energy_tracker;
   InfluenceMap influence_map;
+  // How much each unit of influence adds to the cost of entering a tile in path searches. Zero disables the threat
+  // layer. Behaviors that populate the influence map can set this to path around enemy fire.
+  float threat_weight;
+  // The current path is searched again once the threat ahead of it rises this far above the threat it was found with.
+  float threat_replan_threshold;
 
   std::string default_arena;
 
@@ -62,7 +72,13 @@ struct BotController : EventHandler<PlayerFreqAndShipChangeEvent>,
 
   void Update(RenderContext& rc, float dt, InputState& input, behavior::ExecuteContext& execute_ctx);
 
-  void UpdatePathfinder(float radius);
+  // Swaps to the graph for the radius. If it's still building, the current graph is kept and movement falls back to
+  // steering until it's ready, unless wait is set.
+  void UpdatePathfinder(float radius, bool wait = false);
+  // True while the active graph was built for a different radius than the current ship.
+  inline bool IsPathfinderPending() const { return pending_radius_ > 0.0f; }
+  // Drops the pending path search so its result isn't used.
+  void CancelPathRequest();
 
   void HandleEvent(const JoinGameEvent& event) override;
   void HandleEvent(const PlayerEnterEvent& event) override;
@@ -91,6 +107,18 @@ struct BotController : EventHandler<PlayerFreqAndShipChangeEvent>,
 
  private:
   std::unique_ptr<behavior::BehaviorNode> behavior_tree;
+
+  void ActivateGraph(path::GraphPool::Graph& graph);
+  // Drops the active graph and waits for the pool's builds so it can be cleared.
+  void DetachGraph();
+  // Rebuilds the threat grid from the influence map every few ticks and gives it to the pathfinder.
+  void UpdateThreatLayer();
+
+  std::shared_ptr<const path::ThreatGrid> threat_grid_;
+  Tick last_threat_tick_ = 0;
+
+  // The radius of the graph that's being waited on.
+  float pending_radius_ = 0.0f;
 };
 
 }  // namespace zero
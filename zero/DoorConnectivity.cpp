@@ -0,0 +1,363 @@
+#include "DoorConnectivity.h"
+
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+namespace zero {
+
+// CanOverlapTile treats doors as empty even while they're closed, so closed doors are replaced with a wall.
+constexpr TileId kClosedDoorTile = 1;
+
+void DoorConnectivity::Build(const Map& map, float radius) {
+  tile_nodes_.Clear();
+  segments_.clear();
+  parents_.clear();
+  roots_.clear();
+  component_count_ = 0;
+  built_ = false;
+  updated_ = false;
+
+  if (!map.tiles) return;
+
+  std::vector<u8> tiles(map.tiles, map.tiles + 1024 * 1024);
+
+  // Bricks come and go too often to be part of the components.
+  for (u8& id : tiles) {
+    if (id == kTileIdBrick) id = 0;
+  }
+
+  std::vector<Tile> doors(map.doors, map.doors + map.door_count);
+
+  for (const Tile& door : doors) {
+    tiles[(size_t)door.y * 1024 + door.x] = kClosedDoorTile;
+  }
+
+  Map closed_map = map;
+
+  closed_map.tiles = tiles.data();
+  closed_map.brick_manager = nullptr;
+
+  // The doors are changed on this copy below, so it needs its own solid bitmaps.
+  std::vector<u64> solid_words(kSolidDataWordCount);
+
+  closed_map.AttachSolidData(solid_words.data());
+
+  std::vector<RegionIndex> labels;
+
+  component_count_ = LabelRegions(closed_map, radius, 0, labels);
+
+  for (u16 y = 0; y < 1024; ++y) {
+    for (u16 x = 0; x < 1024; ++x) {
+      RegionIndex label = labels[(size_t)y * 1024 + x];
+
+      if (label != kUndefinedRegion) {
+        tile_nodes_.Set(x, y, label);
+      }
+    }
+  }
+
+  // Group the doors that touch, including diagonally, into segments.
+  SparseTileGrid<s32> door_indexes(-1);
+  std::vector<u32> door_parents(doors.size());
+
+  std::iota(door_parents.begin(), door_parents.end(), 0);
+
+  auto find_door = [&door_parents](u32 index) {
+    while (door_parents[index] != index) {
+      door_parents[index] = door_parents[door_parents[index]];
+      index = door_parents[index];
+    }
+
+    return index;
+  };
+
+  for (size_t i = 0; i < doors.size(); ++i) {
+    door_indexes.Set(doors[i].x, doors[i].y, (s32)i);
+  }
+
+  for (size_t i = 0; i < doors.size(); ++i) {
+    for (s32 y = (s32)doors[i].y - 1; y <= (s32)doors[i].y + 1; ++y) {
+      for (s32 x = (s32)doors[i].x - 1; x <= (s32)doors[i].x + 1; ++x) {
+        if (x < 0 || y < 0 || x >= 1024 || y >= 1024) continue;
+
+        s32 other = door_indexes.Get((u16)x, (u16)y);
+
+        if (other < 0) continue;
+
+        u32 a = find_door((u32)i);
+        u32 b = find_door((u32)other);
+
+        if (a != b) {
+          door_parents[std::max(a, b)] = std::min(a, b);
+        }
+      }
+    }
+  }
+
+  std::vector<std::vector<Tile>> segment_doors;
+  std::vector<s32> root_segments(doors.size(), -1);
+
+  for (size_t i = 0; i < doors.size(); ++i) {
+    u32 root = find_door((u32)i);
+
+    if (root_segments[root] < 0) {
+      root_segments[root] = (s32)segment_doors.size();
+      segment_doors.emplace_back();
+    }
+
+    segment_doors[root_segments[root]].push_back(doors[i]);
+  }
+
+  segments_.resize(segment_doors.size());
+
+  // Doors change the tiles that a ship can overlap up to its diameter away, and traversal checks that far again.
+  s32 diameter = (s32)(radius * 2.0f);
+  s32 reach = diameter * 2 + 2;
+
+  for (u32 i = 0; i < (u32)segment_doors.size(); ++i) {
+    const std::vector<Tile>& segment = segment_doors[i];
+    s32 min_x = 1023, min_y = 1023, max_x = 0, max_y = 0;
+
+    for (const Tile& door : segment) {
+      segments_[i].door_mask |= (1 << (door.id - kTileIdFirstDoor));
+
+      min_x = std::min(min_x, (s32)door.x);
+      min_y = std::min(min_y, (s32)door.y);
+      max_x = std::max(max_x, (s32)door.x);
+      max_y = std::max(max_y, (s32)door.y);
+    }
+
+    min_x = std::max(min_x - reach, 0);
+    min_y = std::max(min_y - reach, 0);
+    max_x = std::min(max_x + reach, 1023);
+    max_y = std::min(max_y + reach, 1023);
+
+    u8 door_mask = segments_[i].door_mask;
+
+    // Doors with different ids can be part of the same segment, so each combination of them being open is checked.
+    for (u8 open_mask = door_mask; open_mask; open_mask = (open_mask - 1) & door_mask) {
+      for (const Tile& door : segment) {
+        bool open = open_mask & (1 << (door.id - kTileIdFirstDoor));
+
+        closed_map.SetTileId(door.x, door.y, open ? kTileIdOpenDoor : kClosedDoorTile);
+      }
+
+      BuildBridges(closed_map, radius, labels, i, open_mask, min_x, min_y, max_x, max_y);
+    }
+
+    for (const Tile& door : segment) {
+      closed_map.SetTileId(door.x, door.y, kClosedDoorTile);
+    }
+  }
+
+  size_t node_count = component_count_ + segments_.size();
+
+  parents_.resize(node_count);
+  roots_.resize(node_count);
+
+  // No doors are open until the first update.
+  std::iota(roots_.begin(), roots_.end(), 0);
+
+  built_ = true;
+}
+
+// Labels the tiles around the segment with only the doors in the mask open. The pieces that contain a tile that wasn't
+// in any component join every component in them while those doors are open.
+// Only the area around the segment is checked, since any path through the doors reaches a component within it.
+void DoorConnectivity::BuildBridges(const Map& map, float radius, const std::vector<RegionIndex>& labels,
+                                    u32 segment_index, u8 open_mask, s32 min_x, s32 min_y, s32 max_x, s32 max_y) {
+  s32 width = max_x - min_x + 1;
+  s32 height = max_y - min_y + 1;
+  size_t count = (size_t)width * height;
+
+  std::vector<u8> overlaps(count);
+  std::vector<u32> parents(count);
+
+  std::iota(parents.begin(), parents.end(), 0);
+
+  auto find = [&parents](u32 index) {
+    while (parents[index] != index) {
+      parents[index] = parents[parents[index]];
+      index = parents[index];
+    }
+
+    return index;
+  };
+
+  auto join = [&](u32 a, u32 b) {
+    a = find(a);
+    b = find(b);
+
+    if (a != b) {
+      parents[std::max(a, b)] = std::min(a, b);
+    }
+  };
+
+  for (s32 y = min_y; y <= max_y; ++y) {
+    for (s32 x = min_x; x <= max_x; ++x) {
+      overlaps[(size_t)(y - min_y) * width + (x - min_x)] = map.CanOverlapTile(Vector2f(x, y), radius, 0xFFFF);
+    }
+  }
+
+  // Traversal can be one way, but either direction is enough to join the pieces here.
+  auto can_traverse = [&](s32 x, s32 y, s32 to_x, s32 to_y) {
+    Vector2f from(x + 0.5f, y + 0.5f);
+    Vector2f to(to_x + 0.5f, to_y + 0.5f);
+
+    return map.CanTraverse(from, to, radius, 0xFFFF) || map.CanTraverse(to, from, radius, 0xFFFF);
+  };
+
+  for (s32 y = min_y; y <= max_y; ++y) {
+    for (s32 x = min_x; x <= max_x; ++x) {
+      u32 index = (u32)((y - min_y) * width + (x - min_x));
+
+      if (!overlaps[index]) continue;
+
+      if (x < max_x && overlaps[index + 1] && can_traverse(x, y, x + 1, y)) {
+        join(index, index + 1);
+      }
+
+      if (y < max_y && overlaps[index + width] && can_traverse(x, y, x, y + 1)) {
+        join(index, index + width);
+      }
+    }
+  }
+
+  Segment& segment = segments_[segment_index];
+  std::unordered_map<u32, size_t> piece_bridges;
+  size_t first_bridge = segment.bridges.size();
+
+  for (s32 y = min_y; y <= max_y; ++y) {
+    for (s32 x = min_x; x <= max_x; ++x) {
+      u32 index = (u32)((y - min_y) * width + (x - min_x));
+
+      if (!overlaps[index] || labels[(size_t)y * 1024 + x] != kUndefinedRegion) continue;
+
+      u32 root = find(index);
+
+      if (piece_bridges.find(root) == piece_bridges.end()) {
+        piece_bridges[root] = segment.bridges.size();
+        segment.bridges.push_back({open_mask, {}});
+      }
+    }
+  }
+
+  for (s32 y = min_y; y <= max_y; ++y) {
+    for (s32 x = min_x; x <= max_x; ++x) {
+      u32 index = (u32)((y - min_y) * width + (x - min_x));
+      RegionIndex label = labels[(size_t)y * 1024 + x];
+
+      if (!overlaps[index] || label == kUndefinedRegion) continue;
+
+      auto iter = piece_bridges.find(find(index));
+
+      if (iter != piece_bridges.end()) {
+        segment.bridges[iter->second].nodes.push_back(label);
+      }
+    }
+  }
+
+  for (size_t i = first_bridge; i < segment.bridges.size(); ++i) {
+    std::vector<u32>& nodes = segment.bridges[i].nodes;
+
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+  }
+
+  // Tiles that need the doors open are treated as part of the lowest component in their piece, so they stay connected
+  // to it while the doors are closed. Pieces without a component use the segment's own node.
+  for (s32 y = min_y; y <= max_y; ++y) {
+    for (s32 x = min_x; x <= max_x; ++x) {
+      u32 index = (u32)((y - min_y) * width + (x - min_x));
+
+      if (!overlaps[index] || labels[(size_t)y * 1024 + x] != kUndefinedRegion) continue;
+      if (tile_nodes_.Get((u16)x, (u16)y) != kNoNode) continue;
+
+      const std::vector<u32>& nodes = segment.bridges[piece_bridges[find(index)]].nodes;
+
+      tile_nodes_.Set((u16)x, (u16)y, nodes.empty() ? component_count_ + segment_index : nodes[0]);
+    }
+  }
+
+  // A piece with fewer than two components doesn't join anything.
+  auto end = std::remove_if(segment.bridges.begin() + first_bridge, segment.bridges.end(),
+                            [](const Bridge& bridge) { return bridge.nodes.size() < 2; });
+
+  segment.bridges.erase(end, segment.bridges.end());
+}
+
+bool DoorConnectivity::Update(u8 open_mask) {
+  if (!built_) return false;
+  if (updated_ && open_mask == open_mask_) return false;
+
+  open_mask_ = open_mask;
+  updated_ = true;
+
+  std::iota(parents_.begin(), parents_.end(), 0);
+
+  for (const Segment& segment : segments_) {
+    u8 segment_mask = open_mask & segment.door_mask;
+
+    if (segment_mask == 0) continue;
+
+    for (const Bridge& bridge : segment.bridges) {
+      if (bridge.open_mask != segment_mask) continue;
+
+      for (size_t i = 1; i < bridge.nodes.size(); ++i) {
+        u32 a = Find(bridge.nodes[0]);
+        u32 b = Find(bridge.nodes[i]);
+
+        if (a != b) {
+          parents_[std::max(a, b)] = std::min(a, b);
+        }
+      }
+    }
+  }
+
+  // Flatten the sets so queries are two lookups.
+  for (u32 i = 0; i < (u32)roots_.size(); ++i) {
+    roots_[i] = Find(i);
+  }
+
+  return true;
+}
+
+bool DoorConnectivity::IsConnected(MapCoord a, MapCoord b) const {
+  if (a.x >= 1024 || a.y >= 1024 || b.x >= 1024 || b.y >= 1024) return false;
+
+  u32 first = tile_nodes_.Get(a.x, a.y);
+  u32 second = tile_nodes_.Get(b.x, b.y);
+
+  if (first == kNoNode || second == kNoNode) return false;
+
+  return roots_[first] == roots_[second];
+}
+
+size_t DoorConnectivity::GetMemoryUsage() const {
+  size_t size = sizeof(*this) - sizeof(tile_nodes_) + tile_nodes_.GetMemoryUsage();
+
+  size += (parents_.capacity() + roots_.capacity()) * sizeof(u32);
+  size += segments_.capacity() * sizeof(Segment);
+
+  for (const Segment& segment : segments_) {
+    size += segment.bridges.capacity() * sizeof(Bridge);
+
+    for (const Bridge& bridge : segment.bridges) {
+      size += bridge.nodes.capacity() * sizeof(u32);
+    }
+  }
+
+  return size;
+}
+
+u32 DoorConnectivity::Find(u32 node) {
+  while (parents_[node] != node) {
+    parents_[node] = parents_[parents_[node]];
+    node = parents_[node];
+  }
+
+  return node;
+}
+
+}  // namespace zero
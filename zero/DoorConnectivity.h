@@ -0,0 +1,69 @@
+#pragma once
+
+#include <zero/RegionRegistry.h>
+#include <zero/TileGrid.h>
+#include <zero/Types.h>
+#include <zero/game/Map.h>
+
+#include <vector>
+
+namespace zero {
+
+// Answers whether two tiles are connected with the doors that are currently open.
+// The map is labeled once with every door closed, which splits it into static components. Touching door tiles are
+// grouped into segments, and each segment stores which components it joins for every combination of its door ids being
+// open. Door updates only have to union those small lists, so they're cheap enough to run on every toggle.
+class DoorConnectivity {
+ public:
+  static constexpr u32 kNoNode = 0xFFFFFFFF;
+
+  DoorConnectivity() : tile_nodes_(kNoNode) {}
+
+  // Labels the components and finds what each door segment joins. This is slow, so it's done with the graph build.
+  void Build(const Map& map, float radius);
+
+  // Joins the components for the doors in the mask. Returns true if the mask changed.
+  bool Update(u8 open_mask);
+
+  bool IsConnected(MapCoord a, MapCoord b) const;
+
+  inline bool IsBuilt() const { return built_; }
+  inline size_t GetComponentCount() const { return component_count_; }
+  inline size_t GetSegmentCount() const { return segments_.size(); }
+
+  size_t GetMemoryUsage() const;
+
+ private:
+  // The nodes that one piece of a segment joins when exactly the doors in the mask are open.
+  struct Bridge {
+    u8 open_mask;
+    std::vector<u32> nodes;
+  };
+
+  struct Segment {
+    // The door ids that are part of this segment.
+    u8 door_mask = 0;
+    std::vector<Bridge> bridges;
+  };
+
+  void BuildBridges(const Map& map, float radius, const std::vector<RegionIndex>& labels, u32 segment_index,
+                    u8 open_mask, s32 min_x, s32 min_y, s32 max_x, s32 max_y);
+
+  u32 Find(u32 node);
+
+  // The component of every tile that the ship can be in with the doors closed. Tiles that need a door open to be
+  // reached use a component that the open door joins them to, or the door segment's node if there isn't one.
+  SparseTileGrid<u32> tile_nodes_;
+  u32 component_count_ = 0;
+  std::vector<Segment> segments_;
+
+  // Components come first and then one node for each segment.
+  std::vector<u32> parents_;
+  std::vector<u32> roots_;
+
+  u8 open_mask_ = 0;
+  bool built_ = false;
+  bool updated_ = false;
+};
+
+}  // namespace zero
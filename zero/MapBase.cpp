@@ -8,8 +8,6 @@ namespace zero {
 
 using WalledBitset = std::bitset<1024 * 1024>;
 
-constexpr float kShipRadius = 14.0f / 16.0f;
-
 static std::vector<MapCoord> DetectFlagroomPositions(path::Pathfinder& pathfinder, const MapBuildConfig& cfg);
 static std::vector<MapBase> BuildBases(const std::vector<MapCoord>& flagrooms, path::Pathfinder& pathfinder,
                                        const MapBuildConfig& cfg);
@@ -25,10 +23,12 @@ static std::vector<MapCoord> DetectFlagroomPositions(path::Pathfinder& pathfinde
   using namespace path;
 
   const auto& map = pathfinder.GetProcessor().GetGame().GetMap();
+  std::shared_ptr<const DynamicState> dynamic_state = pathfinder.GetProcessor().GetDynamicState();
 
   struct Node {
     Node* prev = nullptr;
     float dist = 1024.0f * 1024.0f;
+    u32 heap_index = 0xFFFFFFFF;
     unsigned int open : 1 = 0;
     unsigned int visited : 1 = 0;
     unsigned int padding : 30;
@@ -38,9 +38,13 @@ static std::vector<MapCoord> DetectFlagroomPositions(path::Pathfinder& pathfinde
     bool operator()(const Node* lhs, const Node* rhs) const { return lhs->dist > rhs->dist; }
   };
 
+  struct NodeHeapIndex {
+    u32& operator()(Node* node) const { return node->heap_index; }
+  };
+
   Node* nodes = new Node[1024 * 1024];
 
-  PriorityQueue<Node*, NodeCompare> q;
+  IndexedPriorityQueue<Node*, NodeCompare, NodeHeapIndex> q;
 
   nodes[cfg.spawn.y * 1024 + cfg.spawn.x].dist = 0.0f;
 
@@ -62,10 +66,7 @@ static std::vector<MapCoord> DetectFlagroomPositions(path::Pathfinder& pathfinde
         CoordOffset::East(),
     };
 
-    bool updated_neighbor = false;
-
-    EdgeSet edgeset = pathfinder.GetProcessor().FindEdges(
-        pathfinder.GetProcessor().GetNode(NodePoint(node_coord.x, node_coord.y)), kShipRadius);
+    EdgeSet edgeset = pathfinder.GetProcessor().FindEdges(NodePoint(node_coord.x, node_coord.y), *dynamic_state);
 
     for (size_t i = 0; i < 4; ++i) {
       MapCoord neighbor_coord = node_coord;
@@ -90,15 +91,11 @@ static std::vector<MapCoord> DetectFlagroomPositions(path::Pathfinder& pathfinde
         } else if (dist < neighbor->dist) {
           neighbor->dist = dist;
           neighbor->prev = node;
-          updated_neighbor = true;
+
+          q.Decrease(neighbor);
         }
       }
     }
-
-    // Do the update once at the end
-    if (updated_neighbor) {
-      q.Update();
-    }
   }
 
   struct Base {
@@ -231,6 +228,7 @@ static Vector2f FloodFillRegion(path::Pathfinder& pathfinder, const WalledBitset
   region.Set(start.x, start.y, true);
 
   Vector2f entrance_position((float)start.x, (float)start.y);
+  std::shared_ptr<const DynamicState> dynamic_state = pathfinder.GetProcessor().GetDynamicState();
 
   while (!stack.empty()) {
     FloodState current = stack.front();
@@ -252,8 +250,7 @@ static Vector2f FloodFillRegion(path::Pathfinder& pathfinder, const WalledBitset
       }
     }
 
-    auto node = pathfinder.GetProcessor().GetNode(NodePoint(coord.x, coord.y));
-    EdgeSet edgeset = pathfinder.GetProcessor().FindEdges(node, kShipRadius);
+    EdgeSet edgeset = pathfinder.GetProcessor().FindEdges(NodePoint(coord.x, coord.y), *dynamic_state);
 
     MapCoord west(coord.x - 1, coord.y);
     MapCoord east(coord.x + 1, coord.y);
@@ -1,6 +1,15 @@
+#include <zero/AreaGraph.h>
+#include <zero/DoorConnectivity.h>
 #include <zero/RegionRegistry.h>
 #include <zero/game/Map.h>
 
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace zero {
@@ -9,24 +18,90 @@ bool IsValidPosition(MapCoord coord) {
   return coord.x >= 0 && coord.x < 1024 && coord.y >= 0 && coord.y < 1024;
 }
 
-RegionFiller::RegionFiller(const Map& map, float radius, RegionIndex* coord_regions)
-    : map(map),
-      radius(radius),
-      coord_regions(coord_regions),
-      highest_coord(9999, 9999) {
-  potential_edges.reserve(1024 * 1024);
+// The directions that regions are traversed in. Each direction is next to its opposite so flipping the low bit reverses
+// it.
+constexpr s32 kRegionOffsetX[] = {-1, 1, 0, 0};
+constexpr s32 kRegionOffsetY[] = {0, 0, -1, 1};
+
+// A union-find over tile indexes that multiple threads can merge into at once without locking.
+// The root of a set is always its lowest index, so threads that link the same sets agree on the root.
+class ConcurrentDisjointSet {
+ public:
+  explicit ConcurrentDisjointSet(size_t size) : parents_(std::make_unique<std::atomic<u32>[]>(size)) {
+    for (size_t i = 0; i < size; ++i) {
+      parents_[i].store((u32)i, std::memory_order_relaxed);
+    }
+  }
+
+  u32 Find(u32 index) {
+    while (true) {
+      u32 parent = parents_[index].load(std::memory_order_relaxed);
+
+      if (parent == index) return index;
+
+      u32 grandparent = parents_[parent].load(std::memory_order_relaxed);
+
+      // Halve the path as it's walked. This can fail if another thread already moved it, which is fine.
+      if (grandparent != parent) {
+        parents_[index].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+      }
+
+      index = grandparent;
+    }
+  }
+
+  void Union(u32 a, u32 b) {
+    while (true) {
+      a = Find(a);
+      b = Find(b);
+
+      if (a == b) return;
+      if (a < b) std::swap(a, b);
+
+      u32 expected = a;
+
+      // Another thread linked this root first, so find the new roots and try again.
+      if (parents_[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) return;
+    }
+  }
+
+ private:
+  std::unique_ptr<std::atomic<u32>[]> parents_;
+};
 
-  for (size_t i = 0; i < 1024 * 1024; ++i) {
-    potential_edges.push_back(kUndefinedRegion);
+// Splits the map rows into one strip for each thread and waits for all of them to finish.
+// The function is called with the strip index and its range of rows.
+template <typename F>
+static void RunRowStrips(size_t thread_count, F&& func) {
+  size_t rows_per_strip = (1024 + thread_count - 1) / thread_count;
+  std::vector<std::thread> threads;
+
+  for (size_t strip = 1; strip * rows_per_strip < 1024; ++strip) {
+    size_t start_y = strip * rows_per_strip;
+    size_t end_y = std::min(start_y + rows_per_strip, (size_t)1024);
+
+    threads.emplace_back([&func, strip, start_y, end_y]() { func(strip, (u16)start_y, (u16)end_y); });
+  }
+
+  // The calling thread handles the first strip.
+  func(0, (u16)0, (u16)std::min(rows_per_strip, (size_t)1024));
+
+  for (std::thread& thread : threads) {
+    thread.join();
   }
 }
 
+RegionFiller::RegionFiller(const Map& map, float radius, SparseTileGrid<RegionIndex>& coord_regions)
+    : map(map),
+      radius(radius),
+      coord_regions(coord_regions),
+      highest_coord(9999, 9999),
+      potential_edges(kUndefinedRegion) {}
+
 void RegionFiller::FillEmpty(const MapCoord& coord) {
   if (!map.CanOverlapTile(Vector2f(coord.x, coord.y), radius, 0xFFFF)) return;
 
-  coord_regions[coord.y * 1024 + coord.x] = region_index;
-
-  Event::Dispatch(RegionTileAddEvent(region_index, coord));
+  coord_regions.Set(coord.x, coord.y, region_index);
 
   stack.push_back(coord);
 
@@ -50,22 +125,19 @@ void RegionFiller::FillEmpty(const MapCoord& coord) {
 void RegionFiller::TraverseEmpty(const Vector2f& from, MapCoord to) {
   if (!IsValidPosition(to)) return;
 
-  size_t to_index = (size_t)to.y * 1024 + to.x;
-
   if (!map.CanOccupyRadius(Vector2f(to.x, to.y), radius, 0xFFFF)) {
-    potential_edges[to_index] = region_index;
+    potential_edges.Set(to.x, to.y, region_index);
 
     if (to.y < highest_coord.y) {
       highest_coord = to;
     }
   }
 
-  if (coord_regions[to_index] == kUndefinedRegion) {
+  if (coord_regions.Get(to.x, to.y) == kUndefinedRegion) {
     Vector2f to_pos((float)to.x + 0.5f, (float)to.y + 0.5f);
 
     if (map.CanTraverse(from, to_pos, radius, 0xFFFF)) {
-      coord_regions[to_index] = region_index;
-      Event::Dispatch(RegionTileAddEvent(region_index, to));
+      coord_regions.Set(to.x, to.y, region_index);
       stack.push_back(to);
     }
   }
@@ -111,15 +183,13 @@ void RegionFiller::FillSolid() {
 void RegionFiller::TraverseSolid(const Vector2f& from, MapCoord to) {
   if (!IsValidPosition(Vector2f(to.x, to.y))) return;
 
-  size_t to_index = (size_t)to.y * 1024 + to.x;
-
-  if (potential_edges[to_index] == region_index) {
+  if (potential_edges.Get(to.x, to.y) == region_index) {
     stack.push_back(to);
-    potential_edges[to_index] = kUndefinedRegion;
+    potential_edges.Set(to.x, to.y, kUndefinedRegion);
 
 #if 0
     // Add an edge if this tile is not part of the empty space within the base
-    if (coord_regions[to_index] != region_index) {
+    if (coord_regions.Get(to.x, to.y) != region_index) {
       Vector2f to_pos = Vector2f((float)to.x, (float)to.y);
       if (!IsEmptyBaseTile(to_pos)) {
         edges[to_index].AddOwner(region_index);
@@ -135,10 +205,8 @@ bool RegionFiller::IsEmptyBaseTile(const Vector2f& position) const {
   OccupyRect rect = map.GetPossibleOccupyRect(position, radius, 0xFFFF);
 
   if (rect.occupy) {
-    size_t top_index = rect.start_y * 1024 + rect.start_x;
-    size_t bottom_index = rect.end_y * 1024 + rect.end_x;
-
-    if (coord_regions[top_index] == region_index || coord_regions[bottom_index] == region_index) {
+    if (coord_regions.Get(rect.start_x, rect.start_y) == region_index ||
+        coord_regions.Get(rect.end_x, rect.end_y) == region_index) {
       return true;
     }
   }
@@ -146,8 +214,223 @@ bool RegionFiller::IsEmptyBaseTile(const Vector2f& position) const {
   return false;
 }
 
-void RegionRegistry::CreateAll(const Map& map, float radius) {
-  Event::Dispatch(RegionBuildEvent());
+// The same check as Map::CanTraverse, but the overlap of each tile is read from the precomputed table instead of being
+// tested again. Positions off of the map are tested with the map so they match exactly.
+static bool CanTraverseTiles(const Map& map, const std::vector<u8>& overlaps, const Vector2f& start,
+                             const Vector2f& end, float radius) {
+  auto can_overlap = [&](const Vector2f& position) {
+    if (position.x < 0.0f || position.y < 0.0f || position.x >= 1024.0f || position.y >= 1024.0f) {
+      return map.CanOverlapTile(position, radius, 0xFFFF);
+    }
+
+    return overlaps[(size_t)position.y * 1024 + (size_t)position.x] != 0;
+  };
+
+  if (!can_overlap(start) || !can_overlap(end)) return false;
+
+  Vector2f cross = Perpendicular(Normalize(start - end));
+
+  bool left_solid = map.IsSolid(start + cross, 0xFFFF);
+  bool right_solid = map.IsSolid(start - cross, 0xFFFF);
+
+  if (left_solid || right_solid) {
+    Vector2f side = left_solid ? -cross : cross;
+
+    for (float i = 0; i < radius * 2.0f; ++i) {
+      if (!can_overlap(start + side * i)) return false;
+      if (!can_overlap(end + side * i)) return false;
+    }
+  }
+
+  return true;
+}
+
+// Every tile the ship can overlap is a region seed in the flood fill, and the fill moves into a neighbor when the ship
+// can traverse to it. Traversal isn't always symmetric, so this can't simply find the connected tiles.
+// Tiles with traversal in both directions are merged into sets first. The flood fill always fills the entire set once it
+// reaches any tile in it, so the sets can be labeled as a whole. The one way links between sets are then followed in
+// the same order as the flood fill so the region indexes match.
+RegionIndex LabelRegions(const Map& map, float radius, size_t thread_count, std::vector<RegionIndex>& labels) {
+  constexpr size_t kTileCount = 1024 * 1024;
+
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  thread_count = std::min(thread_count, (size_t)1024);
+
+  RegionIndex region_count = 0;
+
+  // The predicates are computed once for each tile so the labeling passes only read these.
+  std::vector<u8> overlaps(kTileCount, 0);
+  std::vector<u8> edges(kTileCount, 0);
+
+  RunRowStrips(thread_count, [&](size_t, u16 start_y, u16 end_y) {
+    for (u16 y = start_y; y < end_y; ++y) {
+      for (u16 x = 0; x < 1024; ++x) {
+        overlaps[(size_t)y * 1024 + x] = map.CanOverlapTile(Vector2f(x, y), radius, 0xFFFF);
+      }
+    }
+  });
+
+  RunRowStrips(thread_count, [&](size_t, u16 start_y, u16 end_y) {
+    for (u16 y = start_y; y < end_y; ++y) {
+      for (u16 x = 0; x < 1024; ++x) {
+        size_t index = (size_t)y * 1024 + x;
+
+        if (!overlaps[index]) continue;
+
+        Vector2f from((float)x + 0.5f, (float)y + 0.5f);
+
+        for (size_t i = 0; i < 4; ++i) {
+          s32 to_x = x + kRegionOffsetX[i];
+          s32 to_y = y + kRegionOffsetY[i];
+
+          if (to_x < 0 || to_y < 0 || to_x >= 1024 || to_y >= 1024) continue;
+          if (!overlaps[(size_t)to_y * 1024 + to_x]) continue;
+
+          Vector2f to((float)to_x + 0.5f, (float)to_y + 0.5f);
+
+          if (CanTraverseTiles(map, overlaps, from, to, radius)) {
+            edges[index] |= (1 << i);
+          }
+        }
+      }
+    }
+  });
+
+  ConcurrentDisjointSet sets(kTileCount);
+
+  // The south neighbors of the last row in a strip belong to the next strip, so strips merge into each other as they
+  // are labeled.
+  RunRowStrips(thread_count, [&](size_t, u16 start_y, u16 end_y) {
+    for (u16 y = start_y; y < end_y; ++y) {
+      for (u16 x = 0; x < 1024; ++x) {
+        u32 index = (u32)y * 1024 + x;
+
+        if ((edges[index] & (1 << 1)) && (edges[index + 1] & (1 << 0))) {
+          sets.Union(index, index + 1);
+        }
+
+        if ((edges[index] & (1 << 3)) && (edges[index + 1024] & (1 << 2))) {
+          sets.Union(index, index + 1024);
+        }
+      }
+    }
+  });
+
+  std::vector<u32> roots(kTileCount);
+  std::vector<std::vector<std::pair<u32, u32>>> strip_links(thread_count);
+
+  RunRowStrips(thread_count, [&](size_t, u16 start_y, u16 end_y) {
+    for (size_t index = (size_t)start_y * 1024; index < (size_t)end_y * 1024; ++index) {
+      roots[index] = sets.Find((u32)index);
+    }
+  });
+
+  RunRowStrips(thread_count, [&](size_t strip, u16 start_y, u16 end_y) {
+    std::vector<std::pair<u32, u32>>& links = strip_links[strip];
+
+    for (u16 y = start_y; y < end_y; ++y) {
+      for (u16 x = 0; x < 1024; ++x) {
+        size_t index = (size_t)y * 1024 + x;
+
+        if (!edges[index]) continue;
+
+        for (size_t i = 0; i < 4; ++i) {
+          if (!(edges[index] & (1 << i))) continue;
+
+          size_t to_index = (size_t)(y + kRegionOffsetY[i]) * 1024 + (x + kRegionOffsetX[i]);
+
+          if (roots[index] != roots[to_index]) {
+            links.emplace_back(roots[index], roots[to_index]);
+          }
+        }
+      }
+    }
+  });
+
+  std::vector<std::pair<u32, u32>> links;
+
+  for (auto& strip : strip_links) {
+    links.insert(links.end(), strip.begin(), strip.end());
+  }
+
+  std::sort(links.begin(), links.end());
+  links.erase(std::unique(links.begin(), links.end()), links.end());
+
+  // Seeds are visited in the same order as the flood fill, so regions are created in the same order.
+  std::vector<RegionIndex> root_regions(kTileCount, kUndefinedRegion);
+  std::vector<u32> stack;
+
+  for (size_t index = 0; index < kTileCount; ++index) {
+    if (!overlaps[index]) continue;
+
+    u32 root = roots[index];
+
+    if (root_regions[root] != kUndefinedRegion) continue;
+
+    RegionIndex region_index = region_count++;
+
+    root_regions[root] = region_index;
+    stack.push_back(root);
+
+    while (!stack.empty()) {
+      u32 current = stack.back();
+      stack.pop_back();
+
+      auto iter = std::lower_bound(links.begin(), links.end(), std::make_pair(current, 0u));
+
+      for (; iter != links.end() && iter->first == current; ++iter) {
+        if (root_regions[iter->second] == kUndefinedRegion) {
+          root_regions[iter->second] = region_index;
+          stack.push_back(iter->second);
+        }
+      }
+    }
+  }
+
+  labels.assign(kTileCount, kUndefinedRegion);
+
+  for (size_t index = 0; index < kTileCount; ++index) {
+    if (overlaps[index]) {
+      labels[index] = root_regions[roots[index]];
+    }
+  }
+
+  return region_count;
+}
+
+RegionRegistry::RegionRegistry()
+    : region_count_(0),
+      coord_regions_(kUndefinedRegion),
+      door_connectivity_(std::make_unique<DoorConnectivity>()),
+      area_graph_(std::make_unique<AreaGraph>()) {}
+
+RegionRegistry::~RegionRegistry() {}
+
+void RegionRegistry::CreateAll(const Map& map, float radius, size_t thread_count) {
+  std::vector<RegionIndex> labels;
+
+  coord_regions_.Clear();
+  region_count_ = LabelRegions(map, radius, thread_count, labels);
+
+  for (u16 y = 0; y < 1024; ++y) {
+    for (u16 x = 0; x < 1024; ++x) {
+      RegionIndex region_index = labels[(size_t)y * 1024 + x];
+
+      if (region_index != kUndefinedRegion) {
+        coord_regions_.Set(x, y, region_index);
+      }
+    }
+  }
+
+  BuildDescriptors();
+}
+
+void RegionRegistry::CreateAllFloodFill(const Map& map, float radius) {
+  coord_regions_.Clear();
+  region_count_ = 0;
 
   RegionFiller filler(map, radius, coord_regions_);
 
@@ -166,16 +449,107 @@ void RegionRegistry::CreateAll(const Map& map, float radius) {
       }
     }
   }
+
+  BuildDescriptors();
+}
+
+void RegionRegistry::Load(const RegionIndex* coord_regions, RegionIndex region_count) {
+  coord_regions_.Clear();
+  region_count_ = region_count;
+
+  for (uint16_t y = 0; y < 1024; ++y) {
+    for (uint16_t x = 0; x < 1024; ++x) {
+      coord_regions_.Set(x, y, coord_regions[y * 1024 + x]);
+    }
+  }
+
+  BuildDescriptors();
+}
+
+void RegionRegistry::DispatchEvents() const {
+  Event::Dispatch(RegionBuildEvent(*this));
+}
+
+void RegionRegistry::BuildDoorConnectivity(const Map& map, float radius) {
+  door_connectivity_->Build(map, radius);
+  door_connectivity_->Update(GetOpenDoorMask(map));
+}
+
+void RegionRegistry::UpdateDoors(const Map& map) {
+  door_connectivity_->Update(GetOpenDoorMask(map));
+}
+
+void RegionRegistry::BuildAreaGraph(const Map& map, const path::WallDistanceField& distances) {
+  area_graph_->Build(map, *this, distances);
+}
+
+size_t RegionRegistry::GetMemoryUsage() const {
+  size_t size = sizeof(*this) - sizeof(coord_regions_) + coord_regions_.GetMemoryUsage();
+
+  size += door_connectivity_->GetMemoryUsage();
+  size += area_graph_->GetMemoryUsage();
+
+  size += descriptors_.capacity() * sizeof(RegionDescriptor);
+
+  for (const RegionDescriptor& descriptor : descriptors_) {
+    size += descriptor.spans.capacity() * sizeof(RegionSpan);
+  }
+
+  return size;
+}
+
+void RegionRegistry::BuildDescriptors() {
+  descriptors_.clear();
+  descriptors_.resize(region_count_);
+
+  for (RegionIndex i = 0; i < region_count_; ++i) {
+    descriptors_[i].index = i;
+    descriptors_[i].min = MapCoord(1023, 1023);
+  }
+
+  for (uint16_t y = 0; y < 1024; ++y) {
+    uint16_t x = 0;
+
+    while (x < 1024) {
+      RegionIndex region_index = coord_regions_.Get(x, y);
+
+      if (region_index == kUndefinedRegion || region_index >= region_count_) {
+        ++x;
+        continue;
+      }
+
+      uint16_t start_x = x;
+
+      while (x + 1 < 1024 && coord_regions_.Get(x + 1, y) == region_index) {
+        ++x;
+      }
+
+      RegionDescriptor& descriptor = descriptors_[region_index];
+
+      descriptor.spans.push_back({y, start_x, x});
+      descriptor.tile_count += x - start_x + 1;
+      descriptor.min.x = std::min(descriptor.min.x, start_x);
+      descriptor.min.y = std::min(descriptor.min.y, y);
+      descriptor.max.x = std::max(descriptor.max.x, x);
+      descriptor.max.y = std::max(descriptor.max.y, y);
+
+      ++x;
+    }
+  }
+
+  for (RegionDescriptor& descriptor : descriptors_) {
+    descriptor.spans.shrink_to_fit();
+  }
 }
 
 bool RegionRegistry::IsRegistered(MapCoord coord) const {
   if (!IsValidPosition(coord)) return false;
-  return coord_regions_[coord.y * 1024 + coord.x] != -1;
+  return coord_regions_.Get(coord.x, coord.y) != kUndefinedRegion;
 }
 
 void RegionRegistry::Insert(MapCoord coord, RegionIndex index) {
   if (!IsValidPosition(coord)) return;
-  coord_regions_[coord.y * 1024 + coord.x] = index;
+  coord_regions_.Set(coord.x, coord.y, index);
 }
 
 RegionIndex RegionRegistry::CreateRegion() {
@@ -184,7 +558,13 @@ RegionIndex RegionRegistry::CreateRegion() {
 
 RegionIndex RegionRegistry::GetRegionIndex(MapCoord coord) const {
   if (!IsValidPosition(coord)) return kUndefinedRegion;
-  return coord_regions_[coord.y * 1024 + coord.x];
+  return coord_regions_.Get(coord.x, coord.y);
+}
+
+bool RegionRegistry::IsConnectedWithDoors(MapCoord a, MapCoord b) const {
+  if (!door_connectivity_->IsBuilt()) return IsConnected(a, b);
+
+  return door_connectivity_->IsConnected(a, b);
 }
 
 bool RegionRegistry::IsConnected(MapCoord a, MapCoord b) const {
@@ -192,10 +572,10 @@ bool RegionRegistry::IsConnected(MapCoord a, MapCoord b) const {
   if (!IsValidPosition(a)) return false;
   if (!IsValidPosition(b)) return false;
 
-  RegionIndex first = coord_regions_[a.y * 1024 + a.x];
-  if (first == -1) return false;
+  RegionIndex first = coord_regions_.Get(a.x, a.y);
+  if (first == kUndefinedRegion) return false;
 
-  RegionIndex second = coord_regions_[b.y * 1024 + b.x];
+  RegionIndex second = coord_regions_.Get(b.x, b.y);
 
   return first == second;
 }
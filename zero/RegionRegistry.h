@@ -3,13 +3,16 @@
 #include <zero/Event.h>
 #include <zero/Hash.h>
 #include <zero/Math.h>
+#include <zero/TileGrid.h>
 #include <zero/game/Map.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace zero {
 
@@ -35,12 +38,44 @@ MAKE_HASHABLE(zero::MapCoord, t.x, t.y);
 
 namespace zero {
 
-struct RegionBuildEvent : public Event {};
-struct RegionTileAddEvent : public Event {
-  MapCoord coord;
-  RegionIndex region_index;
+// A horizontal run of tiles in the same region. The end is inclusive.
+struct RegionSpan {
+  u16 y;
+  u16 start_x;
+  u16 end_x;
+};
+
+// A compact description of every tile in a region, stored as row spans sorted by y and then x.
+struct RegionDescriptor {
+  RegionIndex index = kUndefinedRegion;
+  MapCoord min;
+  MapCoord max;
+  u32 tile_count = 0;
+  std::vector<RegionSpan> spans;
+
+  inline bool Contains(MapCoord coord) const {
+    if (coord.x < min.x || coord.x > max.x || coord.y < min.y || coord.y > max.y) return false;
+
+    auto iter = std::upper_bound(spans.begin(), spans.end(), coord, [](MapCoord coord, const RegionSpan& span) {
+      return coord.y < span.y || (coord.y == span.y && coord.x < span.start_x);
+    });
+
+    if (iter == spans.begin()) return false;
+
+    --iter;
 
-  RegionTileAddEvent(RegionIndex region_index, MapCoord coord) : region_index(region_index), coord(coord) {}
+    return iter->y == coord.y && coord.x <= iter->end_x;
+  }
+
+  // Calls the function with every tile in the region in row order.
+  template <typename F>
+  inline void ForEachTile(F&& func) const {
+    for (const RegionSpan& span : spans) {
+      for (u32 x = span.start_x; x <= span.end_x; ++x) {
+        func(MapCoord((u16)x, span.y));
+      }
+    }
+  }
 };
 
 struct SharedRegionOwnership {
@@ -71,9 +106,14 @@ struct SharedRegionOwnership {
   }
 };
 
+// Labels every tile with the region that the flood fill would give it, or kUndefinedRegion if the ship can't be there.
+// The map is split into strips of rows that are labeled on separate threads and merged with a union-find. A thread count
+// of zero uses every hardware thread. Returns the number of regions.
+RegionIndex LabelRegions(const Map& map, float radius, size_t thread_count, std::vector<RegionIndex>& labels);
+
 struct RegionFiller {
  public:
-  RegionFiller(const Map& map, float radius, RegionIndex* coord_regions);
+  RegionFiller(const Map& map, float radius, SparseTileGrid<RegionIndex>& coord_regions);
 
   void Fill(RegionIndex index, const MapCoord& coord) {
     this->region_index = index;
@@ -97,33 +137,94 @@ struct RegionFiller {
   RegionIndex region_index;
   float radius;
 
-  RegionIndex* coord_regions;
+  SparseTileGrid<RegionIndex>& coord_regions;
   int* region_tile_counts;
 
   MapCoord highest_coord;
 
-  std::vector<RegionIndex> potential_edges;
+  // This is only written next to the filled regions, so it's stored sparsely instead of covering the whole map.
+  SparseTileGrid<RegionIndex> potential_edges;
 
   std::vector<MapCoord> stack;
 };
 
+namespace path {
+class WallDistanceField;
+}  // namespace path
+
+class AreaGraph;
+class DoorConnectivity;
+
 class RegionRegistry {
  public:
-  RegionRegistry() : region_count_(0) { memset(coord_regions_, 0xFF, sizeof(coord_regions_)); }
+  RegionRegistry();
+  ~RegionRegistry();
 
+  // Checks if the tiles are in the same region. Regions are built with every door open.
   bool IsConnected(MapCoord a, MapCoord b) const;
-  void CreateAll(const Map& map, float radius);
+  // Checks if the tiles are connected with the doors that are currently open. This is the same as IsConnected until the
+  // door connectivity is built.
+  bool IsConnectedWithDoors(MapCoord a, MapCoord b) const;
+
+  // Builds the components that IsConnectedWithDoors joins as doors open. This is separate from creating the regions
+  // because regions loaded from the graph cache need it too.
+  void BuildDoorConnectivity(const Map& map, float radius);
+  // Joins the components for the doors that are open in the map. This should happen on door updates.
+  void UpdateDoors(const Map& map);
+  // Splits the regions into areas joined by chokepoints and wormholes. This needs the regions to be created or loaded.
+  void BuildAreaGraph(const Map& map, const path::WallDistanceField& distances);
+  // Creates the regions with LabelRegions. The labels match CreateAllFloodFill.
+  void CreateAll(const Map& map, float radius, size_t thread_count = 0);
+  // The original single threaded flood fill. It's kept as the baseline that CreateAll is checked against.
+  void CreateAllFloodFill(const Map& map, float radius);
 
   RegionIndex GetRegionIndex(MapCoord coord) const;
 
+  // Replaces the regions with ones that were previously created.
+  void Load(const RegionIndex* coord_regions, RegionIndex region_count);
+
+  // Sends a single RegionBuildEvent that listeners can read every region's descriptor from.
+  // Building doesn't send events so it can happen on another thread. This should be called on the game thread once the
+  // registry becomes the active one.
+  void DispatchEvents() const;
+
+  inline RegionIndex GetRegionCount() const { return region_count_; }
+
+  // The descriptors are built along with the regions, so they're indexed by region.
+  inline const std::vector<RegionDescriptor>& GetDescriptors() const { return descriptors_; }
+  inline const RegionDescriptor* GetDescriptor(RegionIndex index) const {
+    if (index >= descriptors_.size()) return nullptr;
+    return &descriptors_[index];
+  }
+
+  inline const AreaGraph& GetAreaGraph() const { return *area_graph_; }
+  inline AreaGraph& GetAreaGraph() { return *area_graph_; }
+
+  size_t GetMemoryUsage() const;
+
  private:
   bool IsRegistered(MapCoord coord) const;
   void Insert(MapCoord coord, RegionIndex index);
 
   RegionIndex CreateRegion();
 
+  // Scans the regions once to build the span list and bounds of each one.
+  void BuildDescriptors();
+
   RegionIndex region_count_;
 
-  RegionIndex coord_regions_[1024 * 1024];
+  // Solid areas have no region, so only the blocks that contain a region are allocated.
+  SparseTileGrid<RegionIndex> coord_regions_;
+  std::vector<RegionDescriptor> descriptors_;
+
+  std::unique_ptr<DoorConnectivity> door_connectivity_;
+  std::unique_ptr<AreaGraph> area_graph_;
 };
+
+struct RegionBuildEvent : public Event {
+  const RegionRegistry& registry;
+
+  RegionBuildEvent(const RegionRegistry& registry) : registry(registry) {}
+};
+
 }  // namespace zero
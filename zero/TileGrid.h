@@ -0,0 +1,69 @@
+#pragma once
+
+#include <zero/Types.h>
+
+#include <memory>
+
+namespace zero {
+
+// Stores a value for every tile of the map in 16x16 blocks.
+// A block is only allocated once one of its tiles is set to something other than the default value, so large solid
+// areas of the map don't use any memory.
+template <typename T>
+class SparseTileGrid {
+ public:
+  static constexpr size_t kBlockSize = 16;
+  static constexpr size_t kBlockTiles = kBlockSize * kBlockSize;
+  static constexpr size_t kBlocksPerRow = 1024 / kBlockSize;
+  static constexpr size_t kBlockCount = kBlocksPerRow * kBlocksPerRow;
+
+  explicit SparseTileGrid(T default_value) : default_value_(default_value) {}
+
+  inline T Get(u16 x, u16 y) const {
+    const std::unique_ptr<T[]>& block = blocks_[GetBlockIndex(x, y)];
+
+    if (!block) return default_value_;
+
+    return block[GetTileIndex(x, y)];
+  }
+
+  inline void Set(u16 x, u16 y, T value) {
+    std::unique_ptr<T[]>& block = blocks_[GetBlockIndex(x, y)];
+
+    if (!block) {
+      if (value == default_value_) return;
+
+      block = std::make_unique<T[]>(kBlockTiles);
+
+      for (size_t i = 0; i < kBlockTiles; ++i) {
+        block[i] = default_value_;
+      }
+
+      ++block_count_;
+    }
+
+    block[GetTileIndex(x, y)] = value;
+  }
+
+  void Clear() {
+    for (size_t i = 0; i < kBlockCount; ++i) {
+      blocks_[i].reset();
+    }
+
+    block_count_ = 0;
+  }
+
+  inline size_t GetAllocatedBlockCount() const { return block_count_; }
+
+  inline size_t GetMemoryUsage() const { return sizeof(*this) + block_count_ * kBlockTiles * sizeof(T); }
+
+ private:
+  static inline size_t GetBlockIndex(u16 x, u16 y) { return (y / kBlockSize) * kBlocksPerRow + (x / kBlockSize); }
+  static inline size_t GetTileIndex(u16 x, u16 y) { return (y % kBlockSize) * kBlockSize + (x % kBlockSize); }
+
+  T default_value_;
+  size_t block_count_ = 0;
+  std::unique_ptr<T[]> blocks_[kBlockCount];
+};
+
+}  // namespace zero
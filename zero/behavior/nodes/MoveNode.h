@@ -230,8 +230,25 @@ struct FollowPathNode : public BehaviorNode {
 
     Vector2f movement_target = current_path.GetCurrent();
 
+    if (current_path.HasCorners()) {
+      // Each corner can be reached in a straight line from the previous one, so the next corner can be taken once the
+      // current one is reached. It's only cast against if the current corner is still far away.
+      size_t next_slot = current_path.GetNextCornerSlot();
+
+      if (next_slot < current_path.corners.size()) {
+        Vector2f next = current_path.points[current_path.corners[next_slot]];
+        bool reached = movement_target.DistanceSq(self->position) < 1.0f;
+
+        if (reached || !map.CastShip(self, radius, next).hit) {
+          // Reset the stuck counter when we successfully move to a new node.
+          ctx.blackboard.Set("bounce_count", 0U);
+          movement_target = current_path.AdvanceCorner();
+        }
+      }
+    }
+
     // Cull future nodes if they are all unobstructed from current position.
-    while (!current_path.IsOnGoalNode()) {
+    while (!current_path.HasCorners() && !current_path.IsOnGoalNode()) {
       Vector2f next = current_path.GetNext();
 
       CastResult cast = map.CastShip(self, radius, next);
@@ -374,11 +391,33 @@ struct FollowPathNode : public BehaviorNode {
   }
 };
 
+// Determines how a movement node gets its path to the goal.
+enum class PathQueryType {
+  // Search for a new path every time it needs to be rebuilt. This uses the pathfinder's search mode.
+  Search,
+  // Read the path from the cached distance field of the goal. This should only be used for goals that don't move.
+  DistanceField,
+  // Search with the incremental planner, which repairs its previous search after door and brick changes instead of
+  // starting over. This works best for goals that don't move, such as the way into a base with doors.
+  Incremental,
+  // Search from both ends at once with a full tile path. This expands fewer nodes on long paths across open maps.
+  Bidirectional,
+  // Search with the door schedule so the path can go through doors that open before the ship reaches them.
+  // The path is kept when doors update instead of being searched again.
+  Scheduled,
+  // Search the sector graph and only refine the start of the path. This is cheaper for long paths across the map, but
+  // the path can be slightly longer than a full search.
+  Hierarchical,
+};
+
 // Generic movement node that will rebuild the path when necessary.
 // The generated path will be stored in the bot controller's 'current_path' variable.
+// Searches run on the pathfinder's request threads, so the old path is followed until the new one is ready.
 struct GoToNode : public BehaviorNode {
-  GoToNode(const char* position_key) : position_key(position_key) {}
-  GoToNode(Vector2f position) : position(position), position_key(nullptr) {}
+  GoToNode(const char* position_key, PathQueryType query_type = PathQueryType::Search)
+      : position_key(position_key), query_type(query_type) {}
+  GoToNode(Vector2f position, PathQueryType query_type = PathQueryType::Search)
+      : position(position), position_key(nullptr), query_type(query_type) {}
 
   ExecuteResult Execute(ExecuteContext& ctx) override {
     Player* self = ctx.bot->game->player_manager.GetSelf();
@@ -395,12 +434,34 @@ struct GoToNode : public BehaviorNode {
 
     auto& map = ctx.bot->game->GetMap();
     auto& current_path = ctx.bot->bot_controller->current_path;
+    auto& path_request = ctx.bot->bot_controller->path_request;
     auto& pathfinder = ctx.bot->bot_controller->pathfinder;
     auto& game = *ctx.bot->game;
     bool build = true;
+    bool search_failed = false;
 
     float radius = game.connection.settings.ShipSettings[self->ship].GetRadius();
 
+    // The graph for this ship is still building, so the current one is for a different radius. Steer straight at the
+    // target until it's ready.
+    if (ctx.bot->bot_controller->IsPathfinderPending()) {
+      ctx.bot->bot_controller->steering.Seek(game, target);
+      return ExecuteResult::Running;
+    }
+
+    if (path_request && path_request->IsReady()) {
+      // Only take the finished path if it still leads to the target.
+      if (target.DistanceSq(path_request->GetGoal()) <= 3.0f * 3.0f) {
+        if (path_request->path.Empty()) {
+          search_failed = true;
+        } else {
+          current_path = path_request->path;
+        }
+      }
+
+      path_request = nullptr;
+    }
+
     if (!current_path.Empty()) {
       if (target.DistanceSq(current_path.GetGoal()) <= 3.0f * 3.0f) {
         Vector2f next = current_path.GetCurrent();
@@ -409,7 +470,10 @@ struct GoToNode : public BehaviorNode {
 
         // Try to walk the path backwards to re-use the nodes.
         while (cast.hit && current_path.index > 0) {
-          --current_path.index;
+          if (!current_path.RetreatCorner()) {
+            --current_path.index;
+          }
+
           next = current_path.GetCurrent();
           cast = map.CastShip(self, radius, next);
         }
@@ -420,12 +484,25 @@ struct GoToNode : public BehaviorNode {
       }
     }
 
-    if (build) {
+    if (current_path.NeedsRefinement()) {
+      build = true;
+    }
+
+    if (build && !search_failed) {
       // Try to find a new path, but continue to use the old one if we can't find a new one.
-      auto new_path = pathfinder->FindPath(game.connection.map, self->position, target, radius, self->frequency);
+      path::Path new_path;
+
+      if (query_type == PathQueryType::DistanceField) {
+        path::DistanceField& field = pathfinder->GetDistanceField(map, target, radius, self->frequency);
+
+        new_path = field.BuildPath(self->position);
+      }
 
       if (!new_path.Empty()) {
         current_path = new_path;
+      } else {
+        // The field can't reach goals that are inside of walls, so search for those the normal way.
+        RequestPath(ctx, *self, target, radius);
       }
 
       if (current_path.points.size() > 10) {
@@ -433,21 +510,63 @@ struct GoToNode : public BehaviorNode {
       }
     }
 
+    // Steer straight at the target while the first path is being searched.
+    if (current_path.Empty() && path_request && path_request->IsPending()) {
+      ctx.bot->bot_controller->steering.Seek(game, target);
+      return ExecuteResult::Running;
+    }
+
     return follow_node.Execute(ctx);
   }
 
  private:
+  void RequestPath(ExecuteContext& ctx, Player& self, Vector2f target, float radius) {
+    auto& path_request = ctx.bot->bot_controller->path_request;
+
+    // Keep waiting on the pending search if it's already going to the target.
+    if (path_request && path_request->IsPending() && target.DistanceSq(path_request->GetGoal()) <= 3.0f * 3.0f) {
+      return;
+    }
+
+    // The target moved, so the old search is no longer useful.
+    ctx.bot->bot_controller->CancelPathRequest();
+
+    path::Pathfinder::SearchMode mode = ctx.bot->bot_controller->pathfinder->GetSearchMode();
+
+    if (query_type == PathQueryType::Hierarchical) {
+      // Only the start of a hierarchical path is refined since it gets rebuilt as it's followed.
+      mode = path::Pathfinder::SearchMode::Hierarchical;
+    } else if (query_type == PathQueryType::Incremental) {
+      mode = path::Pathfinder::SearchMode::Incremental;
+    } else if (query_type == PathQueryType::Bidirectional) {
+      mode = path::Pathfinder::SearchMode::Bidirectional;
+    } else if (query_type == PathQueryType::Scheduled) {
+      mode = path::Pathfinder::SearchMode::TimeExpanded;
+    }
+
+    path_request = ctx.bot->bot_controller->pathfinder->RequestPath(ctx.bot->game->connection.map, self.position,
+                                                                    target, radius, self.frequency, mode);
+  }
+
   FollowPathNode follow_node;
 
   Vector2f position;
   const char* position_key;
+  PathQueryType query_type;
 };
 
 struct PathDistanceQueryNode : public BehaviorNode {
   PathDistanceQueryNode(const char* output_key) : output_key(output_key) {}
   PathDistanceQueryNode(const char* path_key, const char* output_key) : path_key(path_key), output_key(output_key) {}
+  // Reads the distance from the distance field of the goal position instead of walking a path.
+  PathDistanceQueryNode(const char* position_key, const char* output_key, PathQueryType query_type)
+      : position_key(position_key), output_key(output_key), query_type(query_type) {}
 
   ExecuteResult Execute(ExecuteContext& ctx) override {
+    if (query_type == PathQueryType::DistanceField) {
+      return ExecuteDistanceField(ctx);
+    }
+
     path::Path path;
 
     if (path_key) {
@@ -476,8 +595,31 @@ struct PathDistanceQueryNode : public BehaviorNode {
     return ExecuteResult::Success;
   }
 
+  ExecuteResult ExecuteDistanceField(ExecuteContext& ctx) {
+    Player* self = ctx.bot->game->player_manager.GetSelf();
+    if (!self || self->ship >= 8) return ExecuteResult::Failure;
+
+    auto opt_position = ctx.blackboard.Value<Vector2f>(position_key);
+    if (!opt_position) return ExecuteResult::Failure;
+
+    auto& game = *ctx.bot->game;
+    auto& pathfinder = ctx.bot->bot_controller->pathfinder;
+    float radius = game.connection.settings.ShipSettings[self->ship].GetRadius();
+
+    path::DistanceField& field = pathfinder->GetDistanceField(game.GetMap(), *opt_position, radius, self->frequency);
+    float distance = field.GetDistance(path::NodePoint((u16)self->position.x, (u16)self->position.y));
+
+    if (distance < 0.0f) return ExecuteResult::Failure;
+
+    ctx.blackboard.Set<float>(output_key, distance);
+
+    return ExecuteResult::Success;
+  }
+
   const char* path_key = nullptr;
+  const char* position_key = nullptr;
   const char* output_key = nullptr;
+  PathQueryType query_type = PathQueryType::Search;
 };
 
 }  // namespace behavior
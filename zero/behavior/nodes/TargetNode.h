@@ -1,12 +1,47 @@
 #pragma once
 
+#include <zero/BotController.h>
 #include <zero/ZeroBot.h>
 #include <zero/behavior/BehaviorTree.h>
 #include <zero/game/Game.h>
 
+#include <vector>
+
 namespace zero {
 namespace behavior {
 
+// Returns the index of the candidate that is closest to self by path, or -1 if there are no candidates.
+// The closest candidate by straight-line distance is used when none of them can be reached by path, or when the
+// search gives up before reaching any of them.
+inline int GetNearestByPath(ZeroBot& bot, const Player& self, const std::vector<Vector2f>& candidates) {
+  if (candidates.empty()) return -1;
+  if (candidates.size() == 1) return 0;
+
+  path::Pathfinder* pathfinder = bot.bot_controller->pathfinder;
+
+  if (pathfinder && !bot.bot_controller->IsPathfinderPending() && self.ship < 8) {
+    float radius = bot.game->connection.settings.ShipSettings[self.ship].GetRadius();
+
+    auto nearest = pathfinder->FindNearest(bot.game->GetMap(), self.position, candidates, radius, self.frequency, 1);
+
+    if (!nearest.empty()) return (int)nearest[0].index;
+  }
+
+  int best_index = 0;
+  float closest_dist_sq = std::numeric_limits<float>::max();
+
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    float dist_sq = candidates[i].DistanceSq(self.position);
+
+    if (dist_sq < closest_dist_sq) {
+      closest_dist_sq = dist_sq;
+      best_index = (int)i;
+    }
+  }
+
+  return best_index;
+}
+
 // Returns success if the provided position is within a provided view angle
 struct HeadingPositionViewNode : public behavior::BehaviorNode {
   HeadingPositionViewNode(const char* position_key, float view_radians)
@@ -57,6 +92,7 @@ struct HeadingDirectionViewNode : public behavior::BehaviorNode {
   float view_radians;
 };
 
+// Finds the enemy that is closest by path.
 // If obey_stealth is true, then we will ignore players that we can't see.
 struct NearestTargetNode : public behavior::BehaviorNode {
   NearestTargetNode(const char* player_key, bool obey_stealth = false)
@@ -107,8 +143,8 @@ struct NearestTargetNode : public behavior::BehaviorNode {
     Game& game = *ctx.bot->game;
     RegionRegistry& region_registry = *ctx.bot->bot_controller->region_registry;
 
-    Player* best_target = nullptr;
-    float closest_dist_sq = std::numeric_limits<float>::max();
+    std::vector<Player*> targets;
+    std::vector<Vector2f> positions;
 
     for (size_t i = 0; i < game.player_manager.player_count; ++i) {
       Player* player = game.player_manager.players + i;
@@ -125,14 +161,13 @@ struct NearestTargetNode : public behavior::BehaviorNode {
 
       if (obey_stealth && !IsVisible(ctx.bot->game->connection.settings, self, *player)) continue;
 
-      float dist_sq = player->position.DistanceSq(self.position);
-      if (dist_sq < closest_dist_sq) {
-        closest_dist_sq = dist_sq;
-        best_target = player;
-      }
+      targets.push_back(player);
+      positions.push_back(player->position);
     }
 
-    return best_target;
+    int nearest_index = GetNearestByPath(*ctx.bot, self, positions);
+
+    return nearest_index >= 0 ? targets[nearest_index] : nullptr;
   }
 
   bool obey_stealth = false;
@@ -9,6 +9,7 @@
 #include <zero/game/Game.h>
 #include <zero/game/Logger.h>
 #include <zero/game/net/PacketDispatcher.h>
+#include <zero/path/PathBenchmark.h>
 
 namespace zero {
 
@@ -316,6 +317,222 @@ class SetShipCommand : public CommandExecutor {
   std::string GetDescription() override { return "Sets the ship"; }
 };
 
+class PathBenchmarkCommand : public CommandExecutor {
+ public:
+  void Execute(CommandSystem& cmd, ZeroBot& bot, const std::string& sender, const std::string& arg) override {
+    if (sender.empty()) return;
+
+    Player* self = bot.game->player_manager.GetSelf();
+    if (!self || self->ship >= 8 || !bot.bot_controller->pathfinder) {
+      Event::Dispatch(ChatQueueEvent::Private(sender.data(), "Pathfinder is not ready."));
+      return;
+    }
+
+    int path_count = 50;
+
+    if (!arg.empty()) {
+      path_count = atoi(arg.data());
+    }
+
+    if (path_count <= 0 || path_count > 1000) {
+      Event::Dispatch(ChatQueueEvent::Private(sender.data(), "Usage: !pathbench [count 1-1000]"));
+      return;
+    }
+
+    float radius = bot.game->connection.settings.ShipSettings[self->ship].GetRadius();
+    auto results = path::RunPathBenchmark(*bot.bot_controller->pathfinder, bot.game->GetMap(), radius,
+                                          (size_t)path_count, GetCurrentTick());
+
+    for (auto& result : results) {
+      char message[256];
+
+      snprintf(message, sizeof(message), "%s: %zu paths, %zu expanded, %llu us, %zu cost mismatches",
+               path::to_string(result.mode), result.path_count, result.nodes_expanded,
+               (unsigned long long)result.microseconds, result.cost_mismatches);
+
+      Event::Dispatch(ChatQueueEvent::Private(sender.data(), message));
+    }
+    // Each queue search covers the entire map, so only a few are needed.
+    constexpr size_t kQueueSearchCount = 4;
+
+    auto queue_results =
+        path::RunQueueBenchmark(bot.bot_controller->pathfinder->GetProcessor(), kQueueSearchCount, GetCurrentTick());
+
+    for (auto& result : queue_results) {
+      char message[256];
+
+      snprintf(message, sizeof(message), "Queue %s: %zu searches, %zu expanded, %llu us, %zu cost mismatches",
+               path::to_string(result.type), result.search_count, result.nodes_expanded,
+               (unsigned long long)result.microseconds, result.cost_mismatches);
+
+      Event::Dispatch(ChatQueueEvent::Private(sender.data(), message));
+    }
+  }
+
+  CommandAccessFlags GetAccess() override { return CommandAccess_Private | CommandAccess_RemotePrivate; }
+  std::vector<std::string> GetAliases() override { return {"pathbench"}; }
+  std::string GetDescription() override { return "Compares the speed of each pathfinding search mode and open set queue."; }
+};
+
+class RegionBenchmarkCommand : public CommandExecutor {
+ public:
+  void Execute(CommandSystem& cmd, ZeroBot& bot, const std::string& sender, const std::string& arg) override {
+    if (sender.empty()) return;
+
+    Player* self = bot.game->player_manager.GetSelf();
+    if (!self || self->ship >= 8) {
+      Event::Dispatch(ChatQueueEvent::Private(sender.data(), "Must be in a ship to benchmark its regions."));
+      return;
+    }
+
+    float radius = bot.game->connection.settings.ShipSettings[self->ship].GetRadius();
+    auto results = path::RunRegionBenchmark(bot.game->GetMap(), radius);
+
+    for (auto& result : results) {
+      char message[256];
+
+      if (result.thread_count == 0) {
+        snprintf(message, sizeof(message), "Flood fill: %u regions, %llu us", result.region_count,
+                 (unsigned long long)result.microseconds);
+      } else {
+        snprintf(message, sizeof(message), "Labeling %zu threads: %u regions, %llu us, %zu label mismatches",
+                 result.thread_count, result.region_count, (unsigned long long)result.microseconds,
+                 result.label_mismatches);
+      }
+
+      Event::Dispatch(ChatQueueEvent::Private(sender.data(), message));
+    }
+  }
+
+  CommandAccessFlags GetAccess() override { return CommandAccess_Private | CommandAccess_RemotePrivate; }
+  std::vector<std::string> GetAliases() override { return {"regionbench"}; }
+  std::string GetDescription() override {
+    return "Compares the region flood fill to the parallel labeling at each thread count.";
+  }
+};
+
+class OccupancyBenchmarkCommand : public CommandExecutor {
+ public:
+  void Execute(CommandSystem& cmd, ZeroBot& bot, const std::string& sender, const std::string& arg) override {
+    if (sender.empty()) return;
+
+    Player* self = bot.game->player_manager.GetSelf();
+    if (!self || !bot.game->GetMap().tiles) {
+      Event::Dispatch(ChatQueueEvent::Private(sender.data(), "Map is not loaded."));
+      return;
+    }
+
+    int sample_count = 100000;
+
+    if (!arg.empty()) {
+      sample_count = atoi(arg.data());
+    }
+
+    if (sample_count <= 0 || sample_count > 10000000) {
+      Event::Dispatch(ChatQueueEvent::Private(sender.data(), "Usage: !occupancybench [count 1-10000000]"));
+      return;
+    }
+
+    auto results =
+        path::RunOccupancyBenchmark(bot.game->GetMap(), self->frequency, (size_t)sample_count, GetCurrentTick());
+
+    for (auto& result : results) {
+      char message[256];
+
+      snprintf(message, sizeof(message), "%s: %zu samples, %llu us, reference %llu us, %zu mismatches",
+               path::to_string(result.predicate), result.sample_count, (unsigned long long)result.microseconds,
+               (unsigned long long)result.reference_microseconds, result.mismatches);
+
+      Event::Dispatch(ChatQueueEvent::Private(sender.data(), message));
+    }
+  }
+
+  CommandAccessFlags GetAccess() override { return CommandAccess_Private | CommandAccess_RemotePrivate; }
+  std::vector<std::string> GetAliases() override { return {"occupancybench"}; }
+  std::string GetDescription() override {
+    return "Compares the occupancy checks to the tile by tile versions at random positions.";
+  }
+};
+
+class PathCacheCommand : public CommandExecutor {
+ public:
+  void Execute(CommandSystem& cmd, ZeroBot& bot, const std::string& sender, const std::string& arg) override {
+    if (sender.empty()) return;
+
+    auto& pathfinder = bot.bot_controller->pathfinder;
+
+    if (!pathfinder) {
+      Event::Dispatch(ChatQueueEvent::Private(sender.data(), "Pathfinder is not ready."));
+      return;
+    }
+
+    if (!arg.empty()) {
+      int size = atoi(arg.data());
+
+      if (size < 0 || size > 4096) {
+        Event::Dispatch(ChatQueueEvent::Private(sender.data(), "Usage: !pathcache [size 0-4096]"));
+        return;
+      }
+
+      pathfinder->SetPathCacheSize((size_t)size);
+    }
+
+    const path::Pathfinder::PathCacheStats& stats = pathfinder->GetPathCacheStats();
+    char message[256];
+
+    snprintf(message, sizeof(message), "Path cache: %zu/%zu paths, %llu hits, %llu splices, %llu misses",
+             pathfinder->GetPathCacheCount(), pathfinder->GetPathCacheSize(), (unsigned long long)stats.hits,
+             (unsigned long long)stats.splices, (unsigned long long)stats.misses);
+
+    Event::Dispatch(ChatQueueEvent::Private(sender.data(), message));
+  }
+
+  CommandAccessFlags GetAccess() override { return CommandAccess_Private | CommandAccess_RemotePrivate; }
+  std::vector<std::string> GetAliases() override { return {"pathcache"}; }
+  std::string GetDescription() override { return "Shows the path cache counters and optionally sets its size."; }
+};
+
+class PathMemoryCommand : public CommandExecutor {
+ public:
+  void Execute(CommandSystem& cmd, ZeroBot& bot, const std::string& sender, const std::string& arg) override {
+    if (sender.empty()) return;
+
+    auto& pathfinder = bot.bot_controller->pathfinder;
+    auto& region_registry = bot.bot_controller->region_registry;
+
+    if (!pathfinder || !region_registry) {
+      Event::Dispatch(ChatQueueEvent::Private(sender.data(), "Pathfinder is not ready."));
+      return;
+    }
+
+    path::Pathfinder::MemoryUsage usage = pathfinder->GetMemoryUsage();
+    size_t regions = region_registry->GetMemoryUsage();
+    size_t blocks = pathfinder->GetProcessor().GetAllocatedBlockCount();
+    char message[256];
+
+    constexpr float kKilobyte = 1024.0f;
+
+    snprintf(message, sizeof(message), "Graph: %.0f KB (%zu/%zu blocks), Regions: %.0f KB", usage.graph / kKilobyte,
+             blocks, path::kNodeBlockCount, regions / kKilobyte);
+    Event::Dispatch(ChatQueueEvent::Private(sender.data(), message));
+
+    snprintf(message, sizeof(message),
+             "Search states: %.0f KB, Abstract graph: %.0f KB, Incremental: %.0f KB, Distance fields: %.0f KB",
+             usage.search_states / kKilobyte, usage.abstract_graph / kKilobyte, usage.incremental / kKilobyte,
+             usage.distance_fields / kKilobyte);
+    Event::Dispatch(ChatQueueEvent::Private(sender.data(), message));
+
+    snprintf(message, sizeof(message), "Wall distances: %.0f KB, Path cache: %.0f KB, Total: %.0f KB",
+             usage.wall_distances / kKilobyte, usage.path_cache / kKilobyte,
+             (usage.GetTotal() + regions) / kKilobyte);
+    Event::Dispatch(ChatQueueEvent::Private(sender.data(), message));
+  }
+
+  CommandAccessFlags GetAccess() override { return CommandAccess_Private | CommandAccess_RemotePrivate; }
+  std::vector<std::string> GetAliases() override { return {"pathmemory"}; }
+  std::string GetDescription() override { return "Shows how much memory each part of the pathfinder uses."; }
+};
+
 class HelpCommand : public CommandExecutor {
  public:
   void Execute(CommandSystem& cmd, ZeroBot& bot, const std::string& sender, const std::string& arg) override {
@@ -435,6 +652,11 @@ CommandSystem::CommandSystem(ZeroBot& bot, PacketDispatcher& dispatcher) : bot(b
   default_commands_.emplace_back(std::make_shared<BehaviorsCommand>());
   default_commands_.emplace_back(std::make_shared<QuitCommand>());
   default_commands_.emplace_back(std::make_shared<ReloadCommand>());
+  default_commands_.emplace_back(std::make_shared<PathBenchmarkCommand>());
+  default_commands_.emplace_back(std::make_shared<RegionBenchmarkCommand>());
+  default_commands_.emplace_back(std::make_shared<OccupancyBenchmarkCommand>());
+  default_commands_.emplace_back(std::make_shared<PathCacheCommand>());
+  default_commands_.emplace_back(std::make_shared<PathMemoryCommand>());
 
   Reset();
 }
@@ -596,6 +818,11 @@ void CommandSystem::SetDefaultSecurityLevels() {
   SetCommandSecurityLevel("commands", 0);
   SetCommandSecurityLevel("quit", 10);
   SetCommandSecurityLevel("reload", 10);
+  SetCommandSecurityLevel("pathbench", 10);
+  SetCommandSecurityLevel("pathcache", 10);
+  SetCommandSecurityLevel("regionbench", 10);
+  SetCommandSecurityLevel("occupancybench", 10);
+  SetCommandSecurityLevel("pathmemory", 10);
 }
 
 void CommandSystem::SetCommandSecurityLevel(const std::string& name, int level) {
@@ -1,6 +1,7 @@
 #include "Map.h"
 
 #include <assert.h>
+#include <bit>
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
@@ -14,18 +15,19 @@
 
 namespace zero {
 
+// Returns a mask of the lowest count bits for testing rows from GetSolidRow.
+inline static u64 GetRowMask(s32 count) {
+  return count >= 64 ? ~0ULL : (1ULL << count) - 1;
+}
+
 inline static bool CornerPointCheck(const Map& map, int sX, int sY, int diameter, u32 frequency) {
-  for (int y = 0; y < diameter; ++y) {
-    for (int x = 0; x < diameter; ++x) {
-      uint16_t world_x = (uint16_t)(sX + x);
-      uint16_t world_y = (uint16_t)(sY + y);
+  return !map.IsRectSolid(sX, sY, sX + diameter - 1, sY + diameter - 1, frequency);
+}
 
-      if (map.IsSolid(world_x, world_y, frequency)) {
-        return false;
-      }
-    }
-  }
-  return true;
+// Converts a position to a tile the same way that casting it to u16 does for tile lookups. Anything below -1 wraps
+// to outside of the map, so it's returned as -1.
+inline static s32 GetTileCoord(float position) {
+  return position > -1.0f ? (s32)position : -1;
 }
 
 bool Map::CanTraverse(const Vector2f& start, const Vector2f& end, float radius, u32 frequency) const {
@@ -100,18 +102,10 @@ bool Map::CanOverlapTile(const Vector2f& position, float radius, u32 frequency)
 
       if (dir_x == 0) continue;
 
-      bool can_fit = true;
+      s32 left = dir_x > 0 ? check_x : check_x - d;
+      s32 top = dir_y > 0 ? check_y : check_y - d;
 
-      for (s16 y = check_y; std::abs(y - check_y) <= d && can_fit; y += dir_y) {
-        for (s16 x = check_x; std::abs(x - check_x) <= d; x += dir_x) {
-          if (IsSolidEmptyDoors(x, y, frequency)) {
-            can_fit = false;
-            break;
-          }
-        }
-      }
-
-      if (can_fit) {
+      if (!IsRectSolidEmptyDoors(left, top, left + d, top + d, frequency)) {
         return true;
       }
     }
@@ -126,18 +120,8 @@ bool Map::CanOccupy(const Vector2f& position, float radius, u32 frequency) const
 
   int radius_check = (int)(radius + 0.5f);
 
-  for (int y = -radius_check; y <= radius_check; ++y) {
-    for (int x = -radius_check; x <= radius_check; ++x) {
-      uint16_t world_x = (uint16_t)(position_x + x);
-      uint16_t world_y = (uint16_t)(position_y + y);
-
-      if (IsSolid(world_x, world_y, frequency)) {
-        return false;
-      }
-    }
-  }
-
-  return true;
+  return !IsRectSolid(position_x - radius_check, position_y - radius_check, position_x + radius_check,
+                      position_y + radius_check, frequency);
 #if 0
   /* Convert the ship into a tiled grid and put each tile of the ship on the test
      position.
@@ -175,16 +159,8 @@ bool Map::CanOccupyRadius(const Vector2f& position, float radius, u32 frequency)
 
   radius = floorf(radius + 0.5f);
 
-  for (float y = -radius; y <= radius; ++y) {
-    for (float x = -radius; x <= radius; ++x) {
-      uint16_t world_x = (uint16_t)(position.x + x);
-      uint16_t world_y = (uint16_t)(position.y + y);
-      if (IsSolid(world_x, world_y, frequency)) {
-        return false;
-      }
-    }
-  }
-  return true;
+  return !IsRectSolid(GetTileCoord(position.x - radius), GetTileCoord(position.y - radius),
+                      GetTileCoord(position.x + radius), GetTileCoord(position.y + radius), frequency);
 }
 
 OccupyRect Map::GetClosestOccupyRect(Vector2f position, float radius, Vector2f point) const {
@@ -695,6 +671,11 @@ bool Map::LoadFromMemory(MemoryArena& arena, const char* filename, const u8* raw
     }
   }
 
+  u64* solid_words = (u64*)arena.Allocate(kSolidDataWordCount * sizeof(u64), 8);
+  if (!solid_words) return false;
+
+  AttachSolidData(solid_words);
+
   return true;
 }
 
@@ -712,6 +693,95 @@ size_t Map::GetTileCount(Tile* tiles, size_t tile_count, TileId id_begin, TileId
   return count;
 }
 
+u8 GetNextDoorSeed(VieRNG& rng, s32 door_mode) {
+  u8 seed = rng.seed;
+
+  if (door_mode == -2) {
+    seed = rng.GetNext();
+  } else if (door_mode == -1) {
+    u32 table[7];
+
+    for (size_t j = 0; j < 7; ++j) {
+      table[j] = rng.GetNext();
+    }
+
+    table[6] &= 0x8000000F;
+    if ((s32)table[6] < 0) {
+      table[6] = ((table[6] - 1) | 0xFFFFFFF0) + 1;
+    }
+    table[6] = -(s32)(table[6] != 0) & 0x80;
+
+    table[5] &= 0x80000007;
+    if ((s32)table[5] < 0) {
+      table[5] = ((table[5] - 1) | 0xFFFFFFF8) + 1;
+    }
+    table[5] = -(s32)(table[5] != 0) & 0x40;
+
+    table[4] &= 0x80000003;
+    if ((s32)table[4] < 0) {
+      table[4] = ((table[4] - 1) | 0xFFFFFFFC) + 1;
+    }
+    table[4] = -(s32)(table[4] != 0) & 0x20;
+
+    table[3] &= 0x8000000F;
+    if ((s32)table[3] < 0) {
+      table[3] = ((table[3] - 1) | 0xFFFFFFF0) + 1;
+    }
+    table[3] = -(s32)(table[3] != 0) & 0x8;
+
+    table[2] &= 0x80000007;
+    if ((s32)table[2] < 0) {
+      table[2] = ((table[2] - 1) | 0xFFFFFFF8) + 1;
+    }
+    table[2] = -(s32)(table[2] != 0) & 0x4;
+
+    table[1] &= 0x80000003;
+    if ((s32)table[1] < 0) {
+      table[1] = ((table[1] - 1) | 0xFFFFFFFC) + 1;
+    }
+    table[1] = -(s32)(table[1] != 0) & 0x2;
+
+    table[0] &= 0x80000001;
+    if ((s32)table[0] < 0) {
+      table[0] = ((table[0] - 1) | 0xFFFFFFFE) + 1;
+    }
+    table[0] = -(s32)(table[0] != 0) & 0x11;
+
+    seed = table[6] + table[5] + table[4] + table[3] + table[2] + table[1] + table[0];
+  } else if (door_mode >= 0) {
+    seed = (u8)door_mode;
+  }
+
+  return seed;
+}
+
+void GetDoorTable(u8 seed, TileId table[8]) {
+  u8 bottom = seed & 0xFF;
+
+  table[0] = ((~bottom & 1) << 3) | 0xA2;
+  table[1] = (-((bottom & 2) != 0) & 0xF9) + 0xAA;
+  table[2] = (-((bottom & 4) != 0) & 0xFA) + 0xAA;
+  table[3] = (-((bottom & 8) != 0) & 0xFB) + 0xAA;
+  table[4] = (-((bottom & 0x10) != 0) & 0xFC) + 0xAA;
+  table[5] = (-((bottom & 0x20) != 0) & 0xFD) + 0xAA;
+  table[6] = (~(bottom >> 5) & 2) | 0xA8;
+  table[7] = 0xAA - ((bottom & 0x80) != 0);
+}
+
+u8 GetOpenDoorMask(const Map& map) {
+  u8 mask = 0;
+
+  for (size_t i = 0; i < map.door_count; ++i) {
+    const Tile& door = map.doors[i];
+
+    if (map.GetTileId(door.x, door.y) == kTileIdOpenDoor) {
+      mask |= (1 << (door.id - kTileIdFirstDoor));
+    }
+  }
+
+  return mask;
+}
+
 void Map::UpdateDoors(const ArenaSettings& settings) {
   u32 current_tick = GetCurrentTick();
 
@@ -730,85 +800,22 @@ void Map::UpdateDoors(const ArenaSettings& settings) {
   }
 
   for (s32 i = 0; i < count; ++i) {
-    u8 seed = door_rng.seed;
-
-    if (settings.DoorMode == -2) {
-      seed = door_rng.GetNext();
-    } else if (settings.DoorMode == -1) {
-      u32 table[7];
-
-      for (size_t j = 0; j < 7; ++j) {
-        table[j] = door_rng.GetNext();
-      }
-
-      table[6] &= 0x8000000F;
-      if ((s32)table[6] < 0) {
-        table[6] = ((table[6] - 1) | 0xFFFFFFF0) + 1;
-      }
-      table[6] = -(s32)(table[6] != 0) & 0x80;
-
-      table[5] &= 0x80000007;
-      if ((s32)table[5] < 0) {
-        table[5] = ((table[5] - 1) | 0xFFFFFFF8) + 1;
-      }
-      table[5] = -(s32)(table[5] != 0) & 0x40;
-
-      table[4] &= 0x80000003;
-      if ((s32)table[4] < 0) {
-        table[4] = ((table[4] - 1) | 0xFFFFFFFC) + 1;
-      }
-      table[4] = -(s32)(table[4] != 0) & 0x20;
-
-      table[3] &= 0x8000000F;
-      if ((s32)table[3] < 0) {
-        table[3] = ((table[3] - 1) | 0xFFFFFFF0) + 1;
-      }
-      table[3] = -(s32)(table[3] != 0) & 0x8;
-
-      table[2] &= 0x80000007;
-      if ((s32)table[2] < 0) {
-        table[2] = ((table[2] - 1) | 0xFFFFFFF8) + 1;
-      }
-      table[2] = -(s32)(table[2] != 0) & 0x4;
-
-      table[1] &= 0x80000003;
-      if ((s32)table[1] < 0) {
-        table[1] = ((table[1] - 1) | 0xFFFFFFFC) + 1;
-      }
-      table[1] = -(s32)(table[1] != 0) & 0x2;
+    u8 seed = GetNextDoorSeed(door_rng, settings.DoorMode);
 
-      table[0] &= 0x80000001;
-      if ((s32)table[0] < 0) {
-        table[0] = ((table[0] - 1) | 0xFFFFFFFE) + 1;
-      }
-      table[0] = -(s32)(table[0] != 0) & 0x11;
-
-      seed = table[6] + table[5] + table[4] + table[3] + table[2] + table[1] + table[0];
-    } else if (settings.DoorMode >= 0) {
-      seed = (u8)settings.DoorMode;
-    }
+    SeedDoors(seed);
+    last_seed_tick += delay;
 
+    // This is dispatched after the doors change so handlers can read the new door state.
     if (settings.DoorMode < 0 && settings.DoorDelay > 0 && door_count > 0) {
       Event::Dispatch(DoorToggleEvent());
     }
-
-    SeedDoors(seed);
-    last_seed_tick += delay;
   }
 }
 
 void Map::SeedDoors(u32 seed) {
-  u8 bottom = seed & 0xFF;
-  u8 table[8];
+  TileId table[8];
 
-  table[0] = ((~bottom & 1) << 3) | 0xA2;
-  table[1] = (-((bottom & 2) != 0) & 0xF9) + 0xAA;
-  table[2] = (-((bottom & 4) != 0) & 0xFA) + 0xAA;
-  table[3] = (-((bottom & 8) != 0) & 0xFB) + 0xAA;
-  table[4] = (-((bottom & 0x10) != 0) & 0xFC) + 0xAA;
-  table[5] = (-((bottom & 0x20) != 0) & 0xFD) + 0xAA;
-  table[6] = (~(bottom >> 5) & 2) | 0xA8;
-  table[7] = 0xAA - ((bottom & 0x80) != 0);
+  GetDoorTable(seed, table);
 
   PlayerManager* player_manager = nullptr;
   Player* self = nullptr;
@@ -835,13 +842,12 @@ void Map::SeedDoors(u32 seed) {
 
     u8 id = table[door->id - kTileIdFirstDoor];
 
-    constexpr TileId kOpenDoorId = kTileIdLastDoor + 1;
-
     TileId previous_id = tiles[door->y * 1024 + door->x];
     tiles[door->y * 1024 + door->x] = id;
+    UpdateSolidBits(door->x, door->y, previous_id, id);
 
     // If the tile just changed from open to closed then check for collisions
-    if (self && previous_id == kOpenDoorId && id != kOpenDoorId) {
+    if (self && previous_id == kTileIdOpenDoor && id != kTileIdOpenDoor) {
       Vector2f door_position((float)door->x, (float)door->y);
 
       // Perform door warp on overlap
@@ -853,15 +859,13 @@ void Map::SeedDoors(u32 seed) {
 }
 
 bool Map::CanFit(const Vector2f& position, float radius, u32 frequency) const {
-  for (float y_offset_check = -radius; y_offset_check < radius; ++y_offset_check) {
-    for (float x_offset_check = -radius; x_offset_check < radius; ++x_offset_check) {
-      if (IsSolid((u16)(position.x + x_offset_check), (u16)(position.y + y_offset_check), frequency)) {
-        return false;
-      }
-    }
-  }
+  if (radius <= 0.0f) return true;
 
-  return true;
+  // The offsets step from -radius by whole tiles while they're less than the radius.
+  float last_offset = -radius + (float)((s32)ceilf(radius * 2.0f) - 1);
+
+  return !IsRectSolid(GetTileCoord(position.x - radius), GetTileCoord(position.y - radius),
+                      GetTileCoord(position.x + last_offset), GetTileCoord(position.y + last_offset), frequency);
 }
 
 Vector2f Map::ResolveShipCollision(Vector2f position, float radius, u32 frequency) const {
@@ -960,7 +964,10 @@ void Map::SetTileId(u16 x, u16 y, TileId id) {
   if (!tiles) return;
   if (x >= 1024 || y >= 1024) return;
 
+  TileId previous_id = tiles[y * 1024 + x];
+
   tiles[y * 1024 + x] = id;
+  UpdateSolidBits(x, y, previous_id, id);
 }
 
 TileId Map::GetTileId(const Vector2f& position) const {
@@ -990,7 +997,7 @@ bool Map::IsDoor(u16 x, u16 y) const {
   return false;
 }
 
-bool Map::IsSolid(u16 x, u16 y, u32 frequency) const {
+bool Map::IsSolidTile(u16 x, u16 y, u32 frequency) const {
   TileId id = GetTileId(x, y);
 
   if (id == 250 && brick_manager) {
@@ -1004,7 +1011,7 @@ bool Map::IsSolid(u16 x, u16 y, u32 frequency) const {
   return zero::IsSolid(id);
 }
 
-bool Map::IsSolidEmptyDoors(u16 x, u16 y, u32 frequency) const {
+bool Map::IsSolidEmptyDoorsTile(u16 x, u16 y, u32 frequency) const {
   TileId id = GetTileId(x, y);
 
   if (id == 250 && brick_manager) {
@@ -1018,6 +1025,245 @@ bool Map::IsSolidEmptyDoors(u16 x, u16 y, u32 frequency) const {
   return zero::IsSolidEmptyDoors(id);
 }
 
+bool Map::IsTeamBrick(u16 x, u16 y, u32 frequency) const {
+  if (!brick_manager) return false;
+
+  Brick* brick = brick_manager->GetBrick(x, y);
+
+  return brick && brick->team == frequency;
+}
+
+u64 Map::GetSolidRow(s32 x, s32 y, u32 frequency) const {
+  return GetSolidRow(solid_bits, false, x, y, frequency);
+}
+
+u64 Map::GetSolidRowEmptyDoors(s32 x, s32 y, u32 frequency) const {
+  return GetSolidRow(solid_empty_doors_bits, true, x, y, frequency);
+}
+
+// Returns the 64 bits that start at x from a bitmap row. Words outside of the row are filled with the outside value.
+inline static u64 GetRowBits(const u64* row, s32 x, u64 outside) {
+  s32 word = x >> 6;
+  s32 shift = x & 63;
+
+  auto get_word = [row, outside](s32 word) {
+    return (word < 0 || word >= (s32)kSolidWordsPerRow) ? outside : row[word];
+  };
+
+  u64 result = get_word(word) >> shift;
+
+  if (shift > 0) {
+    result |= get_word(word + 1) << (64 - shift);
+  }
+
+  return result;
+}
+
+u64 Map::GetSolidRow(const u64* bits, bool empty_doors, s32 x, s32 y, u32 frequency) const {
+  if (!bits) {
+    u64 result = 0;
+
+    // Negative coordinates wrap to outside of the map, which is solid.
+    for (s32 i = 0; i < 64; ++i) {
+      u16 tile_x = (u16)(x + i);
+      u16 tile_y = (u16)y;
+
+      if (empty_doors ? IsSolidEmptyDoorsTile(tile_x, tile_y, frequency) : IsSolidTile(tile_x, tile_y, frequency)) {
+        result |= 1ULL << i;
+      }
+    }
+
+    return result;
+  }
+
+  if (y < 0 || y >= 1024) return ~0ULL;
+
+  size_t row_start = (size_t)y * kSolidWordsPerRow;
+  u64 result = GetRowBits(bits + row_start, x, ~0ULL);
+
+  if (brick_manager) {
+    u64 bricks = result & GetRowBits(brick_bits + row_start, x, 0);
+
+    // Only the few brick tiles in the row need to be looked up.
+    while (bricks) {
+      s32 i = std::countr_zero(bricks);
+
+      bricks &= bricks - 1;
+
+      if (IsTeamBrick((u16)(x + i), (u16)y, frequency)) {
+        result &= ~(1ULL << i);
+      }
+    }
+  }
+
+  return result;
+}
+
+bool Map::IsRectSolid(s32 left, s32 top, s32 right, s32 bottom, u32 frequency) const {
+  return IsRectSolid(solid_bits, false, left, top, right, bottom, frequency);
+}
+
+bool Map::IsRectSolidEmptyDoors(s32 left, s32 top, s32 right, s32 bottom, u32 frequency) const {
+  return IsRectSolid(solid_empty_doors_bits, true, left, top, right, bottom, frequency);
+}
+
+bool Map::IsRectSolid(const u64* bits, bool empty_doors, s32 left, s32 top, s32 right, s32 bottom,
+                      u32 frequency) const {
+  if (left < 0 || top < 0 || right > 1023 || bottom > 1023) return true;
+
+  s32 width = right - left + 1;
+  s32 height = bottom - top + 1;
+
+  if (width <= 0 || height <= 0) return false;
+
+  if (occupancy_table && width * height < 65536) {
+    u32 sum = GetOccupancySum(left, top, right, bottom);
+
+    if (sum & 0xFFFF) return true;
+
+    bool check_tiles = (sum >> 16) != 0;
+
+    // Bricks come and go too often to be in the tables, so they're found with the brick bitmap instead.
+    for (s32 y = top; y <= bottom && !check_tiles && brick_tile_count > 0; ++y) {
+      const u64* row = brick_bits + (size_t)y * kSolidWordsPerRow;
+
+      for (s32 x = left; x <= right; x += 64) {
+        u64 mask = GetRowMask(right - x + 1);
+
+        if (GetRowBits(row, x, 0) & mask) {
+          check_tiles = true;
+          break;
+        }
+      }
+    }
+
+    if (!check_tiles) return false;
+  }
+
+  for (s32 y = top; y <= bottom; ++y) {
+    for (s32 x = left; x <= right; x += 64) {
+      u64 mask = GetRowMask(right - x + 1);
+
+      if (GetSolidRow(bits, empty_doors, x, y, frequency) & mask) return true;
+    }
+  }
+
+  return false;
+}
+
+void Map::AttachSolidData(u64* words) {
+  solid_bits = words;
+  solid_empty_doors_bits = words + kSolidBitmapWords;
+  brick_bits = words + kSolidBitmapWords * 2;
+  dynamic_bits = words + kSolidBitmapWords * 3;
+  brick_tile_count = 0;
+
+  // The table is built once every tile is set instead of on each change.
+  occupancy_table = nullptr;
+
+  memset(words, 0, kSolidDataWordCount * sizeof(u64));
+
+  if (!tiles) return;
+
+  for (size_t i = 0; i < door_count; ++i) {
+    dynamic_bits[doors[i].y * kSolidWordsPerRow + (doors[i].x >> 6)] |= 1ULL << (doors[i].x & 63);
+  }
+
+  for (u16 y = 0; y < 1024; ++y) {
+    for (u16 x = 0; x < 1024; ++x) {
+      TileId id = tiles[y * 1024 + x];
+
+      if (zero::IsSolid(id) != zero::IsSolidEmptyDoors(id)) {
+        dynamic_bits[y * kSolidWordsPerRow + (x >> 6)] |= 1ULL << (x & 63);
+      }
+
+      UpdateSolidBits(x, y, 0, id);
+    }
+  }
+
+  occupancy_table = (u32*)(words + kSolidBitmapWords * 4);
+
+  BuildOccupancyTable();
+}
+
+void Map::CopySolidData(const Map& source, u64* words) {
+  if (!source.solid_bits || !source.occupancy_table) {
+    AttachSolidData(words);
+    return;
+  }
+
+  // The source's data is contiguous from the words it was attached to.
+  memcpy(words, source.solid_bits, kSolidDataWordCount * sizeof(u64));
+
+  solid_bits = words;
+  solid_empty_doors_bits = words + kSolidBitmapWords;
+  brick_bits = words + kSolidBitmapWords * 2;
+  dynamic_bits = words + kSolidBitmapWords * 3;
+  brick_tile_count = source.brick_tile_count;
+  occupancy_table = (u32*)(words + kSolidBitmapWords * 4);
+}
+
+void Map::UpdateSolidBits(u16 x, u16 y, TileId previous_id, TileId id) {
+  if (!solid_bits) return;
+
+  size_t index = (size_t)y * kSolidWordsPerRow + (x >> 6);
+  u64 bit = 1ULL << (x & 63);
+
+  auto set_bit = [index, bit](u64* bits, bool set) {
+    if (set) {
+      bits[index] |= bit;
+    } else {
+      bits[index] &= ~bit;
+    }
+  };
+
+  bool was_brick = brick_bits[index] & bit;
+  bool is_brick = id == kTileIdBrick;
+
+  if (was_brick != is_brick) {
+    brick_tile_count = is_brick ? brick_tile_count + 1 : brick_tile_count - 1;
+  }
+
+  set_bit(solid_bits, zero::IsSolid(id));
+  set_bit(solid_empty_doors_bits, zero::IsSolidEmptyDoors(id));
+  set_bit(brick_bits, is_brick);
+
+  if (!occupancy_table || (dynamic_bits[index] & bit)) return;
+
+  auto is_static_solid = [](TileId id) { return zero::IsSolid(id) && id != kTileIdBrick; };
+
+  // Only doors and bricks change during play, so this shouldn't happen outside of tools that edit the map.
+  if (is_static_solid(previous_id) != is_static_solid(id)) {
+    BuildOccupancyTable();
+  }
+}
+
+void Map::BuildOccupancyTable() {
+  memset(occupancy_table, 0, kOccupancyTableStride * sizeof(u32));
+
+  for (u16 y = 0; y < 1024; ++y) {
+    u32* row = occupancy_table + (size_t)(y + 1) * kOccupancyTableStride;
+    const u32* above = row - kOccupancyTableStride;
+    u32 sum = 0;
+
+    row[0] = 0;
+
+    for (u16 x = 0; x < 1024; ++x) {
+      TileId id = tiles[y * 1024 + x];
+      bool dynamic = dynamic_bits[y * kSolidWordsPerRow + (x >> 6)] & (1ULL << (x & 63));
+
+      // Tiles that aren't dynamic are solid in both bitmaps or neither.
+      if (dynamic) {
+        sum += 1 << 16;
+      } else if (zero::IsSolid(id) && id != kTileIdBrick) {
+        sum += 1;
+      }
+
+      row[x + 1] = above[x + 1] + sum;
+    }
+  }
+}
+
 u32 Map::GetChecksum(u32 key) const {
   constexpr u32 kTileStart = 1;
   constexpr u32 kTileEnd = 160;
@@ -1130,25 +1376,28 @@ CastResult Map::CastTo(const Vector2f& from, const Vector2f& to, u32 frequency)
   return Cast(from, direction, dist, frequency);
 }
 
+CastResult Map::CastShip(Player* player, float radius, const Vector2f& to) const {
+  return CastShip(player->position, radius, to, player->frequency);
+}
+
 // Loop over entire casted area to find minimal tiles to check against.
 // When a solid tile is found, perform a minkowski sum so the new rect can be checked against a ray.
-CastResult Map::CastShip(Player* player, float radius, const Vector2f& to) const {
+CastResult Map::CastShip(const Vector2f& position, float radius, const Vector2f& to, u32 frequency) const {
   CastResult result = {};
-  Vector2f trajectory = to.PixelRounded() - player->position.PixelRounded();
+  Vector2f trajectory = to.PixelRounded() - position.PixelRounded();
   Vector2f direction = Normalize(trajectory);
   float max_distance = trajectory.Length();
-  u32 frequency = player->frequency;
 
   Vector2f sides[] = {Perpendicular(direction), -Perpendicular(direction)};
 
-  Ray ray(player->position.PixelRounded(), direction);
+  Ray ray(position.PixelRounded(), direction);
 
-  Vector2f from_start = player->position.PixelRounded();
+  Vector2f from_start = position.PixelRounded();
   // Ignore 1 pixel in growth so it does exclusive check.
   Vector2f minkowski_growth(radius - 1.0f / 16.0f, radius - 1.0f / 16.0f);
 
   Vector2f e = to.PixelRounded();
-  Vector2f s = player->position.PixelRounded();
+  Vector2f s = position.PixelRounded();
 
   // Ignore any casts that end up in the current tile.
   if ((u16)e.x == (u16)s.x && (u16)e.y == (u16)s.y) return result;
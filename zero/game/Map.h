@@ -31,10 +31,23 @@ constexpr u32 kTileIdSafe = 171;
 constexpr u32 kTileIdGoal = 172;
 constexpr int kTileIdFirstDoor = 162;
 constexpr int kTileIdLastDoor = 169;
+// Doors are set to this id while they are open.
+constexpr TileId kTileIdOpenDoor = kTileIdLastDoor + 1;
 constexpr u32 kTileIdWormhole = 220;
+// Bricks are set to this id while they exist.
+constexpr TileId kTileIdBrick = 250;
 
 constexpr size_t kAnimatedTileCount = 7;
 
+// The solid bitmaps store a bit for each tile with 64 tiles in each word.
+constexpr size_t kSolidWordsPerRow = 1024 / 64;
+constexpr size_t kSolidBitmapWords = kSolidWordsPerRow * 1024;
+// The occupancy table is a summed-area table with an extra row and column of zeros at the start.
+constexpr size_t kOccupancyTableStride = 1024 + 1;
+constexpr size_t kOccupancyTableWords = (kOccupancyTableStride * kOccupancyTableStride * sizeof(u32) + 7) / 8;
+// The solid, empty doors, brick and dynamic bitmaps are stored one after another and then the occupancy table.
+constexpr size_t kSolidDataWordCount = kSolidBitmapWords * 4 + kOccupancyTableWords;
+
 enum class AnimatedTile { Goal, AsteroidSmall1, AsteroidSmall2, AsteroidLarge, SpaceStation, Wormhole, Flag };
 constexpr TileId kAnimatedIds[] = {172, 216, 218, 217, 219, 220, 170};
 constexpr size_t kAnimatedTileSizes[] = {1, 1, 1, 2, 6, 5, 1};
@@ -98,12 +111,53 @@ inline bool IsSolidEmptyDoors(TileId id) {
   return false;
 }
 
+// Advances the door rng and returns the seed that the next door update applies for the DoorMode setting.
+u8 GetNextDoorSeed(VieRNG& rng, s32 door_mode);
+// Fills the table with the tile id that each door id changes to when the seed is applied.
+// The table is indexed by the level's door id minus kTileIdFirstDoor.
+void GetDoorTable(u8 seed, TileId table[8]);
+
 struct Map {
   bool Load(MemoryArena& arena, const char* filename);
   bool LoadFromMemory(MemoryArena& arena, const char* filename, const u8* data, size_t size);
 
-  bool IsSolid(u16 x, u16 y, u32 frequency) const;
-  bool IsSolidEmptyDoors(u16 x, u16 y, u32 frequency) const;
+  inline bool IsSolid(u16 x, u16 y, u32 frequency) const {
+    if (!solid_bits) return IsSolidTile(x, y, frequency);
+
+    return IsSolidBit(solid_bits, x, y, frequency);
+  }
+
+  inline bool IsSolidEmptyDoors(u16 x, u16 y, u32 frequency) const {
+    if (!solid_bits) return IsSolidEmptyDoorsTile(x, y, frequency);
+
+    return IsSolidBit(solid_empty_doors_bits, x, y, frequency);
+  }
+
+  // Returns a bit for each of the 64 tiles in the row that start at x, with the lowest bit being x.
+  // Tiles outside of the map are solid. This lets neighborhood checks test a whole row at once.
+  u64 GetSolidRow(s32 x, s32 y, u32 frequency) const;
+  u64 GetSolidRowEmptyDoors(s32 x, s32 y, u32 frequency) const;
+
+  // Checks if any tile in the inclusive rect is solid. Tiles outside of the map are solid.
+  // Rects without doors or bricks are answered from the occupancy table with four lookups.
+  bool IsRectSolid(s32 left, s32 top, s32 right, s32 bottom, u32 frequency) const;
+  bool IsRectSolidEmptyDoors(s32 left, s32 top, s32 right, s32 bottom, u32 frequency) const;
+
+  // Returns the occupancy table sum of the inclusive rect. The rect must be inside of the map and the table must exist.
+  inline u32 GetOccupancySum(s32 left, s32 top, s32 right, s32 bottom) const {
+    const u32* top_row = occupancy_table + (size_t)top * kOccupancyTableStride;
+    const u32* bottom_row = occupancy_table + (size_t)(bottom + 1) * kOccupancyTableStride;
+
+    return bottom_row[right + 1] - bottom_row[left] - top_row[right + 1] + top_row[left];
+  }
+
+  // Points the solid bitmaps and occupancy table at the words and fills them from the tiles. There must be
+  // kSolidDataWordCount words. They are kept up to date by SetTileId and SeedDoors. Copies of the map that change their
+  // own tiles need to attach their own words, or they would share this map's data.
+  void AttachSolidData(u64* words);
+  // Points the solid data at the words and copies the source map's data into them instead of building it from the
+  // tiles. The tiles must match the source map's tiles.
+  void CopySolidData(const Map& source, u64* words);
 
   // This tells us if the tile is a door in the level map, but it might currently be open.
   // Use GetTileId if current state is desired.
@@ -143,6 +197,7 @@ struct Map {
   CastResult CastTo(const Vector2f& from, const Vector2f& to, u32 frequency) const;
 
   CastResult CastShip(struct Player* player, float radius, const Vector2f& to) const;
+  CastResult CastShip(const Vector2f& from, float radius, const Vector2f& to, u32 frequency) const;
 
   inline AnimatedTileSet& GetAnimatedTileSet(AnimatedTile type) { return animated_tiles[(size_t)type]; }
   inline const AnimatedTileSet& GetAnimatedTileSet(AnimatedTile type) const { return animated_tiles[(size_t)type]; }
@@ -162,10 +217,46 @@ struct Map {
 
   AnimatedTileSet animated_tiles[kAnimatedTileCount];
 
+  // Bricks are solid in both bitmaps. The brick bitmap marks them so only those tiles need the team lookup.
+  u64* solid_bits = nullptr;
+  u64* solid_empty_doors_bits = nullptr;
+  u64* brick_bits = nullptr;
+  // Doors and tiles that are only solid in one of the bitmaps depend on the check, so the table skips them.
+  u64* dynamic_bits = nullptr;
+  size_t brick_tile_count = 0;
+
+  // Counts the solid tiles that aren't dynamic or bricks in the low 16 bits and the dynamic tiles in the high 16 bits.
+  // The counts wrap, but the sum of any rect smaller than 65536 tiles still has both counts exactly.
+  u32* occupancy_table = nullptr;
+
  private:
   size_t GetTileCount(Tile* tiles, size_t tile_count, TileId id_begin, TileId id_end);
+
+  inline bool IsSolidBit(const u64* bits, u16 x, u16 y, u32 frequency) const {
+    if (x >= 1024 || y >= 1024) return true;
+
+    size_t index = (size_t)y * kSolidWordsPerRow + (x >> 6);
+    u64 bit = 1ULL << (x & 63);
+
+    if (!(bits[index] & bit)) return false;
+
+    return !(brick_bits[index] & bit) || !IsTeamBrick(x, y, frequency);
+  }
+
+  // These decode the tile id for maps without solid bitmaps.
+  bool IsSolidTile(u16 x, u16 y, u32 frequency) const;
+  bool IsSolidEmptyDoorsTile(u16 x, u16 y, u32 frequency) const;
+
+  bool IsTeamBrick(u16 x, u16 y, u32 frequency) const;
+  u64 GetSolidRow(const u64* bits, bool empty_doors, s32 x, s32 y, u32 frequency) const;
+  bool IsRectSolid(const u64* bits, bool empty_doors, s32 left, s32 top, s32 right, s32 bottom, u32 frequency) const;
+  void UpdateSolidBits(u16 x, u16 y, TileId previous_id, TileId id);
+  void BuildOccupancyTable();
 };
 
+// Returns a bit for each door id that is currently open in the map.
+u8 GetOpenDoorMask(const Map& map);
+
 }  // namespace zero
 
 #endif
@@ -0,0 +1,595 @@
+#include "AbstractGraph.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+namespace zero {
+namespace path {
+
+// Open runs along a border get one entrance for every span of this many tiles.
+constexpr size_t kMaxEntranceSpan = 8;
+
+constexpr u32 kStartNodeId = 0xFFFFFFFE;
+constexpr u32 kGoalNodeId = 0xFFFFFFFF;
+constexpr float kUnreachable = std::numeric_limits<float>::max();
+
+using QueueEntry = std::pair<float, u32>;
+using MinQueue = std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>>;
+
+static inline u32 GetTileId(NodePoint point) {
+  return (u32)point.y * 1024 + point.x;
+}
+
+static inline NodePoint GetTilePoint(u32 id) {
+  return NodePoint((u16)(id % 1024), (u16)(id / 1024));
+}
+
+static inline float Euclidean(NodePoint from, NodePoint to) {
+  float dx = (float)from.x - (float)to.x;
+  float dy = (float)from.y - (float)to.y;
+
+  return sqrtf(dx * dx + dy * dy);
+}
+
+static inline bool IsInSector(NodePoint point, NodePoint origin) {
+  return point.x >= origin.x && point.x < origin.x + kSectorSize && point.y >= origin.y &&
+         point.y < origin.y + kSectorSize;
+}
+
+static inline NodePoint GetSectorOrigin(size_t sector_index) {
+  return NodePoint((u16)((sector_index % kSectorsPerRow) * kSectorSize),
+                   (u16)((sector_index / kSectorsPerRow) * kSectorSize));
+}
+
+AbstractPath AbstractGraph::FindPath(NodePoint start, NodePoint goal, size_t refine_segments,
+                                     std::shared_ptr<const DynamicState> state) {
+  AbstractPath result;
+
+  state_ = std::move(state);
+
+  size_t start_sector_index = GetSectorIndex(start);
+  size_t goal_sector_index = GetSectorIndex(goal);
+
+  if (start_sector_index == goal_sector_index) return result;
+
+  search_dynamic_ = false;
+
+  Search(start_sector_index, start, false, start_search_);
+  Search(goal_sector_index, goal, true, goal_search_);
+
+  abstract_nodes_.clear();
+
+  MinQueue openset;
+
+  auto relax = [&](u32 id, u32 parent, float g) {
+    auto iter = abstract_nodes_.find(id);
+
+    if (iter != abstract_nodes_.end() && (iter->second.closed || iter->second.g <= g)) return;
+
+    AbstractNode& node = abstract_nodes_[id];
+
+    node.g = g;
+    node.parent = parent;
+
+    float h = id == kGoalNodeId ? 0.0f : Euclidean(GetTilePoint(id), goal);
+
+    openset.push(std::make_pair(g + h, id));
+  };
+
+  Sector& start_sector = GetSector(start_sector_index);
+
+  for (SectorNode& sector_node : start_sector.nodes) {
+    float dist = start_search_.dist[GetLocalIndex(sector_node.point)];
+
+    if (dist == kUnreachable) continue;
+
+    relax(GetTileId(sector_node.point), kStartNodeId, dist);
+  }
+
+  while (!openset.empty()) {
+    QueueEntry entry = openset.top();
+    openset.pop();
+
+    u32 id = entry.second;
+    AbstractNode& node = abstract_nodes_[id];
+
+    if (node.closed) continue;
+
+    node.closed = true;
+
+    if (id == kGoalNodeId) break;
+
+    ++result.nodes_expanded;
+
+    float g = node.g;
+    NodePoint point = GetTilePoint(id);
+    size_t sector_index = GetSectorIndex(point);
+    Sector& sector = GetSector(sector_index);
+
+    if (sector.dynamic) search_dynamic_ = true;
+
+    size_t node_count = sector.nodes.size();
+    size_t local_index = node_count;
+
+    for (size_t i = 0; i < node_count; ++i) {
+      if (sector.nodes[i].point == point) {
+        local_index = i;
+        break;
+      }
+    }
+
+    if (local_index == node_count) continue;
+
+    SectorNode& sector_node = sector.nodes[local_index];
+
+    for (size_t i = 0; i < node_count; ++i) {
+      float cost = sector.costs[local_index * node_count + i];
+
+      if (i == local_index || cost < 0.0f) continue;
+
+      relax(GetTileId(sector.nodes[i].point), id, g + cost);
+    }
+
+    const Node* from_node = processor_.PeekNode(point.x, point.y);
+
+    for (size_t i = 0; i < sector_node.exit_count; ++i) {
+      NodePoint exit = sector_node.exits[i];
+      const Node* exit_node = processor_.PeekNode(exit.x, exit.y);
+
+      relax(GetTileId(exit), id, g + GetEdgeCost(from_node, exit_node));
+    }
+
+    if (sector_index == goal_sector_index) {
+      float dist = goal_search_.dist[GetLocalIndex(point)];
+
+      if (dist != kUnreachable) {
+        relax(kGoalNodeId, id, g + dist);
+      }
+    }
+  }
+
+  auto goal_iter = abstract_nodes_.find(kGoalNodeId);
+
+  if (goal_iter == abstract_nodes_.end() || !goal_iter->second.closed) return result;
+
+  result.cost = goal_iter->second.g;
+
+  // Walk the abstract nodes back to the start so they can be refined in order.
+  std::vector<NodePoint> abstract_points;
+
+  for (u32 id = goal_iter->second.parent; id != kStartNodeId; id = abstract_nodes_[id].parent) {
+    abstract_points.push_back(GetTilePoint(id));
+  }
+
+  std::reverse(abstract_points.begin(), abstract_points.end());
+
+  std::vector<NodePoint>& points = result.points;
+  size_t refined_segments = 0;
+  bool refining = true;
+
+  points.push_back(start);
+
+  // The start sector search already has the path to the first entrance.
+  if (refine_segments > 0) {
+    AppendLocalPath(start_search_, abstract_points[0], points);
+    ++refined_segments;
+  } else {
+    result.refined_count = points.size();
+    points.push_back(abstract_points[0]);
+    refining = false;
+  }
+
+  for (size_t i = 1; i < abstract_points.size(); ++i) {
+    NodePoint from = abstract_points[i - 1];
+    NodePoint to = abstract_points[i];
+    size_t sector_index = GetSectorIndex(from);
+
+    // Crossing a border is a single step, so it's always refined.
+    if (sector_index != GetSectorIndex(to) || !refining) {
+      points.push_back(to);
+      continue;
+    }
+
+    if (refined_segments >= refine_segments) {
+      refining = false;
+      result.refined_count = points.size();
+      points.push_back(to);
+      continue;
+    }
+
+    Search(sector_index, from, false, refine_search_);
+    AppendLocalPath(refine_search_, to, points);
+    ++refined_segments;
+  }
+
+  if (refining && refined_segments < refine_segments) {
+    // The goal search stores the parent that leads toward the goal, so it can be walked forward directly.
+    u16 local_index = GetLocalIndex(abstract_points.back());
+    NodePoint origin = GetSectorOrigin(goal_sector_index);
+
+    while (goal_search_.parent[local_index] != LocalSearch::kNoParent) {
+      local_index = goal_search_.parent[local_index];
+      points.emplace_back((u16)(origin.x + local_index % kSectorSize), (u16)(origin.y + local_index / kSectorSize));
+    }
+  } else {
+    if (refining) result.refined_count = points.size();
+    points.push_back(goal);
+  }
+
+  if (result.refined_count == 0) {
+    result.refined_count = points.size();
+  }
+
+  result.dynamic = search_dynamic_;
+
+  return result;
+}
+
+void AbstractGraph::InvalidateTile(u16 x, u16 y) {
+  if (x >= 1024 || y >= 1024) return;
+
+  InvalidateSector(GetSectorIndex(NodePoint(x, y)));
+}
+
+void AbstractGraph::InvalidateDynamicSectors() {
+  if (!dynamic_sectors_found_) {
+    for (NodePoint point : processor_.dynamic_points) {
+      dynamic_sectors_.push_back(GetSectorIndex(point));
+    }
+
+    std::sort(dynamic_sectors_.begin(), dynamic_sectors_.end());
+    dynamic_sectors_.erase(std::unique(dynamic_sectors_.begin(), dynamic_sectors_.end()), dynamic_sectors_.end());
+
+    dynamic_sectors_found_ = true;
+  }
+
+  for (size_t sector_index : dynamic_sectors_) {
+    InvalidateSector(sector_index);
+  }
+}
+
+void AbstractGraph::InvalidateSector(size_t sector_index) {
+  u32 borders[4];
+
+  GetSectorBorders(sector_index, borders);
+
+  sectors_[sector_index].dirty = true;
+
+  // The neighboring sectors will see the new border version and rebuild themselves.
+  for (size_t i = 0; i < 4; ++i) {
+    if (borders[i] != kInvalidBorder) {
+      borders_[borders[i]].dirty = true;
+    }
+  }
+}
+
+AbstractGraph::Sector& AbstractGraph::GetSector(size_t sector_index) {
+  Sector& sector = sectors_[sector_index];
+  u32 borders[4];
+
+  GetSectorBorders(sector_index, borders);
+
+  for (size_t i = 0; i < 4; ++i) {
+    if (borders[i] == kInvalidBorder) continue;
+
+    if (GetBorder(borders[i]).version != sector.border_versions[i]) {
+      sector.dirty = true;
+    }
+  }
+
+  if (sector.dirty) {
+    BuildSector(sector_index);
+  }
+
+  return sector;
+}
+
+AbstractGraph::Border& AbstractGraph::GetBorder(u32 border_index) {
+  Border& border = borders_[border_index];
+
+  if (border.dirty) {
+    BuildBorder(border_index);
+  }
+
+  return border;
+}
+
+// Borders are ordered west, east, north, south.
+void AbstractGraph::GetSectorBorders(size_t sector_index, u32* borders) const {
+  size_t sector_x = sector_index % kSectorsPerRow;
+  size_t sector_y = sector_index / kSectorsPerRow;
+
+  borders[0] = sector_x > 0 ? (u32)(sector_index - 1) : kInvalidBorder;
+  borders[1] = sector_x < kSectorsPerRow - 1 ? (u32)sector_index : kInvalidBorder;
+  borders[2] = sector_y > 0 ? (u32)(kSectorCount + sector_index - kSectorsPerRow) : kInvalidBorder;
+  borders[3] = sector_y < kSectorsPerRow - 1 ? (u32)(kSectorCount + sector_index) : kInvalidBorder;
+}
+
+void AbstractGraph::BuildBorder(u32 border_index) {
+  Border& border = borders_[border_index];
+  bool vertical = border_index < kSectorCount;
+  NodePoint origin = GetSectorOrigin(vertical ? border_index : border_index - kSectorCount);
+  size_t direction = vertical ? CoordOffset::EastIndex() : CoordOffset::SouthIndex();
+  size_t reverse_direction = vertical ? CoordOffset::WestIndex() : CoordOffset::NorthIndex();
+
+  border.entrances.clear();
+  border.dynamic = false;
+
+  size_t run_start = 0;
+  size_t run_length = 0;
+
+  auto get_entrance = [&](size_t offset) {
+    Entrance entrance;
+
+    if (vertical) {
+      entrance.first = NodePoint(origin.x + kSectorSize - 1, (u16)(origin.y + offset));
+      entrance.second = NodePoint(origin.x + kSectorSize, (u16)(origin.y + offset));
+    } else {
+      entrance.first = NodePoint((u16)(origin.x + offset), origin.y + kSectorSize - 1);
+      entrance.second = NodePoint((u16)(origin.x + offset), origin.y + kSectorSize);
+    }
+
+    return entrance;
+  };
+
+  // Long runs are split into spans that each get one entrance at the cheapest tile closest to the span center.
+  // The cheapest tile is used so weighted maps don't route through the tiles next to walls.
+  auto add_run = [&]() {
+    size_t span_count = (run_length + kMaxEntranceSpan - 1) / kMaxEntranceSpan;
+
+    for (size_t span = 0; span < span_count; ++span) {
+      size_t span_start = run_start + (run_length * span) / span_count;
+      size_t span_end = run_start + (run_length * (span + 1)) / span_count;
+      size_t center = (span_start + span_end - 1) / 2;
+      size_t best_offset = center;
+      float best_cost = 0.0f;
+
+      for (size_t offset = span_start; offset < span_end; ++offset) {
+        Entrance entrance = get_entrance(offset);
+        const Node* first = processor_.PeekNode(entrance.first.x, entrance.first.y);
+        const Node* second = processor_.PeekNode(entrance.second.x, entrance.second.y);
+        float cost = first->GetWeight() + second->GetWeight();
+        size_t distance = offset > center ? offset - center : center - offset;
+        size_t best_distance = best_offset > center ? best_offset - center : center - best_offset;
+
+        if (offset == span_start || cost < best_cost || (cost == best_cost && distance < best_distance)) {
+          best_offset = offset;
+          best_cost = cost;
+        }
+      }
+
+      border.entrances.push_back(get_entrance(best_offset));
+    }
+
+    run_length = 0;
+  };
+
+  for (size_t i = 0; i < kSectorSize; ++i) {
+    NodePoint first, second;
+
+    if (vertical) {
+      first = NodePoint(origin.x + kSectorSize - 1, (u16)(origin.y + i));
+      second = NodePoint(origin.x + kSectorSize, (u16)(origin.y + i));
+    } else {
+      first = NodePoint((u16)(origin.x + i), origin.y + kSectorSize - 1);
+      second = NodePoint((u16)(origin.x + i), origin.y + kSectorSize);
+    }
+
+    bool dynamic = false;
+    bool open = CanEnter(first) && CanEnter(second) && GetEdges(first, &dynamic).IsSet(direction) &&
+                GetEdges(second, &dynamic).IsSet(reverse_direction);
+
+    if (dynamic) border.dynamic = true;
+
+    if (open) {
+      if (run_length == 0) run_start = i;
+      ++run_length;
+    } else {
+      add_run();
+    }
+  }
+
+  add_run();
+
+  border.dirty = false;
+  ++border.version;
+}
+
+void AbstractGraph::BuildSector(size_t sector_index) {
+  Sector& sector = sectors_[sector_index];
+  u32 borders[4];
+
+  GetSectorBorders(sector_index, borders);
+
+  sector.nodes.clear();
+  sector.dynamic = false;
+
+  for (size_t i = 0; i < 4; ++i) {
+    if (borders[i] == kInvalidBorder) continue;
+
+    Border& border = GetBorder(borders[i]);
+    // The west and north borders belong to the previous sector, so this sector is on the second side.
+    bool second_side = i == 0 || i == 2;
+
+    sector.border_versions[i] = border.version;
+
+    if (border.dynamic) sector.dynamic = true;
+
+    for (Entrance& entrance : border.entrances) {
+      NodePoint inside = second_side ? entrance.second : entrance.first;
+      NodePoint outside = second_side ? entrance.first : entrance.second;
+
+      auto iter = std::find_if(sector.nodes.begin(), sector.nodes.end(),
+                               [inside](const SectorNode& node) { return node.point == inside; });
+
+      if (iter == sector.nodes.end()) {
+        SectorNode node;
+        node.point = inside;
+        sector.nodes.push_back(node);
+        iter = sector.nodes.end() - 1;
+      }
+
+      if (iter->exit_count < ZERO_ARRAY_SIZE(iter->exits)) {
+        iter->exits[iter->exit_count++] = outside;
+      }
+    }
+  }
+
+  size_t node_count = sector.nodes.size();
+
+  sector.costs.resize(node_count * node_count);
+
+  bool previous_dynamic = search_dynamic_;
+
+  search_dynamic_ = false;
+
+  for (size_t i = 0; i < node_count; ++i) {
+    Search(sector_index, sector.nodes[i].point, false, refine_search_);
+
+    for (size_t j = 0; j < node_count; ++j) {
+      float dist = refine_search_.dist[GetLocalIndex(sector.nodes[j].point)];
+
+      sector.costs[i * node_count + j] = dist == kUnreachable ? -1.0f : dist;
+    }
+  }
+
+  if (search_dynamic_) sector.dynamic = true;
+
+  search_dynamic_ = previous_dynamic;
+  sector.dirty = false;
+}
+
+bool AbstractGraph::CanEnter(NodePoint point) {
+  const Node* peek = processor_.PeekNode(point.x, point.y);
+
+  if (!peek || !(peek->flags & NodeFlag_Traversable)) return false;
+  if (state_->GetBrickTeam(point.x, point.y)) return false;
+
+  if (peek->flags & NodeFlag_DynamicEmpty) {
+    search_dynamic_ = true;
+    return processor_.IsTraversable(peek, point, *state_);
+  }
+
+  return true;
+}
+
+EdgeSet AbstractGraph::GetEdges(NodePoint point, bool* dynamic) {
+  EdgeSet edges = processor_.FindEdges(point, *state_);
+
+  if (edges.HasDynamic()) {
+    *dynamic = true;
+  }
+
+  return edges;
+}
+
+// Dijkstra that stays inside of the sector. The reverse search finds the cost from every tile to the provided tile.
+void AbstractGraph::Search(size_t sector_index, NodePoint from, bool reverse, LocalSearch& search) {
+  NodePoint origin = GetSectorOrigin(sector_index);
+
+  search.sector_index = sector_index;
+
+  std::fill(std::begin(search.dist), std::end(search.dist), kUnreachable);
+  std::fill(std::begin(search.parent), std::end(search.parent), LocalSearch::kNoParent);
+
+  if (!IsInSector(from, origin) || !CanEnter(from)) return;
+
+  MinQueue openset;
+  u16 from_index = GetLocalIndex(from);
+
+  search.dist[from_index] = 0.0f;
+  openset.push(std::make_pair(0.0f, (u32)from_index));
+
+  while (!openset.empty()) {
+    QueueEntry entry = openset.top();
+    openset.pop();
+
+    u16 local_index = (u16)entry.second;
+
+    if (entry.first > search.dist[local_index]) continue;
+
+    NodePoint point((u16)(origin.x + local_index % kSectorSize), (u16)(origin.y + local_index / kSectorSize));
+    const Node* node = processor_.PeekNode(point.x, point.y);
+    bool dynamic = false;
+    EdgeSet edges = GetEdges(point, &dynamic);
+
+    if (dynamic) search_dynamic_ = true;
+
+    for (size_t i = 0; i < 4; ++i) {
+      CoordOffset offset = CoordOffset::FromIndex(i);
+      NodePoint neighbor_point(point.x + offset.x, point.y + offset.y);
+
+      if (!IsInSector(neighbor_point, origin)) continue;
+      if (!CanEnter(neighbor_point)) continue;
+
+      const Node* neighbor = processor_.PeekNode(neighbor_point.x, neighbor_point.y);
+      float cost = 0.0f;
+
+      if (reverse) {
+        // Edges are directed, so the reverse search needs the edge from the neighbor into this tile.
+        // The opposite direction is always the paired index.
+        size_t opposite = i ^ 1;
+
+        if (!GetEdges(neighbor_point, &dynamic).IsSet(opposite)) continue;
+
+        cost = GetEdgeCost(neighbor, node);
+      } else {
+        if (!edges.IsSet(i)) continue;
+
+        cost = GetEdgeCost(node, neighbor);
+      }
+
+      u16 neighbor_index = GetLocalIndex(neighbor_point);
+      float dist = search.dist[local_index] + cost;
+
+      if (dist < search.dist[neighbor_index]) {
+        search.dist[neighbor_index] = dist;
+        search.parent[neighbor_index] = local_index;
+        openset.push(std::make_pair(dist, (u32)neighbor_index));
+      }
+    }
+
+    if (dynamic) search_dynamic_ = true;
+  }
+}
+
+// Appends the tiles from the search origin to the provided tile, not including the origin.
+bool AbstractGraph::AppendLocalPath(const LocalSearch& search, NodePoint to, std::vector<NodePoint>& points) const {
+  NodePoint origin = GetSectorOrigin(search.sector_index);
+  u16 local_index = GetLocalIndex(to);
+
+  if (search.dist[local_index] == kUnreachable) return false;
+
+  size_t insert_index = points.size();
+
+  while (search.parent[local_index] != LocalSearch::kNoParent) {
+    points.emplace_back((u16)(origin.x + local_index % kSectorSize), (u16)(origin.y + local_index / kSectorSize));
+    local_index = search.parent[local_index];
+  }
+
+  std::reverse(points.begin() + insert_index, points.end());
+
+  return true;
+}
+
+size_t AbstractGraph::GetMemoryUsage() const {
+  size_t usage = sizeof(*this) + borders_.capacity() * sizeof(Border) + sectors_.capacity() * sizeof(Sector) +
+                 dynamic_sectors_.capacity() * sizeof(size_t) +
+                 abstract_nodes_.size() * (sizeof(u32) + sizeof(AbstractNode) + sizeof(void*));
+
+  for (const Border& border : borders_) {
+    usage += border.entrances.capacity() * sizeof(Entrance);
+  }
+
+  for (const Sector& sector : sectors_) {
+    usage += sector.nodes.capacity() * sizeof(SectorNode) + sector.costs.capacity() * sizeof(float);
+  }
+
+  return usage;
+}
+
+}  // namespace path
+}  // namespace zero
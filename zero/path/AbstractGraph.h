@@ -0,0 +1,143 @@
+#pragma once
+
+#include <zero/Types.h>
+#include <zero/path/NodeProcessor.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace zero {
+namespace path {
+
+// The map is split into square sectors of this many tiles for the abstract graph.
+constexpr u16 kSectorSize = 32;
+constexpr u16 kSectorsPerRow = 1024 / kSectorSize;
+constexpr size_t kSectorCount = (size_t)kSectorsPerRow * kSectorsPerRow;
+
+// The result of searching the abstract graph.
+struct AbstractPath {
+  // The refined tiles of the path followed by the remaining sector entrance tiles.
+  std::vector<NodePoint> points;
+  // How many of the points are a tile-by-tile path. The rest are only the sector entrances.
+  size_t refined_count = 0;
+  float cost = 0.0f;
+  bool dynamic = false;
+  size_t nodes_expanded = 0;
+};
+
+// This is a cluster abstraction of the node processor graph.
+// The map is split into sectors with entrances on the borders between them. The costs between the entrances of a
+// sector are cached, so a long search only needs to visit entrances instead of every tile.
+// Sectors are built lazily when a search reaches them and are rebuilt after one of their tiles changes.
+// Bricks are treated as solid here since the cache is shared between frequencies.
+class AbstractGraph {
+ public:
+  AbstractGraph(NodeProcessor& processor, float radius) : processor_(processor), radius_(radius) {}
+
+  // Finds a path over the sector entrances. Only the first refine_segments sectors are refined into full tile paths.
+  // Returns an empty path if start and goal are in the same sector or if no path exists in the abstract graph.
+  // Sectors that are built during the search use the door state, so it should be the newest one.
+  AbstractPath FindPath(NodePoint start, NodePoint goal, size_t refine_segments,
+                        std::shared_ptr<const DynamicState> state);
+
+  // Marks the sector containing the tile as needing to be rebuilt. This should happen when bricks change.
+  void InvalidateTile(u16 x, u16 y);
+  // Marks every sector that contains a dynamic tile as needing to be rebuilt. This should happen on door toggles.
+  void InvalidateDynamicSectors();
+
+  inline float GetRadius() const { return radius_; }
+
+  size_t GetMemoryUsage() const;
+
+  inline static size_t GetSectorIndex(NodePoint point) {
+    return (size_t)(point.y / kSectorSize) * kSectorsPerRow + (point.x / kSectorSize);
+  }
+
+ private:
+  // A pair of neighboring tiles that can be traveled between to cross a border.
+  struct Entrance {
+    // The tile in the west or north sector.
+    NodePoint first;
+    // The tile in the east or south sector.
+    NodePoint second;
+  };
+
+  struct Border {
+    std::vector<Entrance> entrances;
+    u32 version = 0;
+    bool dirty = true;
+    bool dynamic = false;
+  };
+
+  // An entrance tile inside of a sector. Corner tiles can lead into two different sectors.
+  struct SectorNode {
+    NodePoint point;
+    NodePoint exits[2];
+    size_t exit_count = 0;
+  };
+
+  struct Sector {
+    std::vector<SectorNode> nodes;
+    // Cost from each node to every other node in the sector. Unreachable pairs are negative.
+    std::vector<float> costs;
+    u32 border_versions[4] = {};
+    bool dirty = true;
+    bool dynamic = false;
+  };
+
+  // Dijkstra state for the tiles of a single sector.
+  struct LocalSearch {
+    static constexpr u16 kNoParent = 0xFFFF;
+
+    size_t sector_index = 0;
+    float dist[kSectorSize * kSectorSize];
+    u16 parent[kSectorSize * kSectorSize];
+  };
+
+  struct AbstractNode {
+    float g = 0.0f;
+    u32 parent = 0;
+    bool closed = false;
+  };
+
+  static constexpr u32 kInvalidBorder = 0xFFFFFFFF;
+
+  Sector& GetSector(size_t sector_index);
+  Border& GetBorder(u32 border_index);
+  void BuildBorder(u32 border_index);
+  void BuildSector(size_t sector_index);
+  void GetSectorBorders(size_t sector_index, u32* borders) const;
+  void InvalidateSector(size_t sector_index);
+
+  bool CanEnter(NodePoint point);
+  EdgeSet GetEdges(NodePoint point, bool* dynamic);
+  void Search(size_t sector_index, NodePoint from, bool reverse, LocalSearch& search);
+  bool AppendLocalPath(const LocalSearch& search, NodePoint to, std::vector<NodePoint>& points) const;
+
+  inline static u16 GetLocalIndex(NodePoint point) {
+    return (u16)((point.y % kSectorSize) * kSectorSize + (point.x % kSectorSize));
+  }
+
+  NodeProcessor& processor_;
+  float radius_;
+  // The door and brick state of the current search.
+  std::shared_ptr<const DynamicState> state_;
+
+  // Borders between west and east sectors followed by borders between north and south sectors.
+  std::vector<Border> borders_ = std::vector<Border>(kSectorCount * 2);
+  std::vector<Sector> sectors_ = std::vector<Sector>(kSectorCount);
+
+  std::vector<size_t> dynamic_sectors_;
+  bool dynamic_sectors_found_ = false;
+  bool search_dynamic_ = false;
+
+  std::unordered_map<u32, AbstractNode> abstract_nodes_;
+
+  LocalSearch start_search_;
+  LocalSearch goal_search_;
+  LocalSearch refine_search_;
+};
+
+}  // namespace path
+}  // namespace zero
@@ -0,0 +1,276 @@
+#include "DistanceField.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace zero {
+namespace path {
+
+constexpr float kUnreachable = std::numeric_limits<float>::max();
+
+static inline u32 GetTileIndex(NodePoint point) {
+  return (u32)point.y * 1024 + point.x;
+}
+
+static inline NodePoint GetIndexPoint(u32 index) {
+  return NodePoint((u16)(index % 1024), (u16)(index / 1024));
+}
+
+static inline bool GetNeighbor(NodePoint point, size_t direction, NodePoint* neighbor) {
+  CoordOffset offset = CoordOffset::FromIndex(direction);
+  s32 x = point.x + offset.x;
+  s32 y = point.y + offset.y;
+
+  if (x < 0 || y < 0 || x >= 1024 || y >= 1024) return false;
+
+  *neighbor = NodePoint((u16)x, (u16)y);
+  return true;
+}
+
+DistanceField::DistanceField(NodeProcessor& processor, const Map& map, NodePoint goal, float radius, u16 frequency)
+    : processor_(processor), map_(map), goal_(goal), radius_(radius), frequency_(frequency) {}
+
+float DistanceField::GetCost(NodePoint point) {
+  if (point.x >= 1024 || point.y >= 1024) return -1.0f;
+
+  Update();
+
+  float cost = costs_[GetTileIndex(point)];
+
+  return cost == kUnreachable ? -1.0f : cost;
+}
+
+float DistanceField::GetDistance(NodePoint point) {
+  if (GetCost(point) < 0.0f) return -1.0f;
+
+  return (float)steps_[GetTileIndex(point)];
+}
+
+bool DistanceField::GetNext(NodePoint point, NodePoint* next) {
+  if (GetCost(point) < 0.0f) return false;
+
+  u8 direction = directions_[GetTileIndex(point)];
+
+  if (direction == kNoDirection) return false;
+
+  return GetNeighbor(point, direction, next);
+}
+
+Path DistanceField::BuildPath(const Vector2f& from) {
+  Path path;
+  NodePoint current((u16)from.x, (u16)from.y);
+
+  // The ship can be overlapping a tile that isn't traversable, so try the tile it's leaning toward.
+  if (GetCost(current) < 0.0f) {
+    Vector2f center(floorf(from.x) + 0.5f, floorf(from.y) + 0.5f);
+    Vector2f nearby = center + Normalize(from - center);
+
+    current = NodePoint((u16)nearby.x, (u16)nearby.y);
+
+    if (GetCost(current) < 0.0f) return path;
+  }
+
+  path.Add(Vector2f(current.x + 0.5f, current.y + 0.5f));
+
+  NodePoint next;
+
+  // The step count bounds the walk in case a repair left a cycle behind.
+  for (size_t i = 0; i < kMaxNodes && GetNext(current, &next); ++i) {
+    if (processor_.FindEdges(current, *state_).HasDynamic()) {
+      path.dynamic = true;
+    }
+
+    current = next;
+    path.Add(map_.ResolveShipCollision(Vector2f(current.x + 0.5f, current.y + 0.5f), radius_, 0xFFFF));
+  }
+
+  if (!(current == goal_)) return Path();
+
+  SmoothPath(map_, path, radius_, frequency_);
+
+  return path;
+}
+
+void DistanceField::InvalidateTiles(const std::vector<NodePoint>& points) {
+  pending_.insert(pending_.end(), points.begin(), points.end());
+}
+
+void DistanceField::InvalidateTile(NodePoint point) {
+  pending_.push_back(point);
+}
+
+void DistanceField::Update() {
+  if (computed_ && pending_.empty()) return;
+
+  // Every change to the doors invalidates their tiles, so the newest state is used for the tiles that are recomputed.
+  state_ = processor_.GetDynamicState();
+
+  if (!computed_) {
+    Compute();
+  } else {
+    Repair();
+  }
+}
+
+void DistanceField::Compute() {
+  costs_.assign(kMaxNodes, kUnreachable);
+  steps_.assign(kMaxNodes, 0);
+  directions_.assign(kMaxNodes, kNoDirection);
+
+  pending_.clear();
+  openset_.clear();
+  computed_ = true;
+
+  if (goal_.x >= 1024 || goal_.y >= 1024 || !CanEnter(goal_)) return;
+
+  costs_[GetTileIndex(goal_)] = 0.0f;
+  openset_.emplace_back(0.0f, GetTileIndex(goal_));
+
+  Propagate();
+}
+
+// Resets every tile whose route passes through a changed tile, then searches again from the tiles around them.
+// Routes that didn't touch a changed tile are still valid, so they only need to be lowered if a new opening is
+// shorter.
+void DistanceField::Repair() {
+  for (NodePoint point : pending_) {
+    if (point == goal_) {
+      Compute();
+      return;
+    }
+  }
+
+  std::vector<bool> reset(kMaxNodes, false);
+  std::vector<u32> reset_tiles;
+
+  for (NodePoint point : pending_) {
+    if (point.x >= 1024 || point.y >= 1024) continue;
+
+    u32 index = GetTileIndex(point);
+
+    if (reset[index]) continue;
+
+    reset[index] = true;
+    reset_tiles.push_back(index);
+  }
+
+  pending_.clear();
+
+  // Walk the route tree backwards to find every tile that travels through a changed tile.
+  for (size_t i = 0; i < reset_tiles.size(); ++i) {
+    NodePoint point = GetIndexPoint(reset_tiles[i]);
+
+    for (size_t direction = 0; direction < 4; ++direction) {
+      NodePoint neighbor;
+
+      if (!GetNeighbor(point, direction, &neighbor)) continue;
+
+      u32 neighbor_index = GetTileIndex(neighbor);
+
+      if (reset[neighbor_index]) continue;
+
+      // The neighbor travels toward this tile if its direction is the opposite of the one used to reach it.
+      if (directions_[neighbor_index] != (direction ^ 1)) continue;
+
+      reset[neighbor_index] = true;
+      reset_tiles.push_back(neighbor_index);
+    }
+  }
+
+  for (u32 index : reset_tiles) {
+    costs_[index] = kUnreachable;
+    steps_[index] = 0;
+    directions_[index] = kNoDirection;
+  }
+
+  openset_.clear();
+
+  for (u32 index : reset_tiles) {
+    NodePoint point = GetIndexPoint(index);
+
+    for (size_t direction = 0; direction < 4; ++direction) {
+      Relax(point, direction);
+    }
+
+    if (costs_[index] != kUnreachable) {
+      openset_.emplace_back(costs_[index], index);
+      std::push_heap(openset_.begin(), openset_.end(), std::greater<QueueEntry>());
+    }
+  }
+
+  Propagate();
+}
+
+// Reverse Dijkstra from the tiles in the openset. Each tile's cost is lowered by traveling through the popped tile.
+void DistanceField::Propagate() {
+  while (!openset_.empty()) {
+    std::pop_heap(openset_.begin(), openset_.end(), std::greater<QueueEntry>());
+    QueueEntry entry = openset_.back();
+    openset_.pop_back();
+
+    if (entry.first > costs_[entry.second]) continue;
+
+    NodePoint point = GetIndexPoint(entry.second);
+
+    for (size_t direction = 0; direction < 4; ++direction) {
+      NodePoint neighbor;
+
+      if (!GetNeighbor(point, direction, &neighbor)) continue;
+
+      // The neighbor travels back toward this point, which is the opposite direction.
+      if (Relax(neighbor, direction ^ 1)) {
+        u32 neighbor_index = GetTileIndex(neighbor);
+
+        openset_.emplace_back(costs_[neighbor_index], neighbor_index);
+        std::push_heap(openset_.begin(), openset_.end(), std::greater<QueueEntry>());
+      }
+    }
+  }
+}
+
+bool DistanceField::Relax(NodePoint point, size_t direction) {
+  NodePoint neighbor;
+
+  if (!GetNeighbor(point, direction, &neighbor)) return false;
+
+  u32 index = GetTileIndex(point);
+  u32 neighbor_index = GetTileIndex(neighbor);
+
+  if (costs_[neighbor_index] == kUnreachable) return false;
+  if (!CanEnter(point) || !HasEdge(point, direction)) return false;
+
+  const Node* node = processor_.PeekNode(point.x, point.y);
+  const Node* neighbor_node = processor_.PeekNode(neighbor.x, neighbor.y);
+  float cost = costs_[neighbor_index] + GetEdgeCost(node, neighbor_node);
+
+  if (cost >= costs_[index]) return false;
+
+  costs_[index] = cost;
+  steps_[index] = steps_[neighbor_index] < 0xFFFF ? steps_[neighbor_index] + 1 : 0xFFFF;
+  directions_[index] = (u8)direction;
+
+  return true;
+}
+
+bool DistanceField::CanEnter(NodePoint point) {
+  const Node* node = processor_.PeekNode(point.x, point.y);
+
+  if (!node || !(node->flags & NodeFlag_Traversable)) return false;
+
+  if (state_->bricks && state_->bricks->IsSolid(point.x, point.y, frequency_)) return false;
+
+  return processor_.IsTraversable(node, point, *state_);
+}
+
+bool DistanceField::HasEdge(NodePoint from, size_t direction) {
+  if (!processor_.FindEdges(from, *state_).IsSet(direction)) return false;
+
+  NodePoint neighbor;
+
+  return GetNeighbor(from, direction, &neighbor) && CanEnter(neighbor);
+}
+
+}  // namespace path
+}  // namespace zero
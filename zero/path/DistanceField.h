@@ -0,0 +1,80 @@
+#pragma once
+
+#include <zero/Types.h>
+#include <zero/path/NodeProcessor.h>
+#include <zero/path/Path.h>
+
+#include <memory>
+#include <vector>
+
+namespace zero {
+namespace path {
+
+// Stores the cost and direction from every tile to a single goal tile.
+// This is built with one reverse search from the goal, so any number of paths to the goal can be read back without
+// searching again. It's best used for goals that never move, such as flagroom entrances or warpgates.
+// The field is recomputed lazily. Door and brick changes only reset the tiles whose route went through the change.
+class DistanceField {
+ public:
+  DistanceField(NodeProcessor& processor, const Map& map, NodePoint goal, float radius, u16 frequency);
+
+  // Returns the total travel cost from the point to the goal or a negative value if it can't be reached.
+  float GetCost(NodePoint point);
+  // Returns the number of tiles traveled from the point to the goal or a negative value if it can't be reached.
+  float GetDistance(NodePoint point);
+  // Gets the neighbor tile to travel to from the point. Returns false if there's no route or the point is the goal.
+  bool GetNext(NodePoint point, NodePoint* next);
+
+  // Follows the field from the position to the goal.
+  Path BuildPath(const Vector2f& from);
+
+  // Marks the tiles as changed so the routes through them are recomputed on the next query.
+  void InvalidateTiles(const std::vector<NodePoint>& points);
+  void InvalidateTile(NodePoint point);
+
+  inline bool Matches(NodePoint goal, float radius, u16 frequency) const {
+    return goal_ == goal && radius_ == radius && frequency_ == frequency;
+  }
+
+  inline NodePoint GetGoal() const { return goal_; }
+
+  inline size_t GetMemoryUsage() const {
+    return sizeof(*this) + costs_.capacity() * sizeof(float) + steps_.capacity() * sizeof(u16) +
+           directions_.capacity() * sizeof(u8) + pending_.capacity() * sizeof(NodePoint) +
+           openset_.capacity() * sizeof(QueueEntry);
+  }
+
+ private:
+  static constexpr u8 kNoDirection = 0xFF;
+
+  void Update();
+  void Compute();
+  void Repair();
+  void Propagate();
+
+  bool CanEnter(NodePoint point);
+  bool HasEdge(NodePoint from, size_t direction);
+  // Tries to lower the cost of the point by traveling through its neighbor in the provided direction.
+  bool Relax(NodePoint point, size_t direction);
+
+  NodeProcessor& processor_;
+  const Map& map_;
+  NodePoint goal_;
+  float radius_;
+  u16 frequency_;
+  // The door and brick state that the costs are being computed with.
+  std::shared_ptr<const DynamicState> state_;
+
+  std::vector<float> costs_;
+  std::vector<u16> steps_;
+  std::vector<u8> directions_;
+
+  std::vector<NodePoint> pending_;
+  bool computed_ = false;
+
+  using QueueEntry = std::pair<float, u32>;
+  std::vector<QueueEntry> openset_;
+};
+
+}  // namespace path
+}  // namespace zero
@@ -0,0 +1,186 @@
+#include "DoorOverlayCache.h"
+
+#include <zero/game/Logger.h>
+
+#include <string.h>
+
+namespace zero {
+namespace path {
+
+DoorOverlayCache::~DoorOverlayCache() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+
+  convar_.notify_all();
+
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+std::shared_ptr<const DoorOverlay> DoorOverlayCache::Get(u8 open_mask) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  return overlays_[open_mask & present_mask_];
+}
+
+void DoorOverlayCache::Request(const Map& map, u8 open_mask, float ship_radius) {
+  if (!map.tiles || map.door_count == 0) return;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  CopyMap(map, ship_radius);
+
+  open_mask &= present_mask_;
+
+  if (requested_[open_mask]) return;
+
+  requested_[open_mask] = true;
+  queue_.push_back(open_mask);
+
+  if (!thread_.joinable()) {
+    thread_ = std::thread(&DoorOverlayCache::Run, this);
+  }
+
+  lock.unlock();
+  convar_.notify_one();
+}
+
+std::shared_ptr<const DoorOverlay> DoorOverlayCache::Build(const Map& map, u8 open_mask, float ship_radius) {
+  if (!map.tiles || map.door_count == 0) return nullptr;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  CopyMap(map, ship_radius);
+
+  open_mask &= present_mask_;
+
+  if (overlays_[open_mask]) return overlays_[open_mask];
+
+  // The background thread skips it if it's still queued.
+  requested_[open_mask] = true;
+
+  std::vector<u8> tiles;
+  std::vector<u64> solid_words(kSolidDataWordCount);
+
+  return BuildOverlay(lock, open_mask, tiles, solid_words);
+}
+
+void DoorOverlayCache::Clear() {
+  std::lock_guard<std::mutex> build_lock(build_mutex_);
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  queue_.clear();
+  requested_.reset();
+
+  for (auto& overlay : overlays_) {
+    overlay = nullptr;
+  }
+
+  tiles_.clear();
+  doors_.clear();
+  present_mask_ = 0;
+}
+
+size_t DoorOverlayCache::GetMemoryUsage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  size_t size = sizeof(*this) + tiles_.capacity() + doors_.capacity() * sizeof(Tile);
+
+  for (const auto& overlay : overlays_) {
+    if (overlay) {
+      size += sizeof(DoorOverlay) + overlay->edges.capacity() * sizeof(EdgeSet) + overlay->traversable.capacity() / 8;
+    }
+  }
+
+  return size;
+}
+
+void DoorOverlayCache::Run() {
+  std::vector<u8> tiles;
+  std::vector<u64> solid_words(kSolidDataWordCount);
+
+  while (true) {
+    std::unique_lock<std::mutex> build_lock(build_mutex_, std::defer_lock);
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    convar_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+
+    if (stop_) return;
+
+    // The build lock is taken before the queue lock everywhere else, so release the queue to take it.
+    lock.unlock();
+    build_lock.lock();
+    lock.lock();
+
+    // The queue might have been cleared while waiting for the build lock.
+    if (queue_.empty()) continue;
+
+    u8 open_mask = queue_.front();
+    queue_.pop_front();
+
+    // It was built on the game thread while it was queued.
+    if (overlays_[open_mask]) continue;
+
+    BuildOverlay(lock, open_mask, tiles, solid_words);
+  }
+}
+
+void DoorOverlayCache::CopyMap(const Map& map, float ship_radius) {
+  if (!tiles_.empty()) return;
+
+  // Builds copy the tiles while holding the lock, so they never see this change.
+  map_ = map;
+  map_.brick_manager = nullptr;
+
+  tiles_.assign(map.tiles, map.tiles + 1024 * 1024);
+
+  // Bricks are checked separately, so overlays are built without them.
+  for (u8& id : tiles_) {
+    if (id == kTileIdBrick) id = 0;
+  }
+
+  doors_.assign(map.doors, map.doors + map.door_count);
+  present_mask_ = 0;
+
+  for (const Tile& door : doors_) {
+    present_mask_ |= (1 << (door.id - kTileIdFirstDoor));
+  }
+
+  ship_radius_ = ship_radius;
+}
+
+std::shared_ptr<const DoorOverlay> DoorOverlayCache::BuildOverlay(std::unique_lock<std::mutex>& lock, u8 open_mask,
+                                                                  std::vector<u8>& tiles,
+                                                                  std::vector<u64>& solid_words) {
+  tiles = tiles_;
+
+  Map map = map_;
+  float ship_radius = ship_radius_;
+
+  for (const Tile& door : doors_) {
+    bool open = open_mask & (1 << (door.id - kTileIdFirstDoor));
+
+    tiles[door.y * 1024 + door.x] = open ? kTileIdOpenDoor : (TileId)door.id;
+  }
+
+  lock.unlock();
+
+  map.tiles = tiles.data();
+  // The copy would otherwise share the live map's bitmaps instead of seeing these doors.
+  map.AttachSolidData(solid_words.data());
+
+  auto overlay = std::make_shared<DoorOverlay>();
+
+  processor_.BuildDoorOverlay(map, ship_radius, overlay.get());
+
+  lock.lock();
+  overlays_[open_mask] = overlay;
+
+  return overlay;
+}
+
+}  // namespace path
+}  // namespace zero
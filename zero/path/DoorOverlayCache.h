@@ -0,0 +1,75 @@
+#pragma once
+
+#include <zero/Types.h>
+#include <zero/game/Map.h>
+#include <zero/path/NodeProcessor.h>
+
+#include <bitset>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace zero {
+namespace path {
+
+// Builds the door overlay for each configuration of open doors on a background thread.
+// Every door with the same id has the same state, so there are at most 256 configurations for a map. Once the overlay
+// for a configuration is built, door updates only have to publish it to the processor.
+class DoorOverlayCache {
+ public:
+  static constexpr size_t kMaxConfigurations = 256;
+
+  DoorOverlayCache(NodeProcessor& processor) : processor_(processor) {}
+  ~DoorOverlayCache();
+
+  // Returns the overlay for the open doors in the mask or null if it isn't built yet.
+  std::shared_ptr<const DoorOverlay> Get(u8 open_mask);
+
+  // Queues the overlay for the open doors in the mask to be built if it doesn't exist yet.
+  // This must be called from the game thread since the map's tiles are copied on the first request.
+  void Request(const Map& map, u8 open_mask, float ship_radius);
+  // Builds the overlay on the calling thread if it doesn't exist yet and returns it. This is used when the doors change
+  // to a configuration that wasn't predicted. It must be called from the game thread.
+  std::shared_ptr<const DoorOverlay> Build(const Map& map, u8 open_mask, float ship_radius);
+
+  // Drops every overlay and waits for the build that is running. The overlays are ordered by the processor's dynamic
+  // points, so this must happen before the graph is rebuilt.
+  void Clear();
+
+  size_t GetMemoryUsage() const;
+
+ private:
+  void Run();
+
+  // Copies the map on the first request. The lock must be held.
+  void CopyMap(const Map& map, float ship_radius);
+  // Builds and stores the overlay from the copied map. The lock must be held, but it's released during the build.
+  std::shared_ptr<const DoorOverlay> BuildOverlay(std::unique_lock<std::mutex>& lock, u8 open_mask,
+                                                  std::vector<u8>& tiles, std::vector<u64>& solid_words);
+
+  NodeProcessor& processor_;
+
+  // A copy of the map with its bricks removed. Each build sets the doors from its mask on a copy of these tiles.
+  Map map_;
+  std::vector<u8> tiles_;
+  std::vector<Tile> doors_;
+  // The door ids that exist in the map. Masks only keep these bits so every mask for the same doors matches.
+  u8 present_mask_ = 0;
+  float ship_radius_ = 0.0f;
+
+  mutable std::mutex mutex_;
+  // Held while an overlay is being built so the graph can't be rebuilt under it.
+  std::mutex build_mutex_;
+  std::condition_variable convar_;
+  std::deque<u8> queue_;
+  std::bitset<kMaxConfigurations> requested_;
+  std::shared_ptr<const DoorOverlay> overlays_[kMaxConfigurations];
+  std::thread thread_;
+  bool stop_ = false;
+};
+
+}  // namespace path
+}  // namespace zero
@@ -0,0 +1,110 @@
+#include "DoorSchedule.h"
+
+#include <zero/game/ArenaSettings.h>
+
+namespace zero {
+namespace path {
+
+size_t DoorSchedule::Forecast::GetStep(Tick tick) const {
+  s32 diff = TICK_DIFF(tick, base_tick);
+
+  if (diff <= 0) return 0;
+
+  return (size_t)(diff / delay);
+}
+
+bool DoorSchedule::Update(const Map& map, const ArenaSettings& settings) {
+  // Doors aren't updated until the settings arrive.
+  if (settings.Type == 0 || map.door_count == 0) return false;
+
+  if (map.checksum != map_checksum_ || door_ids_.size() != map.door_count) {
+    BuildDoorIndexes(map);
+  }
+
+  if (forecast_ && map.last_seed_tick == last_seed_tick_ && map.door_rng.seed == last_rng_seed_ &&
+      settings.DoorMode == door_mode_ && settings.DoorDelay == door_delay_) {
+    return false;
+  }
+
+  last_seed_tick_ = map.last_seed_tick;
+  last_rng_seed_ = map.door_rng.seed;
+  door_mode_ = settings.DoorMode;
+  door_delay_ = settings.DoorDelay;
+
+  auto forecast = std::make_shared<Forecast>();
+
+  forecast->base_tick = map.last_seed_tick;
+  // This matches the delay that the map uses when updating.
+  forecast->delay = settings.DoorDelay > 0 ? settings.DoorDelay : 1;
+  forecast->current_open.resize(map.door_count);
+
+  for (size_t i = 0; i < map.door_count; ++i) {
+    const Tile& door = map.doors[i];
+
+    forecast->current_open[i] = map.GetTileId(door.x, door.y) == kTileIdOpenDoor;
+  }
+
+  forecast->open_masks.resize(kMaxSteps);
+
+  // Run a copy of the rng so the map's doors are unchanged.
+  VieRNG rng = map.door_rng;
+
+  for (size_t step = 0; step < kMaxSteps; ++step) {
+    TileId table[8];
+    u8 mask = 0;
+
+    GetDoorTable(GetNextDoorSeed(rng, settings.DoorMode), table);
+
+    for (size_t i = 0; i < 8; ++i) {
+      if (table[i] == kTileIdOpenDoor) {
+        mask |= (1 << i);
+      }
+    }
+
+    forecast->open_masks[step] = mask;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  forecast_ = std::move(forecast);
+
+  return true;
+}
+
+std::shared_ptr<const DoorSchedule::Forecast> DoorSchedule::GetForecast() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return forecast_;
+}
+
+size_t DoorSchedule::GetMemoryUsage() const {
+  size_t size = sizeof(*this) + door_indexes_.GetMemoryUsage() + door_ids_.capacity() * sizeof(TileId);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (forecast_) {
+    size += sizeof(Forecast) + forecast_->current_open.capacity() / 8 + forecast_->open_masks.capacity();
+  }
+
+  return size;
+}
+
+// The door list only changes when the map does, which also replaces the graph that owns this, so searches never read
+// it while it's being built.
+void DoorSchedule::BuildDoorIndexes(const Map& map) {
+  door_indexes_.Clear();
+  door_ids_.resize(map.door_count);
+
+  for (size_t i = 0; i < map.door_count; ++i) {
+    const Tile& door = map.doors[i];
+
+    door_indexes_.Set(door.x, door.y, (s32)i);
+    door_ids_[i] = door.id;
+  }
+
+  map_checksum_ = map.checksum;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  forecast_ = nullptr;
+}
+
+}  // namespace path
+}  // namespace zero
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <zero/TileGrid.h>
+#include <zero/Types.h>
+#include <zero/game/Clock.h>
+#include <zero/game/Map.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace zero {
+
+struct ArenaSettings;
+
+namespace path {
+
+// Predicts the state of every door at future ticks.
+// Door updates are fully determined by the door rng, DoorDelay and DoorMode, so the seeds of the upcoming updates are
+// generated ahead of time by running a copy of the map's rng.
+class DoorSchedule {
+ public:
+  // How many door updates are predicted ahead of the last update.
+  static constexpr size_t kMaxSteps = 1024;
+
+  // The predicted door states from one update of the schedule. This is never modified once it's created, so searches on
+  // other threads can keep using it while the game thread creates a new one.
+  struct Forecast {
+    // The tick of the last door update that was applied to the map.
+    Tick base_tick = 0;
+    s32 delay = 1;
+    // Whether each door in the map's door list was open at the last update.
+    std::vector<bool> current_open;
+    // The open doors after each future update. Bit n is set if doors with the id kTileIdFirstDoor + n are open.
+    std::vector<u8> open_masks;
+
+    // Returns the number of door updates that will have happened by the tick.
+    size_t GetStep(Tick tick) const;
+    // Returns the tick that the step is applied.
+    inline Tick GetStepTick(size_t step) const { return base_tick + (Tick)(step * delay); }
+  };
+
+  // Creates a new forecast if the doors were updated since the last call. This must be called from the game thread.
+  // Returns true if a new forecast was created.
+  bool Update(const Map& map, const ArenaSettings& settings);
+
+  // Returns the most recent forecast or null if the doors can't be predicted yet.
+  std::shared_ptr<const Forecast> GetForecast() const;
+
+  // Returns the position in the map's door list of the door at the tile or -1 if the tile isn't a door.
+  inline s32 GetDoorIndex(u16 x, u16 y) const { return door_indexes_.Get(x, y); }
+
+  // Returns true if the door will be open after the number of updates in the forecast.
+  inline bool IsOpen(const Forecast& forecast, s32 door_index, size_t step) const {
+    if (step == 0) return forecast.current_open[door_index];
+
+    if (step > forecast.open_masks.size()) step = forecast.open_masks.size();
+
+    return forecast.open_masks[step - 1] & (1 << (door_ids_[door_index] - kTileIdFirstDoor));
+  }
+
+  size_t GetMemoryUsage() const;
+
+ private:
+  void BuildDoorIndexes(const Map& map);
+
+  SparseTileGrid<s32> door_indexes_{-1};
+  // The level id of each door, which decides how it responds to the seed.
+  std::vector<TileId> door_ids_;
+  u32 map_checksum_ = 0;
+
+  // The map state that the forecast was generated from.
+  Tick last_seed_tick_ = 0;
+  s32 last_rng_seed_ = 0;
+  s32 door_mode_ = 0;
+  s32 door_delay_ = 0;
+
+  mutable std::mutex mutex_;
+  std::shared_ptr<const Forecast> forecast_;
+};
+
+}  // namespace path
+}  // namespace zero
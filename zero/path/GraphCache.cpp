@@ -0,0 +1,283 @@
+#include "GraphCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <zero/game/Logger.h>
+
+#ifdef _WIN32
+#ifdef APIENTRY
+// Fix warning with glad definition
+#undef APIENTRY
+#endif
+
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace zero {
+namespace path {
+
+constexpr u32 kGraphCacheMagic = 0x43475A30;  // '0ZGC'
+
+// Only the flags that describe the map are stored.
+constexpr u8 kStoredNodeFlags = NodeFlag_Traversable | NodeFlag_Safety | NodeFlag_DynamicEmpty;
+
+struct GraphCacheHeader {
+  u32 magic;
+  u32 version;
+  u32 map_checksum;
+  float radius;
+  u32 weight_type;
+  s32 wall_distance;
+  u32 dynamic_point_count;
+  u32 region_count;
+};
+
+// The file is the header followed by these arrays:
+// u8 flags[kMaxNodes], u8 weights[kMaxNodes], EdgeSet edges[kMaxNodes], NodePoint dynamic_points[dynamic_point_count],
+// RegionIndex coord_regions[kMaxNodes]
+static size_t GetFileSize(const GraphCacheHeader& header) {
+  return sizeof(GraphCacheHeader) + kMaxNodes * (sizeof(u8) * 2 + sizeof(EdgeSet) + sizeof(RegionIndex)) +
+         header.dynamic_point_count * sizeof(NodePoint);
+}
+
+static void GetCachePath(const Map& map, float radius, char* path, size_t path_size) {
+  const char* separator = strrchr(map.filename, '/');
+  int directory_length = separator ? (int)(separator - map.filename) : 1;
+  const char* directory = separator ? map.filename : ".";
+
+  snprintf(path, path_size, "%.*s/%08X_%u.graph", directory_length, directory, map.checksum,
+           (u32)(radius * 16.0f + 0.5f));
+}
+
+// Replaces the file at the path with the temporary file. Other bot processes can have the old file mapped, so it's
+// replaced instead of being written over.
+static bool ReplaceCacheFile(const char* temp_path, const char* path) {
+#ifdef _WIN32
+  return MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  return rename(temp_path, path) == 0;
+#endif
+}
+
+// Each process writes its own temporary file, so bots that share the cache directory don't write over each other.
+static u32 GetWriterId() {
+#ifdef _WIN32
+  return (u32)GetCurrentProcessId();
+#else
+  return (u32)getpid();
+#endif
+}
+
+// Read-only view of an entire file.
+struct MappedFile {
+  const u8* data = nullptr;
+  size_t size = 0;
+
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = NULL;
+#else
+  int fd = -1;
+#endif
+
+  bool Open(const char* path) {
+#ifdef _WIN32
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) return false;
+
+    size = (size_t)file_size.QuadPart;
+
+    mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) return false;
+
+    data = (const u8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) return false;
+
+    size = (size_t)file_stat.st_size;
+
+    void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    data = view == MAP_FAILED ? nullptr : (const u8*)view;
+#endif
+
+    return data != nullptr;
+  }
+
+  ~MappedFile() {
+#ifdef _WIN32
+    if (data) UnmapViewOfFile(data);
+    if (mapping != NULL) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+    if (data) munmap((void*)data, size);
+    if (fd >= 0) close(fd);
+#endif
+  }
+};
+
+bool LoadGraphCache(const Map& map, const Pathfinder::WeightConfig& config, Pathfinder& pathfinder,
+                    RegionRegistry& registry) {
+  if (map.checksum == 0) return false;
+
+  char path[1024];
+  GetCachePath(map, config.ship_radius, path, sizeof(path));
+
+  MappedFile file;
+
+  if (!file.Open(path)) return false;
+  if (file.size < sizeof(GraphCacheHeader)) return false;
+
+  GraphCacheHeader header;
+  memcpy(&header, file.data, sizeof(header));
+
+  if (header.magic != kGraphCacheMagic || header.version != kGraphCacheVersion) return false;
+  if (header.map_checksum != map.checksum || header.radius != config.ship_radius) return false;
+  if (header.weight_type != (u32)config.weight_type || header.wall_distance != config.wall_distance) return false;
+
+  if (file.size != GetFileSize(header)) {
+    Log(LogLevel::Warning, "Graph cache %s has the wrong size. Rebuilding.", path);
+    return false;
+  }
+
+  NodeProcessor& processor = pathfinder.GetProcessor();
+  const u8* flags = file.data + sizeof(GraphCacheHeader);
+  const u8* weights = flags + kMaxNodes;
+  const u8* edges = weights + kMaxNodes;
+  const u8* dynamic_points = edges + kMaxNodes * sizeof(EdgeSet);
+  const u8* coord_regions = dynamic_points + header.dynamic_point_count * sizeof(NodePoint);
+
+  processor.AllocateBlocks(map);
+  // The index isn't stored in the cache, so it's rebuilt like CreateMapWeights does.
+  processor.BuildOccupiedRectIndex(map, config.ship_radius);
+
+  for (u32 i = 0; i < kMaxNodes; ++i) {
+    u16 x = (u16)(i % 1024);
+    u16 y = (u16)(i / 1024);
+
+    // Solid blocks have no nodes, so there's nothing to load.
+    if (!processor.HasBlock(x, y)) continue;
+
+    Node* node = processor.GetNodeFromIndex(i);
+
+    node->flags = flags[i] & kStoredNodeFlags;
+    node->SetFixedWeight(weights[i]);
+
+    EdgeSet edge_set;
+    memcpy(&edge_set, edges + i * sizeof(EdgeSet), sizeof(EdgeSet));
+
+    processor.SetEdgeSet(x, y, edge_set);
+  }
+
+  processor.dynamic_points.resize(header.dynamic_point_count);
+
+  if (header.dynamic_point_count > 0) {
+    memcpy(processor.dynamic_points.data(), dynamic_points, header.dynamic_point_count * sizeof(NodePoint));
+  }
+
+  processor.IndexDynamicPoints();
+
+  registry.Load((const RegionIndex*)coord_regions, header.region_count);
+
+  pathfinder.config = config;
+
+  Log(LogLevel::Info, "Loaded pathfinder graph from %s.", path);
+
+  return true;
+}
+
+bool SaveGraphCache(const Map& map, Pathfinder& pathfinder, const RegionRegistry& registry) {
+  if (map.checksum == 0) return false;
+
+  char path[1024];
+  GetCachePath(map, pathfinder.config.ship_radius, path, sizeof(path));
+
+  NodeProcessor& processor = pathfinder.GetProcessor();
+  GraphCacheHeader header = {};
+
+  header.magic = kGraphCacheMagic;
+  header.version = kGraphCacheVersion;
+  header.map_checksum = map.checksum;
+  header.radius = pathfinder.config.ship_radius;
+  header.weight_type = (u32)pathfinder.config.weight_type;
+  header.wall_distance = pathfinder.config.wall_distance;
+  header.dynamic_point_count = (u32)processor.dynamic_points.size();
+  header.region_count = registry.GetRegionCount();
+
+  std::vector<u8> node_data(kMaxNodes * (2 + sizeof(EdgeSet)));
+  u8* flags = node_data.data();
+  u8* weights = flags + kMaxNodes;
+  u8* edges = weights + kMaxNodes;
+
+  for (u32 i = 0; i < kMaxNodes; ++i) {
+    const Node* node = processor.PeekNode((u16)(i % 1024), (u16)(i / 1024));
+    EdgeSet edge_set = processor.GetEdgeSet((u16)(i % 1024), (u16)(i / 1024));
+
+    flags[i] = node->flags & kStoredNodeFlags;
+    weights[i] = node->GetFixedWeight();
+    memcpy(edges + i * sizeof(EdgeSet), &edge_set, sizeof(EdgeSet));
+  }
+
+  // The graph is written next to the cache file and moved over it once it's complete, so a loader never maps a file
+  // that is still being written.
+  char temp_path[1100];
+  snprintf(temp_path, sizeof(temp_path), "%s.%u.tmp", path, GetWriterId());
+
+  FILE* f = fopen(temp_path, "wb");
+
+  if (!f) {
+    Log(LogLevel::Warning, "Failed to open %s for writing the graph cache.", temp_path);
+    return false;
+  }
+
+  size_t written = fwrite(&header, sizeof(header), 1, f);
+  written += fwrite(node_data.data(), node_data.size(), 1, f);
+
+  if (header.dynamic_point_count > 0) {
+    written += fwrite(processor.dynamic_points.data(), header.dynamic_point_count * sizeof(NodePoint), 1, f);
+  } else {
+    ++written;
+  }
+
+  std::vector<RegionIndex> coord_regions(kMaxNodes);
+
+  for (u32 i = 0; i < kMaxNodes; ++i) {
+    coord_regions[i] = registry.GetRegionIndex(MapCoord((u16)(i % 1024), (u16)(i / 1024)));
+  }
+
+  written += fwrite(coord_regions.data(), kMaxNodes * sizeof(RegionIndex), 1, f);
+
+  if (fclose(f) != 0) {
+    written = 0;
+  }
+
+  if (written != 4) {
+    Log(LogLevel::Warning, "Failed to write the entire graph cache to %s.", temp_path);
+    remove(temp_path);
+    return false;
+  }
+
+  if (!ReplaceCacheFile(temp_path, path)) {
+    Log(LogLevel::Warning, "Failed to replace the graph cache at %s.", path);
+    remove(temp_path);
+    return false;
+  }
+
+  Log(LogLevel::Info, "Saved pathfinder graph to %s.", path);
+
+  return true;
+}
+
+}  // namespace path
+}  // namespace zero
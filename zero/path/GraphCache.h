@@ -0,0 +1,22 @@
+#pragma once
+
+#include <zero/RegionRegistry.h>
+#include <zero/path/Pathfinder.h>
+
+namespace zero {
+namespace path {
+
+// The graph cache stores the computed node flags, weights, edges and regions for a map in a file next to the map.
+// The file is keyed by the map checksum and ship radius, so a map that was seen before can skip CreateAll and
+// CreateMapWeights. Any change to the file layout should increase kGraphCacheVersion so old files are rebuilt.
+constexpr u32 kGraphCacheVersion = 3;
+
+// Loads the graph for the map into the pathfinder and registry. Returns false if there's no valid cache file.
+bool LoadGraphCache(const Map& map, const Pathfinder::WeightConfig& config, Pathfinder& pathfinder,
+                    RegionRegistry& registry);
+
+// Writes the current graph of the pathfinder and registry to the cache file for the map.
+bool SaveGraphCache(const Map& map, Pathfinder& pathfinder, const RegionRegistry& registry);
+
+}  // namespace path
+}  // namespace zero
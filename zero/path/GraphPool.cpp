@@ -0,0 +1,135 @@
+#include "GraphPool.h"
+
+#include <zero/game/Game.h>
+#include <zero/game/Logger.h>
+#include <zero/game/Memory.h>
+#include <zero/path/GraphCache.h>
+
+namespace zero {
+namespace path {
+
+// Scratch memory for CreateMapWeights, since the game's temp arena can only be used on the game thread.
+constexpr size_t kBuildScratchSize = Kilobytes(64);
+
+GraphPool::~GraphPool() {
+  WaitForBuilds();
+}
+
+void GraphPool::Prebuild(const Map& map, const std::vector<float>& radii) {
+  if (map.checksum == 0 || map.checksum != map_checksum_) {
+    Clear();
+  } else {
+    Log(LogLevel::Info, "Reusing pathfinder graphs from previous arena.");
+
+    ForEachReady([](Graph& graph) { graph.pathfinder->ResetDynamicState(); });
+  }
+
+  map_checksum_ = map.checksum;
+
+  for (float radius : radii) {
+    if (!Find(radius)) {
+      StartBuild(map, radius);
+    }
+  }
+}
+
+GraphPool::Graph* GraphPool::Get(const Map& map, float radius) {
+  if (map.checksum == 0 || map.checksum != map_checksum_) {
+    Clear();
+    map_checksum_ = map.checksum;
+  }
+
+  Entry* entry = Find(radius);
+
+  if (!entry) {
+    entry = StartBuild(map, radius);
+  }
+
+  return entry->ready ? &entry->graph : nullptr;
+}
+
+GraphPool::Graph* GraphPool::Wait(const Map& map, float radius) {
+  Graph* graph = Get(map, radius);
+
+  if (graph) return graph;
+
+  Entry* entry = Find(radius);
+
+  if (entry->thread.joinable()) {
+    entry->thread.join();
+  }
+
+  return &entry->graph;
+}
+
+void GraphPool::WaitForBuilds() {
+  for (auto& entry : entries_) {
+    if (entry->thread.joinable()) {
+      entry->thread.join();
+    }
+  }
+}
+
+void GraphPool::Clear() {
+  WaitForBuilds();
+  entries_.clear();
+  map_checksum_ = 0;
+}
+
+GraphPool::Entry* GraphPool::Find(float radius) {
+  for (auto& entry : entries_) {
+    if (entry->graph.radius == radius) {
+      return entry.get();
+    }
+  }
+
+  return nullptr;
+}
+
+GraphPool::Entry* GraphPool::StartBuild(const Map& map, float radius) {
+  entries_.push_back(std::make_unique<Entry>());
+
+  Entry* entry = entries_.back().get();
+
+  entry->graph.radius = radius;
+  // Bricks are removed from the copy so they don't end up in the graph or its cache.
+  entry->thread = std::thread(&GraphPool::BuildGraph, this, std::make_unique<MapSnapshot>(map), entry);
+
+  return entry;
+}
+
+void GraphPool::BuildGraph(std::unique_ptr<MapSnapshot> snapshot, Entry* entry) {
+  const Map& map = snapshot->map;
+  Graph& graph = entry->graph;
+
+  Log(LogLevel::Info, "Creating new registry and pathfinder for radius %f.", graph.radius);
+
+  auto processor = std::make_unique<NodeProcessor>(game_);
+
+  graph.region_registry = std::make_unique<RegionRegistry>();
+  graph.pathfinder = std::make_unique<Pathfinder>(std::move(processor), *graph.region_registry);
+
+  Pathfinder::WeightConfig cfg = {};
+
+  cfg.ship_radius = graph.radius;
+  cfg.wall_distance = 5;
+  cfg.weight_type = Pathfinder::WeightType::Exponential;
+
+  // Building the graph is slow on large maps, so try to load it from a previous run first.
+  if (!LoadGraphCache(map, cfg, *graph.pathfinder, *graph.region_registry)) {
+    std::vector<u8> scratch(kBuildScratchSize);
+    MemoryArena temp_arena(scratch.data(), scratch.size());
+
+    graph.region_registry->CreateAll(map, graph.radius);
+    graph.pathfinder->CreateMapWeights(temp_arena, map, cfg);
+    SaveGraphCache(map, *graph.pathfinder, *graph.region_registry);
+  }
+
+  graph.region_registry->BuildDoorConnectivity(map, graph.radius);
+  graph.region_registry->BuildAreaGraph(map, graph.pathfinder->GetWallDistances(map));
+
+  entry->ready = true;
+}
+
+}  // namespace path
+}  // namespace zero
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <zero/RegionRegistry.h>
+#include <zero/Types.h>
+#include <zero/path/MapSnapshot.h>
+#include <zero/path/Pathfinder.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace zero {
+
+struct Game;
+
+namespace path {
+
+// Keeps a pathfinder and region registry for each ship radius of the current map.
+// The graphs are built on their own threads, so changing ships only has to swap to the graph for the new radius.
+// This is only used from the game thread. The build threads only touch their own graph and a copy of the map that is
+// taken when the build starts, so doors and bricks can keep changing while they run.
+class GraphPool {
+ public:
+  struct Graph {
+    float radius = 0.0f;
+    std::unique_ptr<Pathfinder> pathfinder;
+    std::unique_ptr<RegionRegistry> region_registry;
+  };
+
+  GraphPool(Game& game) : game_(game) {}
+  ~GraphPool();
+
+  // Starts building a graph for each radius that isn't in the pool yet.
+  // Graphs from a different map are dropped first. Graphs for the same map are kept with their dynamic state reset.
+  void Prebuild(const Map& map, const std::vector<float>& radii);
+
+  // Returns the graph for the radius if it's finished building. A build is started if the radius isn't in the pool.
+  Graph* Get(const Map& map, float radius);
+  // Returns the graph for the radius, building it on this thread if it doesn't exist yet.
+  Graph* Wait(const Map& map, float radius);
+
+  // Blocks until every build finishes.
+  void WaitForBuilds();
+  void Clear();
+
+  template <typename F>
+  void ForEachReady(F&& f) {
+    for (auto& entry : entries_) {
+      if (entry->ready) f(entry->graph);
+    }
+  }
+
+ private:
+  struct Entry {
+    Graph graph;
+    std::thread thread;
+    std::atomic<bool> ready = false;
+  };
+
+  Entry* Find(float radius);
+  Entry* StartBuild(const Map& map, float radius);
+  void BuildGraph(std::unique_ptr<MapSnapshot> snapshot, Entry* entry);
+
+  Game& game_;
+  u32 map_checksum_ = 0;
+  std::vector<std::unique_ptr<Entry>> entries_;
+};
+
+}  // namespace path
+}  // namespace zero
@@ -0,0 +1,296 @@
+#include "IncrementalPlanner.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace zero {
+namespace path {
+
+constexpr float kUnreachable = std::numeric_limits<float>::max();
+
+static inline u32 GetTileIndex(NodePoint point) {
+  return (u32)point.y * 1024 + point.x;
+}
+
+static inline NodePoint GetIndexPoint(u32 index) {
+  return NodePoint((u16)(index % 1024), (u16)(index / 1024));
+}
+
+static inline bool GetNeighbor(NodePoint point, size_t direction, NodePoint* neighbor) {
+  CoordOffset offset = CoordOffset::FromIndex(direction);
+  s32 x = point.x + offset.x;
+  s32 y = point.y + offset.y;
+
+  if (x < 0 || y < 0 || x >= 1024 || y >= 1024) return false;
+
+  *neighbor = NodePoint((u16)x, (u16)y);
+  return true;
+}
+
+static inline float Heuristic(NodePoint from, NodePoint to) {
+  float dx = (float)from.x - (float)to.x;
+  float dy = (float)from.y - (float)to.y;
+
+  return sqrtf(dx * dx + dy * dy);
+}
+
+IncrementalPlanner::IncrementalPlanner(NodeProcessor& processor, float radius, u16 frequency)
+    : processor_(processor), radius_(radius), frequency_(frequency), nodes_(kMaxNodes) {}
+
+IncrementalPath IncrementalPlanner::FindPath(NodePoint start, NodePoint goal,
+                                             std::shared_ptr<const DynamicState> state) {
+  IncrementalPath path;
+
+  if (start.x >= 1024 || start.y >= 1024 || goal.x >= 1024 || goal.y >= 1024) return path;
+
+  state_ = std::move(state);
+
+  nodes_expanded_ = 0;
+
+  if (!searched_ || !(goal == goal_)) {
+    Reset(start, goal);
+  } else {
+    if (!(start == start_)) {
+      key_modifier_ += Heuristic(start_, start);
+      start_ = start;
+    }
+
+    Repair();
+  }
+
+  ComputePath();
+
+  path.nodes_expanded = nodes_expanded_;
+
+  u32 start_index = GetTileIndex(start_);
+
+  if (GetNode(start_index)->g == kUnreachable) return path;
+
+  path.cost = GetNode(start_index)->g;
+
+  NodePoint current = start_;
+
+  path.points.push_back(current);
+
+  // Walk down the costs to the goal. The step count bounds the walk in case a cost is inconsistent.
+  for (size_t i = 0; i < kMaxNodes && !(current == goal_); ++i) {
+    float best_cost = kUnreachable;
+    NodePoint best;
+
+    for (size_t direction = 0; direction < 4; ++direction) {
+      NodePoint neighbor;
+
+      if (!GetNeighbor(current, direction, &neighbor)) continue;
+
+      float travel_cost = GetTravelCost(current, direction);
+      float neighbor_g = GetNode(GetTileIndex(neighbor))->g;
+
+      if (travel_cost < 0.0f || neighbor_g == kUnreachable) continue;
+
+      if (travel_cost + neighbor_g < best_cost) {
+        best_cost = travel_cost + neighbor_g;
+        best = neighbor;
+      }
+    }
+
+    if (best_cost == kUnreachable) return IncrementalPath();
+
+    if (processor_.FindEdges(current, *state_).HasDynamic()) {
+      path.dynamic = true;
+    }
+
+    current = best;
+    path.points.push_back(current);
+  }
+
+  if (!(current == goal_)) return IncrementalPath();
+
+  return path;
+}
+
+void IncrementalPlanner::InvalidateTiles(const std::vector<NodePoint>& points) {
+  pending_.insert(pending_.end(), points.begin(), points.end());
+}
+
+void IncrementalPlanner::InvalidateTile(NodePoint point) {
+  pending_.push_back(point);
+}
+
+void IncrementalPlanner::Reset(NodePoint start, NodePoint goal) {
+  if (++generation_ == 0) {
+    // The generation wrapped around, so old stamps could match again.
+    for (PlannerNode& node : nodes_) {
+      node.generation = 0;
+    }
+
+    generation_ = 1;
+  }
+
+  start_ = start;
+  goal_ = goal;
+  key_modifier_ = 0.0f;
+  searched_ = true;
+
+  pending_.clear();
+  openset_.clear();
+
+  u32 goal_index = GetTileIndex(goal_);
+
+  GetNode(goal_index)->rhs = 0.0f;
+  PushNode(goal_index);
+}
+
+// The changed tiles and their neighbors have their costs recalculated. Any that no longer match their neighbors are
+// queued, and ComputePath spreads the change to the tiles that depend on them.
+void IncrementalPlanner::Repair() {
+  for (NodePoint point : pending_) {
+    if (point.x >= 1024 || point.y >= 1024) continue;
+
+    UpdateNode(GetTileIndex(point));
+
+    for (size_t direction = 0; direction < 4; ++direction) {
+      NodePoint neighbor;
+
+      if (GetNeighbor(point, direction, &neighbor)) {
+        UpdateNode(GetTileIndex(neighbor));
+      }
+    }
+  }
+
+  pending_.clear();
+}
+
+void IncrementalPlanner::ComputePath() {
+  u32 start_index = GetTileIndex(start_);
+
+  while (!openset_.empty()) {
+    PlannerNode* start = GetNode(start_index);
+
+    // The start has to be expanded once its cost is found, or the walk to the goal would see it as unreachable.
+    if (!(CalculateKey(start_index) > openset_.front()) && start->rhs == start->g) break;
+
+    std::pop_heap(openset_.begin(), openset_.end(), std::greater<QueueEntry>());
+    QueueEntry entry = openset_.back();
+    openset_.pop_back();
+
+    PlannerNode* node = GetNode(entry.index);
+
+    // The node was already settled by a newer entry.
+    if (node->g == node->rhs) continue;
+
+    QueueEntry current_key = CalculateKey(entry.index);
+
+    // The start moved since this was queued, so it needs to be ordered again.
+    if (current_key > entry) {
+      openset_.push_back(current_key);
+      std::push_heap(openset_.begin(), openset_.end(), std::greater<QueueEntry>());
+      continue;
+    }
+
+    ++nodes_expanded_;
+
+    if (node->g > node->rhs) {
+      node->g = node->rhs;
+    } else {
+      // The cost went up, so the node and everything routed through it must be recalculated.
+      node->g = kUnreachable;
+      UpdateNode(entry.index);
+    }
+
+    NodePoint point = GetIndexPoint(entry.index);
+
+    for (size_t direction = 0; direction < 4; ++direction) {
+      NodePoint neighbor;
+
+      if (GetNeighbor(point, direction, &neighbor)) {
+        UpdateNode(GetTileIndex(neighbor));
+      }
+    }
+  }
+}
+
+// Recalculates the node's cost from its neighbors and queues it if it's inconsistent.
+void IncrementalPlanner::UpdateNode(u32 index) {
+  PlannerNode* node = GetNode(index);
+
+  if (index != GetTileIndex(goal_)) {
+    NodePoint point = GetIndexPoint(index);
+    float rhs = kUnreachable;
+
+    for (size_t direction = 0; direction < 4; ++direction) {
+      NodePoint neighbor;
+
+      if (!GetNeighbor(point, direction, &neighbor)) continue;
+
+      float neighbor_g = GetNode(GetTileIndex(neighbor))->g;
+
+      if (neighbor_g == kUnreachable) continue;
+
+      float travel_cost = GetTravelCost(point, direction);
+
+      if (travel_cost < 0.0f) continue;
+
+      rhs = std::min(rhs, travel_cost + neighbor_g);
+    }
+
+    node->rhs = rhs;
+  }
+
+  if (node->g != node->rhs) {
+    PushNode(index);
+  }
+}
+
+void IncrementalPlanner::PushNode(u32 index) {
+  openset_.push_back(CalculateKey(index));
+  std::push_heap(openset_.begin(), openset_.end(), std::greater<QueueEntry>());
+}
+
+IncrementalPlanner::QueueEntry IncrementalPlanner::CalculateKey(u32 index) {
+  PlannerNode* node = GetNode(index);
+  float cost = std::min(node->g, node->rhs);
+
+  QueueEntry entry;
+
+  entry.index = index;
+  entry.tie = cost;
+  entry.key = cost == kUnreachable ? kUnreachable : cost + Heuristic(start_, GetIndexPoint(index)) + key_modifier_;
+
+  return entry;
+}
+
+IncrementalPlanner::PlannerNode* IncrementalPlanner::GetNode(u32 index) {
+  PlannerNode* node = &nodes_[index];
+
+  if (node->generation != generation_) {
+    node->g = node->rhs = kUnreachable;
+    node->generation = generation_;
+  }
+
+  return node;
+}
+
+float IncrementalPlanner::GetTravelCost(NodePoint point, size_t direction) {
+  NodePoint neighbor;
+
+  if (!GetNeighbor(point, direction, &neighbor)) return -1.0f;
+  if (!CanEnter(point) || !CanEnter(neighbor)) return -1.0f;
+  if (!processor_.FindEdges(point, *state_).IsSet(direction)) return -1.0f;
+
+  return GetEdgeCost(processor_.PeekNode(point.x, point.y), processor_.PeekNode(neighbor.x, neighbor.y));
+}
+
+bool IncrementalPlanner::CanEnter(NodePoint point) {
+  const Node* node = processor_.PeekNode(point.x, point.y);
+
+  if (!node || !(node->flags & NodeFlag_Traversable)) return false;
+
+  if (state_->bricks && state_->bricks->IsSolid(point.x, point.y, frequency_)) return false;
+
+  return processor_.IsTraversable(node, point, *state_);
+}
+
+}  // namespace path
+}  // namespace zero
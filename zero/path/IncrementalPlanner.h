@@ -0,0 +1,99 @@
+#pragma once
+
+#include <zero/Types.h>
+#include <zero/path/NodeProcessor.h>
+
+#include <memory>
+#include <vector>
+
+namespace zero {
+namespace path {
+
+// The result of an incremental search.
+struct IncrementalPath {
+  std::vector<NodePoint> points;
+  float cost = 0.0f;
+  bool dynamic = false;
+  size_t nodes_expanded = 0;
+};
+
+// D* Lite search that keeps its search tree between queries to the same goal.
+// The search runs backward from the goal, so the start can move without invalidating anything. Door and brick changes
+// only repair the tiles whose cost went through the changed tiles instead of searching the whole path again.
+// Changing the goal tile starts a new search.
+class IncrementalPlanner {
+ public:
+  IncrementalPlanner(NodeProcessor& processor, float radius, u16 frequency);
+
+  // Finds the path from the start to the goal. The points start with the start tile and end with the goal tile.
+  // Returns an empty path if the goal can't be reached.
+  // The kept costs are repaired with the door and brick state, so it should be the newest one.
+  IncrementalPath FindPath(NodePoint start, NodePoint goal, std::shared_ptr<const DynamicState> state);
+
+  // Marks the tiles as changed so the costs through them are repaired on the next search.
+  void InvalidateTiles(const std::vector<NodePoint>& points);
+  void InvalidateTile(NodePoint point);
+
+  inline bool Matches(float radius, u16 frequency) const { return radius_ == radius && frequency_ == frequency; }
+
+  inline size_t GetMemoryUsage() const {
+    return sizeof(*this) + nodes_.capacity() * sizeof(PlannerNode) + pending_.capacity() * sizeof(NodePoint) +
+           openset_.capacity() * sizeof(QueueEntry);
+  }
+
+ private:
+  struct PlannerNode {
+    float g;
+    float rhs;
+    // The generation of the search that last reset this node.
+    u32 generation;
+  };
+
+  struct QueueEntry {
+    float key;
+    float tie;
+    u32 index;
+
+    bool operator>(const QueueEntry& other) const {
+      if (key != other.key) return key > other.key;
+      return tie > other.tie;
+    }
+  };
+
+  void Reset(NodePoint start, NodePoint goal);
+  void Repair();
+  void ComputePath();
+
+  void UpdateNode(u32 index);
+  void PushNode(u32 index);
+  QueueEntry CalculateKey(u32 index);
+
+  PlannerNode* GetNode(u32 index);
+  // Returns the cost of traveling from the point into its neighbor in the provided direction, or a negative value if
+  // the neighbor can't be entered from the point.
+  float GetTravelCost(NodePoint point, size_t direction);
+  bool CanEnter(NodePoint point);
+
+  NodeProcessor& processor_;
+  float radius_;
+  u16 frequency_;
+  // The door and brick state of the current search.
+  std::shared_ptr<const DynamicState> state_;
+
+  NodePoint start_;
+  NodePoint goal_;
+  bool searched_ = false;
+  // This is raised when the start moves so the keys that were already queued stay lower bounds.
+  float key_modifier_ = 0.0f;
+
+  std::vector<PlannerNode> nodes_;
+  u32 generation_ = 0;
+
+  std::vector<NodePoint> pending_;
+  // Lazy deletion heap. Entries are skipped when they are popped if their node was updated after they were pushed.
+  std::vector<QueueEntry> openset_;
+  size_t nodes_expanded_ = 0;
+};
+
+}  // namespace path
+}  // namespace zero
@@ -0,0 +1,47 @@
+#include "MapSnapshot.h"
+
+namespace zero {
+namespace path {
+
+MapSnapshot::MapSnapshot(const Map& source, Bricks bricks) : map(source) {
+  map.brick_manager = nullptr;
+
+  // The rest of the map's lists are in its arena, which is reset when the next map loads.
+  map.data = nullptr;
+
+  for (AnimatedTileSet& set : map.animated_tiles) {
+    set = {};
+  }
+
+  if (source.door_count > 0) {
+    doors.assign(source.doors, source.doors + source.door_count);
+  }
+
+  map.doors = doors.data();
+
+  if (!source.tiles) {
+    map.solid_bits = nullptr;
+    map.occupancy_table = nullptr;
+    return;
+  }
+
+  tiles.assign(source.tiles, source.tiles + 1024 * 1024);
+  solid_words.resize(kSolidDataWordCount);
+
+  map.tiles = tiles.data();
+
+  // The copy would otherwise share the source map's bitmaps instead of seeing its own tiles.
+  if (bricks == Bricks::Keep) {
+    map.CopySolidData(source, solid_words.data());
+    return;
+  }
+
+  for (u8& id : tiles) {
+    if (id == kTileIdBrick) id = 0;
+  }
+
+  map.AttachSolidData(solid_words.data());
+}
+
+}  // namespace path
+}  // namespace zero
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <zero/Types.h>
+#include <zero/game/Map.h>
+
+#include <vector>
+
+namespace zero {
+namespace path {
+
+// A copy of the map's tiles, doors and solid data that other threads can read while the game thread changes doors and
+// bricks. Nothing in the copy points into the map's arena, so it can outlive the map being reloaded.
+struct MapSnapshot {
+  enum class Bricks {
+    // Bricks are removed from the copy, since they only exist for a few seconds and are checked separately.
+    Remove,
+    // Bricks stay in the copy, but without the brick manager they are solid to every frequency.
+    Keep
+  };
+
+  MapSnapshot(const Map& source, Bricks bricks = Bricks::Remove);
+
+  MapSnapshot(const MapSnapshot&) = delete;
+  MapSnapshot& operator=(const MapSnapshot&) = delete;
+
+  Map map;
+  std::vector<u8> tiles;
+  std::vector<Tile> doors;
+  std::vector<u64> solid_words;
+};
+
+}  // namespace path
+}  // namespace zero
@@ -15,27 +15,17 @@ struct NodePoint {
   bool operator==(const NodePoint& other) const { return x == other.x && y == other.y; }
 };
 
+// These are the static flags of the graph. Search state is stored separately in SearchState.
 enum NodeFlag {
-  NodeFlag_Openset = (1 << 0),
-  NodeFlag_Touched = (1 << 1),
-  NodeFlag_Initialized = (1 << 2),
-  NodeFlag_Traversable = (1 << 3),
-  NodeFlag_Safety = (1 << 4),
-  // Brick is handled here instead of checking map to improve performance.
-  // If it checked the map then it would be going all over the place with memory touches.
-  NodeFlag_Brick = (1 << 5),
-  // This marks the node as visitable, but it must first be checked if it can currently be occupied.
+  NodeFlag_Traversable = (1 << 0),
+  NodeFlag_Safety = (1 << 1),
+  // This marks the node as visitable, but the door state must be checked to see if it can currently be occupied.
   // This is used for empty spaces in the map that might be obstructed by surrounding doors.
-  NodeFlag_DynamicEmpty = (1 << 6),
+  NodeFlag_DynamicEmpty = (1 << 3),
 };
 typedef u32 NodeFlags;
 
 struct Node {
-  u32 parent_id;
-
-  float g;
-  float f;
-
   u8 flags;
 
  private:
@@ -43,9 +33,12 @@ struct Node {
   u8 weight;
 
  public:
-  Node() : flags(0), parent_id(~0), g(0.0f), f(0.0f), weight(10) {}
+  Node() : flags(0), weight(10) {}
 
   inline float GetWeight() const { return weight / 10.0f; }
+  // The fixed point weight is exposed so it can be saved and loaded without rounding.
+  inline u8 GetFixedWeight() const { return weight; }
+  inline void SetFixedWeight(u8 v) { weight = v; }
   inline void SetWeight(float v) {
     u32 calc = (u32)(v * 10.0f);
 
@@ -57,5 +50,19 @@ struct Node {
   }
 };
 
+// The edge weight for entering a safe zone from a non-safe tile.
+// This is set here instead of stored in a node so traveling through multiple safe tiles isn't very expensive.
+constexpr float kSafetyWeight = 300.0f;
+
+// The cost of moving from one node into a neighbor node.
+inline float GetEdgeCost(const Node* from, const Node* to) {
+  // Only set a very high movement cost upon first entering a safety tile.
+  if ((to->flags & NodeFlag_Safety) && !(from->flags & NodeFlag_Safety)) {
+    return kSafetyWeight;
+  }
+
+  return to->GetWeight();
+}
+
 }  // namespace path
 }  // namespace zero
@@ -2,6 +2,8 @@
 #include <zero/game/Logger.h>
 #include <zero/path/NodeProcessor.h>
 
+#include <string.h>
+
 namespace zero {
 namespace path {
 
@@ -12,28 +14,113 @@ static inline bool IsDynamicTile(const Map& map, u16 world_x, u16 world_y) {
   return tile_id >= kTileIdFirstDoor && tile_id <= (kTileIdLastDoor + 1);
 }
 
-bool NodeProcessor::UpdateDynamicNode(Node* node, float ship_radius, u16 frequency) {
-  if (!(node->flags & NodeFlag_DynamicEmpty)) {
-    return node->flags & NodeFlag_Traversable;
+NodeProcessor::NodeProcessor(Game& game) : dynamic_state_(std::make_shared<DynamicState>()), game_(game) {
+  memset(block_slots_, 0, sizeof(block_slots_));
+
+  // Start with only the shared solid block so lookups are valid before the graph is built.
+  block_indexes_.resize(1, 0);
+  edges_ = std::make_unique<EdgeSet[]>(kNodeBlockTiles);
+  nodes_ = std::make_unique<Node[]>(kNodeBlockTiles);
+  node_count_ = kNodeBlockTiles;
+}
+
+void NodeProcessor::AllocateBlocks(const Map& map) {
+  u16 slot_count = 1;
+  size_t first_solid_block = 0;
+  bool found_solid_block = false;
+
+  for (size_t block_index = 0; block_index < kNodeBlockCount; ++block_index) {
+    u16 start_x = (u16)((block_index % kNodeBlocksPerRow) * kNodeBlockSize);
+    u16 start_y = (u16)((block_index / kNodeBlocksPerRow) * kNodeBlockSize);
+    bool empty = false;
+
+    for (u16 y = start_y; y < start_y + kNodeBlockSize && !empty; ++y) {
+      for (u16 x = start_x; x < start_x + kNodeBlockSize; ++x) {
+        if (!map.IsSolidEmptyDoors(x, y, 0xFFFF)) {
+          empty = true;
+          break;
+        }
+      }
+    }
+
+    if (empty) {
+      block_slots_[block_index] = slot_count++;
+    } else {
+      block_slots_[block_index] = 0;
+
+      if (!found_solid_block) {
+        first_solid_block = block_index;
+        found_solid_block = true;
+      }
+    }
   }
 
-  NodePoint node_point = this->GetPoint(node);
-  Vector2f node_position((float)node_point.x, (float)node_point.y);
-  size_t node_index = (size_t)node_point.y * 1024 + node_point.x;
-  MemoryArena& arena = GetGame().temp_arena;
-  const Map& map = GetGame().GetMap();
-  MemoryRevert reverter = arena.GetReverter();
+  // The shared block reports the position of a solid block so any point calculated from it is never traversable.
+  block_indexes_.resize(slot_count);
+  block_indexes_[0] = (u16)first_solid_block;
 
-  OccupiedRect* rects = memory_arena_push_type_count(&arena, OccupiedRect, 256);
+  for (size_t block_index = 0; block_index < kNodeBlockCount; ++block_index) {
+    if (block_slots_[block_index] != 0) {
+      block_indexes_[block_slots_[block_index]] = (u16)block_index;
+    }
+  }
 
-  size_t rect_count =
-      map.GetAllOccupiedRects(Vector2f((float)node_point.x, (float)node_point.y), ship_radius, frequency, rects, true);
+  node_count_ = (size_t)slot_count * kNodeBlockTiles;
+  edges_ = std::make_unique<EdgeSet[]>(node_count_);
+  nodes_ = std::make_unique<Node[]>(node_count_);
+  dynamic_points.clear();
+  dynamic_indexes_.Clear();
 
-  // Clear the dynamic flag so we don't have to update this again until doors change. Also make it non-traversable.
-  node->flags &= ~(NodeFlag_DynamicEmpty | NodeFlag_Traversable);
+  // The overlay is ordered by the old dynamic points.
+  SetDoorOverlay(nullptr);
+}
 
-  EdgeSet new_set = {};
-  edges_[node_index] = new_set;
+void NodeProcessor::IndexDynamicPoints() {
+  dynamic_indexes_.Clear();
+
+  for (size_t i = 0; i < dynamic_points.size(); ++i) {
+    dynamic_indexes_.Set(dynamic_points[i].x, dynamic_points[i].y, (s32)i);
+  }
+}
+
+void NodeProcessor::SetDoorOverlay(std::shared_ptr<const DoorOverlay> overlay) {
+  auto state = std::make_shared<DynamicState>(*GetDynamicState());
+
+  state->doors = std::move(overlay);
+  dynamic_state_.store(std::move(state));
+}
+
+void NodeProcessor::SetDoorSolidMethod(DoorSolidMethod door_method) {
+  auto state = std::make_shared<DynamicState>(*GetDynamicState());
+
+  state->door_method = door_method;
+  dynamic_state_.store(std::move(state));
+}
+
+void NodeProcessor::SetBricks(std::shared_ptr<const BrickSet> bricks) {
+  auto state = std::make_shared<DynamicState>(*GetDynamicState());
+
+  state->bricks = std::move(bricks);
+  dynamic_state_.store(std::move(state));
+}
+
+size_t NodeProcessor::GetMemoryUsage() const {
+  return sizeof(*this) + block_indexes_.capacity() * sizeof(u16) + node_count_ * (sizeof(Node) + sizeof(EdgeSet)) +
+         dynamic_points.capacity() * sizeof(NodePoint) + dynamic_indexes_.GetMemoryUsage() - sizeof(dynamic_indexes_) +
+         occupied_rects_.GetMemoryUsage() - sizeof(occupied_rects_);
+}
+
+template <typename Traversable>
+bool NodeProcessor::CalculateDynamicState(const Map& map, NodePoint point, float ship_radius, u16 frequency,
+                                          EdgeSet* edges, Traversable&& is_traversable) {
+  Vector2f node_position((float)point.x, (float)point.y);
+
+  // This is stored on the stack instead of the temp arena so it can run outside of the game thread.
+  OccupiedRect rects[256];
+
+  size_t rect_count = occupied_rects_.GetRects(map, node_position, ship_radius, frequency, rects, true);
+
+  *edges = {};
 
   // If there's only two and the two are offset from each other, then we must be on a diagonal tile and should not
   // proceed.
@@ -41,29 +128,31 @@ bool NodeProcessor::UpdateDynamicNode(Node* node, float ship_radius, u16 frequen
     return false;
   }
 
+  bool traversable = false;
+
   // Check if we can even occupy this location.
   for (size_t i = 0; i < rect_count; ++i) {
     OccupiedRect* rect = rects + i;
 
     if (rect->Contains(node_position)) {
-      node->flags |= NodeFlag_Traversable;
+      traversable = true;
       break;
     }
   }
 
-  if (!(node->flags & NodeFlag_Traversable)) return false;
+  if (!traversable) return false;
 
   static const CoordOffset neighbors[4] = {CoordOffset::North(), CoordOffset::South(), CoordOffset::West(),
                                            CoordOffset::East()};
 
   // Recompute EdgeSet.
   for (size_t i = 0; i < 4; ++i) {
-    uint16_t world_x = node_point.x + neighbors[i].x;
-    uint16_t world_y = node_point.y + neighbors[i].y;
+    uint16_t world_x = point.x + neighbors[i].x;
+    uint16_t world_y = point.y + neighbors[i].y;
 
     // If we are smaller than 1 tile, then we need to do solid checks for neighbors.
     if (ship_radius <= 0.5f) {
-      if (map_.IsSolidEmptyDoors(world_x, world_y, 0xFFFF)) {
+      if (map.IsSolidEmptyDoors(world_x, world_y, 0xFFFF)) {
         continue;
       }
     } else {
@@ -84,57 +173,110 @@ bool NodeProcessor::UpdateDynamicNode(Node* node, float ship_radius, u16 frequen
       }
     }
 
-    NodePoint current_point(world_x, world_y);
-    Node* current = GetNode(current_point);
-
-    if (!current) continue;
-    if (!(current->flags & NodeFlag_Traversable)) continue;
+    if (world_x >= 1024 || world_y >= 1024) continue;
+    if (!is_traversable(NodePoint(world_x, world_y))) continue;
 
-    new_set.Set(i);
+    edges->Set(i);
 
-    if (IsDynamicTile(map_, world_x, world_y)) {
-      new_set.DynamicSet(i);
+    if (IsDynamicTile(map, world_x, world_y)) {
+      edges->DynamicSet(i);
     }
   }
 
-  edges_[node_index] = new_set;
+  return true;
+}
+
+void NodeProcessor::BuildDoorOverlay(const Map& map, float ship_radius, DoorOverlay* overlay) {
+  size_t count = dynamic_points.size();
+
+  overlay->edges.resize(count);
+  overlay->traversable.resize(count);
+
+  // Other dynamic points are assumed to be traversable here since they might not be calculated yet.
+  for (size_t i = 0; i < count; ++i) {
+    overlay->traversable[i] =
+        CalculateDynamicState(map, dynamic_points[i], ship_radius, 0xFFFF, &overlay->edges[i], [this](NodePoint point) {
+          if (dynamic_indexes_.Get(point.x, point.y) >= 0) return true;
 
-  return node->flags & NodeFlag_Traversable;
+          return (PeekNode(point.x, point.y)->flags & NodeFlag_Traversable) != 0;
+        });
+  }
+
+  // Remove the edges into dynamic points that the doors block now that they are all known.
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t direction = 0; direction < 4; ++direction) {
+      if (!overlay->edges[i].IsSet(direction)) continue;
+
+      CoordOffset offset = CoordOffset::FromIndex(direction);
+      s32 neighbor_index = dynamic_indexes_.Get(dynamic_points[i].x + offset.x, dynamic_points[i].y + offset.y);
+
+      if (neighbor_index >= 0 && !overlay->traversable[neighbor_index]) {
+        overlay->edges[i].Erase(direction);
+        overlay->edges[i].DynamicErase(direction);
+      }
+    }
+  }
 }
 
-EdgeSet NodeProcessor::FindEdges(Node* node, float radius) {
-  NodePoint point = GetPoint(node);
-  size_t index = (size_t)point.y * 1024 + point.x;
-  EdgeSet edges = this->edges_[index];
-
-  for (size_t i = 0; i < 8; ++i) {
-    // Only check if the tile is dynamic, like doors.
-    if (!edges.DynamicIsSet(i)) continue;
-
-    switch (door_method_) {
-      case DoorSolidMethod::AlwaysOpen: {
-        // Do nothing so the edge stays.
-      } break;
-      case DoorSolidMethod::AlwaysSolid: {
-        // Remove the edge because it's always treated as solid.
-        edges.Erase(i);
-      } break;
-      case DoorSolidMethod::Dynamic: {
-        // Perform a solid check here to make sure doors haven't blocked us.
+EdgeSet NodeProcessor::FindEdges(NodePoint point, const DynamicState& state) const {
+  EdgeSet edges = GetEdgeSet(point.x, point.y);
+
+  // Only edges into tiles like doors can change.
+  if (!edges.HasDynamic()) return edges;
+
+  switch (state.door_method) {
+    case DoorSolidMethod::AlwaysOpen: {
+      // The stored edges are the ones the point has with every door open.
+    } break;
+    case DoorSolidMethod::AlwaysSolid: {
+      // Remove the dynamic edges because they are always treated as solid.
+      for (size_t i = 0; i < 4; ++i) {
+        if (edges.DynamicIsSet(i)) edges.Erase(i);
+      }
+    } break;
+    case DoorSolidMethod::Dynamic: {
+      if (!state.doors) break;
+
+      s32 index = dynamic_indexes_.Get(point.x, point.y);
+
+      // Dynamic points have their edges for the current doors in the overlay.
+      if (index >= 0 && (size_t)index < state.doors->edges.size()) {
+        edges = state.doors->edges[index];
+      }
+
+      // Remove the edges into the neighbors that the doors block.
+      for (size_t i = 0; i < 4; ++i) {
+        if (!edges.DynamicIsSet(i)) continue;
+
         CoordOffset offset = CoordOffset::FromIndex(i);
-        if (map_.IsSolid(point.x + offset.x, point.y + offset.y, 0xFFFF)) {
+        s32 neighbor_index = dynamic_indexes_.Get(point.x + offset.x, point.y + offset.y);
+
+        if (neighbor_index >= 0 && (size_t)neighbor_index < state.doors->traversable.size() &&
+            !state.doors->traversable[neighbor_index]) {
           edges.Erase(i);
         }
-      } break;
-      default: {
-      } break;
-    }
+      }
+    } break;
+    default: {
+    } break;
   }
 
   return edges;
 }
 
-EdgeSet NodeProcessor::CalculateEdges(Node* node, float radius, OccupiedRect* occupied_scratch) {
+bool NodeProcessor::IsTraversable(const Node* node, NodePoint point, const DynamicState& state) const {
+  if (!(node->flags & NodeFlag_Traversable)) return false;
+  if (!(node->flags & NodeFlag_DynamicEmpty)) return true;
+  if (!state.doors || state.door_method == DoorSolidMethod::AlwaysOpen) return true;
+
+  s32 index = dynamic_indexes_.Get(point.x, point.y);
+
+  if (index < 0 || (size_t)index >= state.doors->traversable.size()) return true;
+
+  return state.doors->traversable[index];
+}
+
+EdgeSet NodeProcessor::CalculateEdges(const Map& map, Node* node, float radius, OccupiedRect* occupied_scratch) {
   EdgeSet edges = {};
 
   NodePoint base_point = GetPoint(node);
@@ -148,8 +290,8 @@ EdgeSet NodeProcessor::CalculateEdges(Node* node, float radius, OccupiedRect* oc
                                            CoordOffset::East(),      CoordOffset::NorthWest(), CoordOffset::NorthEast(),
                                            CoordOffset::SouthWest(), CoordOffset::SouthEast()};
 
-  size_t occupied_count =
-      map_.GetAllOccupiedRects(Vector2f((float)base_point.x, (float)base_point.y), radius, 0xFFFF, occupied_scratch);
+  size_t occupied_count = occupied_rects_.GetRects(map, Vector2f((float)base_point.x, (float)base_point.y), radius,
+                                                   0xFFFF, occupied_scratch);
 
   for (std::size_t i = 0; i < 4; i++) {
     bool* requirement = requirements[i];
@@ -161,7 +303,7 @@ EdgeSet NodeProcessor::CalculateEdges(Node* node, float radius, OccupiedRect* oc
 
     // If we are smaller than 1 tile, then we need to do solid checks for neighbors.
     if (radius <= 0.5f) {
-      if (map_.IsSolidEmptyDoors(world_x, world_y, 0xFFFF)) {
+      if (map.IsSolidEmptyDoors(world_x, world_y, 0xFFFF)) {
         continue;
       }
     } else {
@@ -190,7 +332,7 @@ EdgeSet NodeProcessor::CalculateEdges(Node* node, float radius, OccupiedRect* oc
 
     edges.Set(i);
 
-    if (IsDynamicTile(map_, world_x, world_y)) {
+    if (IsDynamicTile(map, world_x, world_y)) {
       edges.DynamicSet(i);
     }
 
@@ -207,17 +349,7 @@ Node* NodeProcessor::GetNode(NodePoint point) {
     return nullptr;
   }
 
-  std::size_t index = point.y * 1024 + point.x;
-  Node* node = &nodes_[index];
-
-  if (!(node->flags & NodeFlag_Initialized)) {
-    node->parent_id = ~0;
-    // Set the node as initialized and clear openset/touched while keeping any other flags set.
-    node->flags = NodeFlag_Initialized | (node->flags & ~(NodeFlag_Openset | NodeFlag_Touched));
-    node->g = node->f = 0.0f;
-  }
-
-  return &nodes_[index];
+  return nodes_.get() + GetStorageIndex(block_slots_[GetBlockIndex(point.x, point.y)], point.x, point.y);
 }
 
 }  // namespace path
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <zero/TileGrid.h>
 #include <zero/Types.h>
 #include <zero/game/Game.h>
 #include <zero/game/Map.h>
 #include <zero/path/Node.h>
+#include <zero/path/OccupiedRectIndex.h>
 
+#include <atomic>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace zero {
@@ -15,16 +20,25 @@ namespace path {
 
 constexpr size_t kMaxNodes = 1024 * 1024;
 
+// Nodes are stored in square blocks of tiles. Only blocks that contain an empty tile are allocated.
+constexpr size_t kNodeBlockSize = 16;
+constexpr size_t kNodeBlockTiles = kNodeBlockSize * kNodeBlockSize;
+constexpr size_t kNodeBlocksPerRow = 1024 / kNodeBlockSize;
+constexpr size_t kNodeBlockCount = kNodeBlocksPerRow * kNodeBlocksPerRow;
+
+// Edges are only created in the four cardinal directions, so the low bits store the edges and the high bits store
+// which of them are dynamic. Diagonal indexes are never set.
 struct EdgeSet {
-  u8 set = 0;
-  u8 dynamic = 0;
+  u8 bits = 0;
 
-  inline bool IsSet(size_t index) const { return set & (1 << index); }
-  void Set(size_t index) { set |= (1 << index); }
-  void Erase(size_t index) { set &= ~(1 << index); }
+  inline bool IsSet(size_t index) const { return bits & 0x0F & (1 << index); }
+  void Set(size_t index) { bits |= (1 << index); }
+  void Erase(size_t index) { bits &= ~(1 << index); }
 
-  inline bool DynamicIsSet(size_t index) const { return dynamic & (1 << index); }
-  void DynamicSet(size_t index) { dynamic |= (1 << index); }
+  inline bool DynamicIsSet(size_t index) const { return bits & 0xF0 & (0x10 << index); }
+  void DynamicSet(size_t index) { bits |= (0x10 << index); }
+  void DynamicErase(size_t index) { bits &= ~(0x10 << index); }
+  inline bool HasDynamic() const { return bits & 0xF0; }
 };
 
 // All of the coords and indexes stored in this must stay in the same order.
@@ -72,77 +86,210 @@ enum class DoorSolidMethod {
   Dynamic
 };
 
+// The traversability and edges of every dynamic point for one configuration of open doors.
+struct DoorOverlay {
+  // These are stored in the same order as the processor's dynamic points.
+  std::vector<EdgeSet> edges;
+  std::vector<bool> traversable;
+};
+
+// The bricks that currently exist and the team that owns each one. A set is never changed once it's published, so
+// changes are made to a copy.
+class BrickSet {
+ public:
+  BrickSet() : block_counts_(kNodeBlockCount, 0) {}
+
+  void Set(u16 x, u16 y, u16 team) {
+    if (teams_.insert_or_assign(GetIndex(x, y), team).second) {
+      ++block_counts_[GetBlockIndex(x, y)];
+    }
+  }
+
+  void Erase(u16 x, u16 y) {
+    if (teams_.erase(GetIndex(x, y)) > 0) {
+      --block_counts_[GetBlockIndex(x, y)];
+    }
+  }
+
+  // Returns the team that owns the brick, or null if there's no brick on the tile.
+  inline const u16* GetTeam(u16 x, u16 y) const {
+    if (x >= 1024 || y >= 1024 || block_counts_[GetBlockIndex(x, y)] == 0) return nullptr;
+
+    auto iter = teams_.find(GetIndex(x, y));
+
+    return iter != teams_.end() ? &iter->second : nullptr;
+  }
+
+  inline bool Contains(u16 x, u16 y) const { return GetTeam(x, y) != nullptr; }
+
+  // Bricks are only solid to the frequencies that don't own them.
+  inline bool IsSolid(u16 x, u16 y, u16 frequency) const {
+    const u16* team = GetTeam(x, y);
+
+    return team && *team != frequency;
+  }
+
+  template <typename Callback>
+  void ForEach(Callback&& callback) const {
+    for (auto& [index, team] : teams_) {
+      callback((u16)(index % 1024), (u16)(index / 1024), team);
+    }
+  }
+
+ private:
+  static inline u32 GetIndex(u16 x, u16 y) { return (u32)y * 1024 + x; }
+  static inline size_t GetBlockIndex(u16 x, u16 y) {
+    return (y / kNodeBlockSize) * kNodeBlocksPerRow + (x / kNodeBlockSize);
+  }
+
+  std::unordered_map<u32, u16> teams_;
+  // The number of bricks in each block of tiles, so most tiles can be checked without a lookup.
+  std::vector<u16> block_counts_;
+};
+
+// The door and brick state that searches read. The graph is built with every door open, so the nodes and edges never
+// change and this decides which of the dynamic edges are currently blocked.
+struct DynamicState {
+  // The overlay for the current doors. Dynamic points keep the edges they have with every door open while it's null.
+  std::shared_ptr<const DoorOverlay> doors;
+  DoorSolidMethod door_method = DoorSolidMethod::Dynamic;
+  // The bricks aren't in the graph either, so searches check this before entering a tile. Null means no bricks.
+  std::shared_ptr<const BrickSet> bricks;
+
+  inline const u16* GetBrickTeam(u16 x, u16 y) const { return bricks ? bricks->GetTeam(x, y) : nullptr; }
+};
+
 // Determines the node edges when using A*.
 class NodeProcessor {
  public:
-  NodeProcessor(Game& game) : game_(game), map_(game.connection.map) {}
+  NodeProcessor(Game& game);
   Game& GetGame() { return game_; }
 
-  EdgeSet FindEdges(Node* node, float radius);
-  EdgeSet CalculateEdges(Node* node, float radius, OccupiedRect* occupied_scratch);
+  // Allocates a block of nodes for every block of tiles that has an empty tile. Solid blocks share one block that is
+  // never written. This clears all of the nodes, so it must happen before the graph is built.
+  void AllocateBlocks(const Map& map);
+  inline bool HasBlock(u16 x, u16 y) const { return block_slots_[GetBlockIndex(x, y)] != 0; }
+
+  // Removes the dynamic edges that the doors in the state block. The graph is never changed, so this can run on any
+  // thread.
+  EdgeSet FindEdges(NodePoint point, const DynamicState& state) const;
+  EdgeSet CalculateEdges(const Map& map, Node* node, float radius, OccupiedRect* occupied_scratch);
+
+  // Stores the occupied rects of every tile for the ship radius. This must happen before the graph is built.
+  inline void BuildOccupiedRectIndex(const Map& map, float radius) { occupied_rects_.Build(map, radius); }
+  inline const OccupiedRectIndex& GetOccupiedRectIndex() const { return occupied_rects_; }
+
   Node* GetNode(NodePoint point);
-  bool IsSolid(u16 x, u16 y) { return map_.IsSolid(x, y, 0xFFFF); }
 
-  // This will recompute traversability for the provided node and set the new flags.
-  // This will also recompute the EdgeSet.
-  // This is not thread-safe.
-  bool UpdateDynamicNode(Node* node, float ship_radius, u16 frequency);
+  // Checks if the node can be occupied with the doors in the state. Nodes that doors can't block only use their flags.
+  bool IsTraversable(const Node* node, NodePoint point, const DynamicState& state) const;
 
+  // The set is dropped if the tile is in an unallocated block.
   void SetEdgeSet(u16 x, u16 y, EdgeSet set) {
-    size_t index = (size_t)y * 1024 + x;
-    edges_[index] = set;
+    size_t slot = block_slots_[GetBlockIndex(x, y)];
+
+    if (slot == 0) return;
+
+    edges_[GetStorageIndex(slot, x, y)] = set;
+  }
+
+  // Returns the stored edge set without removing any dynamic edges that are currently blocked.
+  inline EdgeSet GetEdgeSet(u16 x, u16 y) const {
+    return edges_[GetStorageIndex(block_slots_[GetBlockIndex(x, y)], x, y)];
+  }
+
+  inline const Node* PeekNode(u16 x, u16 y) const {
+    if (x >= 1024 || y >= 1024) return nullptr;
+    return nodes_.get() + GetStorageIndex(block_slots_[GetBlockIndex(x, y)], x, y);
   }
 
-  // Calculate the node from the index.
+  // Calculate the node from its position in the block storage.
   // This lets the node exist without storing its position so it fits in cache better.
   inline NodePoint GetPoint(const Node* node) const {
-    size_t index = (node - &nodes_[0]);
+    size_t index = (node - nodes_.get());
+    size_t block_index = block_indexes_[index / kNodeBlockTiles];
+    size_t tile_index = index % kNodeBlockTiles;
 
-    uint16_t world_y = (uint16_t)(index / 1024);
-    uint16_t world_x = (uint16_t)(index % 1024);
+    uint16_t world_x = (uint16_t)((block_index % kNodeBlocksPerRow) * kNodeBlockSize + tile_index % kNodeBlockSize);
+    uint16_t world_y = (uint16_t)((block_index / kNodeBlocksPerRow) * kNodeBlockSize + tile_index / kNodeBlockSize);
 
     return NodePoint(world_x, world_y);
   }
 
+  // Node indexes are tile indexes so they don't depend on which blocks are allocated.
   inline Node* GetNodeFromIndex(u32 index) {
     if (index >= kMaxNodes) return nullptr;
-    return nodes_ + index;
+    return GetNode(NodePoint((u16)(index % 1024), (u16)(index / 1024)));
   }
 
-  inline u32 GetNodeIndex(Node* node) const { return (u32)(node - nodes_); }
+  inline u32 GetNodeIndex(Node* node) const {
+    NodePoint point = GetPoint(node);
+    return (u32)point.y * 1024 + point.x;
+  }
 
-  inline void SetDoorSolidMethod(DoorSolidMethod door_method) { door_method_ = door_method; }
-  inline DoorSolidMethod GetDoorSolidMethod() const { return door_method_; }
+  // Storage indexes only cover the allocated blocks, so searches use them to keep their buffers small. They change when
+  // the blocks are allocated again.
+  inline u32 GetStorageIndex(const Node* node) const { return (u32)(node - nodes_.get()); }
+  inline Node* GetNodeFromStorageIndex(u32 index) {
+    if (index >= node_count_) return nullptr;
+    return nodes_.get() + index;
+  }
+  inline size_t GetNodeCount() const { return node_count_; }
 
-  inline void SetBrickNode(s32 x, s32 y, bool exists) {
-    Node* node = GetNode(NodePoint(x, y));
-    if (!node) return;
+  // Returns the door and brick state that searches should use. The state is replaced instead of changed, so a search
+  // can keep the pointer while the game thread publishes a new one.
+  inline std::shared_ptr<const DynamicState> GetDynamicState() const { return dynamic_state_.load(); }
+  // These publish a copy of the current state with the change. They must only be called from the game thread.
+  void SetDoorOverlay(std::shared_ptr<const DoorOverlay> overlay);
+  void SetDoorSolidMethod(DoorSolidMethod door_method);
+  void SetBricks(std::shared_ptr<const BrickSet> bricks);
+  inline DoorSolidMethod GetDoorSolidMethod() const { return GetDynamicState()->door_method; }
 
-    if (exists) {
-      node->flags |= NodeFlag_Brick;
-    } else {
-      node->flags &= ~NodeFlag_Brick;
-    }
-  }
+  // Indexes the dynamic points so the door overlays can be looked up by point.
+  // This must happen after the graph is built and before any door overlay is built.
+  void IndexDynamicPoints();
 
-  // Goes through each dynamic point and marks the node as dirty.
-  // This should happen on door updates.
-  inline void MarkDynamicNodes() {
-    for (NodePoint point : dynamic_points) {
-      Node* node = GetNode(point);
-      node->flags |= NodeFlag_DynamicEmpty | NodeFlag_Traversable;
-    }
-  }
+  inline bool IsDynamicPoint(u16 x, u16 y) const { return dynamic_indexes_.Get(x, y) >= 0; }
+
+  // Calculates the state of every dynamic point with the doors of the map. The map should have its bricks removed since
+  // they are checked separately. This only reads the graph, so it can run on another thread while searches use it.
+  void BuildDoorOverlay(const Map& map, float ship_radius, DoorOverlay* overlay);
+
+  // Returns the number of bytes used by the graph storage.
+  size_t GetMemoryUsage() const;
+  inline size_t GetAllocatedBlockCount() const { return node_count_ / kNodeBlockTiles - 1; }
 
   // This is a list of empty spaces where nearby doors could block us.
   std::vector<NodePoint> dynamic_points;
 
  private:
-  EdgeSet edges_[kMaxNodes];
-  Node nodes_[kMaxNodes];
-  const Map& map_;
+  static inline size_t GetBlockIndex(u16 x, u16 y) {
+    return (y / kNodeBlockSize) * kNodeBlocksPerRow + (x / kNodeBlockSize);
+  }
+
+  static inline size_t GetStorageIndex(size_t slot, u16 x, u16 y) {
+    return slot * kNodeBlockTiles + (y % kNodeBlockSize) * kNodeBlockSize + (x % kNodeBlockSize);
+  }
+
+  // Calculates if the point can be occupied with the map's doors and the edges it has. The callback decides if a neighbor
+  // can be entered.
+  template <typename Traversable>
+  bool CalculateDynamicState(const Map& map, NodePoint point, float ship_radius, u16 frequency, EdgeSet* edges,
+                             Traversable&& is_traversable);
+
+  // The storage slot of each block of tiles. Slot 0 is the shared solid block.
+  u16 block_slots_[kNodeBlockCount];
+  // The block of tiles that each slot stores, so points can be calculated from nodes.
+  std::vector<u16> block_indexes_;
+  // The nodes and edges of each allocated block are stored contiguously by slot.
+  std::unique_ptr<EdgeSet[]> edges_;
+  std::unique_ptr<Node[]> nodes_;
+  size_t node_count_ = 0;
+  // The position of each dynamic point in the dynamic points list, or -1 for other tiles.
+  SparseTileGrid<s32> dynamic_indexes_{-1};
+  OccupiedRectIndex occupied_rects_;
+  std::atomic<std::shared_ptr<const DynamicState>> dynamic_state_;
   Game& game_;
-  DoorSolidMethod door_method_ = DoorSolidMethod::Dynamic;
 };
 
 }  // namespace path
@@ -0,0 +1,230 @@
+#include "OccupiedRectIndex.h"
+
+#include <algorithm>
+#include <bit>
+#include <unordered_map>
+
+namespace zero {
+namespace path {
+
+enum : u8 { kRectSolid, kRectOpen, kRectDynamic, kRectDoor };
+
+void OccupiedRectIndex::Build(const Map& map, float radius) {
+  Clear();
+
+  u16 d = (u16)(radius * 2.0f);
+
+  // Ships smaller than a tile only test their own tile, and larger ships have too many corners for the masks.
+  if (!map.tiles || !map.occupancy_table || d < 1 || d > kMaxDiameter) return;
+
+  diameter_ = d;
+
+  s32 span = d * 2;
+
+  // Corners before the tile start their rect at the corner and corners after it end their rect at the corner.
+  for (s32 i = 0; i < span; ++i) {
+    s32 corner = i < d ? i - d : i - d + 1;
+
+    rect_offsets_[i] = (s8)(corner < 0 ? corner : corner - d);
+  }
+
+  // The type of the rect that starts at each tile. Rects that would leave the map are solid.
+  s32 last_start = 1023 - d;
+  std::vector<u8> rect_types((size_t)1024 * 1024, kRectSolid);
+
+  for (s32 y = 0; y <= last_start; ++y) {
+    for (s32 x = 0; x <= last_start; ++x) {
+      u32 sum = map.GetOccupancySum(x, y, x + d, y + d);
+
+      if (sum & 0xFFFF) continue;
+
+      u8 type = kRectOpen;
+
+      if (sum >> 16) {
+        type = kRectDynamic;
+
+        for (s32 tile_y = y; tile_y <= y + d && type != kRectDoor; ++tile_y) {
+          for (s32 tile_x = x; tile_x <= x + d; ++tile_x) {
+            if (map.IsDoor((u16)tile_x, (u16)tile_y)) {
+              type = kRectDoor;
+              break;
+            }
+          }
+        }
+      }
+
+      rect_types[(size_t)y * 1024 + x] = type;
+    }
+  }
+
+  struct EntryHash {
+    size_t operator()(const Entry& entry) const {
+      return std::hash<u64>()(entry.open_mask ^ (entry.dynamic_mask * 31) ^ (entry.door_mask * 131));
+    }
+  };
+
+  std::unordered_map<Entry, u32, EntryHash> entry_indexes;
+
+  tile_entries_.resize((size_t)1024 * 1024);
+
+  // The first entry has no rects, which is what solid tiles get.
+  entries_.emplace_back();
+  entry_indexes[Entry()] = 0;
+
+  Entry previous;
+  u32 previous_index = 0;
+
+  for (s32 y = 0; y < 1024; ++y) {
+    for (s32 x = 0; x < 1024; ++x) {
+      Entry entry;
+
+      for (s32 row = 0; row < span; ++row) {
+        s32 top = y + rect_offsets_[row];
+
+        if (top < 0 || top > last_start) continue;
+
+        const u8* types = rect_types.data() + (size_t)top * 1024;
+
+        for (s32 column = 0; column < span; ++column) {
+          s32 left = x + rect_offsets_[column];
+
+          if (left < 0 || left > last_start) continue;
+
+          u64 bit = 1ULL << (row * span + column);
+
+          switch (types[left]) {
+            case kRectOpen: {
+              entry.open_mask |= bit;
+            } break;
+            case kRectDoor: {
+              entry.door_mask |= bit;
+              entry.dynamic_mask |= bit;
+            } break;
+            case kRectDynamic: {
+              entry.dynamic_mask |= bit;
+            } break;
+            default: {
+            } break;
+          }
+        }
+      }
+
+      // Neighboring tiles usually have the same entry, so the lookup can be skipped.
+      if (!(entry == previous)) {
+        auto iter = entry_indexes.find(entry);
+
+        if (iter == entry_indexes.end()) {
+          iter = entry_indexes.emplace(entry, (u32)entries_.size()).first;
+          entries_.push_back(entry);
+        }
+
+        previous = entry;
+        previous_index = iter->second;
+      }
+
+      tile_entries_[(size_t)y * 1024 + x] = previous_index;
+    }
+  }
+
+  entries_.shrink_to_fit();
+}
+
+void OccupiedRectIndex::Clear() {
+  diameter_ = 0;
+  tile_entries_.clear();
+  tile_entries_.shrink_to_fit();
+  entries_.clear();
+}
+
+size_t OccupiedRectIndex::GetRects(const Map& map, Vector2f position, float radius, u32 frequency,
+                                   OccupiedRect* rects, bool dynamic_doors) const {
+  u16 d = (u16)(radius * 2.0f);
+  u16 start_x = (u16)position.x;
+  u16 start_y = (u16)position.y;
+
+  // Bricks are only tracked in the solid bitmaps, so maps without them are tested directly.
+  if (!IsBuilt() || d != diameter_ || !map.solid_bits || start_x > 1023 || start_y > 1023) {
+    return map.GetAllOccupiedRects(position, radius, frequency, rects, dynamic_doors);
+  }
+
+  bool solid = dynamic_doors ? map.IsSolid(start_x, start_y, frequency)
+                             : map.IsSolidEmptyDoors(start_x, start_y, frequency);
+
+  if (solid) {
+    if (rects) {
+      rects->start_x = start_x;
+      rects->start_y = start_y;
+      rects->end_x = start_x;
+      rects->end_y = start_y;
+
+      rects->contains_door = map.IsDoor(start_x, start_y);
+    }
+
+    return 0;
+  }
+
+  const Entry& entry = entries_[tile_entries_[(size_t)start_y * 1024 + start_x]];
+  u64 check_mask = entry.dynamic_mask;
+
+  if (map.brick_tile_count > 0 && HasBrick(map, start_x, start_y)) {
+    check_mask |= entry.open_mask;
+  }
+
+  s32 span = d * 2;
+  size_t count = 0;
+
+  for (u64 mask = entry.open_mask | entry.dynamic_mask; mask; mask &= mask - 1) {
+    s32 index = std::countr_zero(mask);
+    u64 bit = 1ULL << index;
+    s32 left = start_x + rect_offsets_[index % span];
+    s32 top = start_y + rect_offsets_[index / span];
+
+    if (check_mask & bit) {
+      if (dynamic_doors) {
+        solid = map.IsRectSolid(left, top, left + d, top + d, frequency);
+      } else {
+        solid = map.IsRectSolidEmptyDoors(left, top, left + d, top + d, frequency);
+      }
+
+      if (solid) continue;
+    }
+
+    if (rects) {
+      OccupiedRect* rect = rects + count;
+
+      rect->start_x = left;
+      rect->start_y = top;
+      rect->end_x = left + d;
+      rect->end_y = top + d;
+      rect->contains_door = (entry.door_mask & bit) != 0;
+    }
+
+    ++count;
+  }
+
+  return count;
+}
+
+size_t OccupiedRectIndex::GetMemoryUsage() const {
+  return sizeof(*this) + tile_entries_.capacity() * sizeof(u32) + entries_.capacity() * sizeof(Entry);
+}
+
+bool OccupiedRectIndex::HasBrick(const Map& map, u16 x, u16 y) const {
+  s32 left = std::max((s32)x - diameter_, 0);
+  s32 top = std::max((s32)y - diameter_, 0);
+  s32 right = std::min((s32)x + diameter_, 1023);
+  s32 bottom = std::min((s32)y + diameter_, 1023);
+
+  for (s32 row = top; row <= bottom; ++row) {
+    const u64* words = map.brick_bits + (size_t)row * kSolidWordsPerRow;
+
+    for (s32 column = left; column <= right; ++column) {
+      if (words[column >> 6] & (1ULL << (column & 63))) return true;
+    }
+  }
+
+  return false;
+}
+
+}  // namespace path
+}  // namespace zero
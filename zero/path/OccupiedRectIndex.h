@@ -0,0 +1,58 @@
+#pragma once
+
+#include <zero/Math.h>
+#include <zero/Types.h>
+#include <zero/game/Map.h>
+
+#include <vector>
+
+namespace zero {
+namespace path {
+
+// Stores the rects that a ship of one radius can occupy around every tile, so the graph build and dynamic node updates
+// don't have to test every candidate rect.
+// Map::GetAllOccupiedRects tests one rect for each corner around the tile that isn't in a cardinal direction. Each tile
+// stores a mask with a bit for each of those corners, in the order they are tested, with the rects that are always
+// empty and the rects that contain doors or wormholes. The masks are shared between tiles since most of them repeat.
+// Rects with doors, wormholes or bricks are tested against the map on lookup, so the index works with any door state.
+class OccupiedRectIndex {
+ public:
+  // The corners for this diameter fill a 64 bit mask. Larger ships use the map directly.
+  static constexpr u16 kMaxDiameter = 4;
+
+  void Build(const Map& map, float radius);
+  void Clear();
+
+  // Returns the same rects as Map::GetAllOccupiedRects. Radiuses that the index wasn't built for are passed to the map.
+  size_t GetRects(const Map& map, Vector2f position, float radius, u32 frequency, OccupiedRect* rects,
+                  bool dynamic_doors = false) const;
+
+  inline bool IsBuilt() const { return !tile_entries_.empty(); }
+
+  size_t GetMemoryUsage() const;
+
+ private:
+  struct Entry {
+    // The rects that don't have any solid tiles that stay solid.
+    u64 open_mask = 0;
+    // The rects that need to be tested because they have doors or wormholes.
+    u64 dynamic_mask = 0;
+    u64 door_mask = 0;
+
+    bool operator==(const Entry& other) const {
+      return open_mask == other.open_mask && dynamic_mask == other.dynamic_mask && door_mask == other.door_mask;
+    }
+  };
+
+  bool HasBrick(const Map& map, u16 x, u16 y) const;
+
+  u16 diameter_ = 0;
+  // The offset from the tile to the start of the rect for each row and column of corners.
+  s8 rect_offsets_[kMaxDiameter * 2] = {};
+
+  std::vector<u32> tile_entries_;
+  std::vector<Entry> entries_;
+};
+
+}  // namespace path
+}  // namespace zero
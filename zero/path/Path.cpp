@@ -0,0 +1,46 @@
+#include "Path.h"
+
+#include <zero/game/Map.h>
+
+namespace zero {
+namespace path {
+
+void SmoothPath(const Map& map, Path& path, float radius, u16 frequency) {
+  path.corners.clear();
+  path.corner_distances.clear();
+
+  if (path.points.empty()) return;
+
+  const std::vector<Vector2f>& points = path.points;
+  size_t end = path.partial ? std::min(path.refined_count, points.size()) : points.size();
+
+  if (end == 0) end = 1;
+
+  size_t anchor = 0;
+
+  path.corners.push_back(0);
+
+  // Keep extending the line from the last corner until the next point can't be reached from it.
+  for (size_t i = 1; i + 1 < end; ++i) {
+    if (map.CastShip(points[anchor], radius, points[i + 1], frequency).hit) {
+      path.corners.push_back(i);
+      anchor = i;
+    }
+  }
+
+  for (size_t i = std::max(end - 1, (size_t)1); i < points.size(); ++i) {
+    path.corners.push_back(i);
+  }
+
+  path.corner_distances.resize(path.corners.size());
+  path.corner_distances.back() = 0.0f;
+
+  for (size_t i = path.corners.size() - 1; i-- > 0;) {
+    float segment = points[path.corners[i]].Distance(points[path.corners[i + 1]]);
+
+    path.corner_distances[i] = path.corner_distances[i + 1] + segment;
+  }
+}
+
+}  // namespace path
+}  // namespace zero
@@ -2,22 +2,79 @@
 
 #include <zero/Math.h>
 
+#include <algorithm>
 #include <vector>
 
 namespace zero {
+
+struct Map;
+
 namespace path {
 
 struct Path {
   size_t index = 0;
   std::vector<Vector2f> points;
   bool dynamic = false;
+  // The path goes through doors that were predicted to be open when the ship reaches them. It stays valid as doors
+  // update because the prediction already accounts for them.
+  bool scheduled = false;
+  // The highest threat along the path when it was found. Following it only needs to be replanned once the threat ahead
+  // rises well above this.
+  float threat = 0.0f;
+  // A partial path only has the first refined_count points as tiles. The rest are coarse waypoints.
+  bool partial = false;
+  size_t refined_count = 0;
+
+  // The indexes of the points where the path turns after it's smoothed. Each corner can be reached in a straight line
+  // from the previous one, so the path can be followed by steering between them instead of checking every point.
+  std::vector<size_t> corners;
+  // The length of the smoothed path from each corner to the goal.
+  std::vector<float> corner_distances;
 
   inline void Clear() {
     points.clear();
     index = 0;
     dynamic = false;
+    scheduled = false;
+    threat = 0.0f;
+    partial = false;
+    refined_count = 0;
+    corners.clear();
+    corner_distances.clear();
+  }
+
+  inline bool HasCorners() const { return !corners.empty(); }
+
+  // Returns the position in the corner list of the first corner after the current point.
+  // This is the size of the corner list if there are no more corners.
+  inline size_t GetNextCornerSlot() const {
+    return std::upper_bound(corners.begin(), corners.end(), index) - corners.begin();
   }
 
+  // Moves to the next corner and returns it.
+  inline Vector2f AdvanceCorner() {
+    size_t slot = GetNextCornerSlot();
+
+    if (slot < corners.size()) {
+      index = corners[slot];
+    }
+
+    return GetCurrent();
+  }
+
+  // Moves back to the corner before the current point. Returns false if there isn't one.
+  inline bool RetreatCorner() {
+    auto iter = std::lower_bound(corners.begin(), corners.end(), index);
+
+    if (iter == corners.begin()) return false;
+
+    index = *(iter - 1);
+    return true;
+  }
+
+  // Partial paths should be rebuilt before following the coarse waypoints.
+  inline bool NeedsRefinement() const { return partial && index + 2 >= refined_count; }
+
   inline Vector2f Advance() {
     if (Empty()) return Vector2f();
 
@@ -73,6 +130,16 @@ struct Path {
     if (points.empty()) return 0.0f;
     if (index >= points.size() - 1) return 0.0f;
 
+    if (HasCorners()) {
+      auto iter = std::lower_bound(corners.begin(), corners.end(), index);
+
+      if (iter != corners.end()) {
+        size_t slot = iter - corners.begin();
+
+        return points[index].Distance(points[*iter]) + corner_distances[slot];
+      }
+    }
+
     float dist = 0.0f;
 
     for (size_t i = index; i < points.size() - 1; ++i) {
@@ -99,5 +166,10 @@ struct Path {
   }
 };
 
+// Finds the corners of the path by skipping every point that can be reached in a straight line by a ship of this
+// radius. The points are kept so tile checks like Contains still work. Only the refined points of a partial path are
+// smoothed and its coarse waypoints are all kept as corners.
+void SmoothPath(const Map& map, Path& path, float radius, u16 frequency);
+
 }  // namespace path
 }  // namespace zero
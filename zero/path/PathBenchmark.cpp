@@ -0,0 +1,457 @@
+#include "PathBenchmark.h"
+
+#include <math.h>
+#include <zero/game/Clock.h>
+#include <zero/game/Logger.h>
+#include <zero/game/Random.h>
+
+#include <algorithm>
+#include <thread>
+
+namespace zero {
+namespace path {
+
+// Paths are allowed to differ from the AStar cost by this percentage before being reported as a mismatch.
+constexpr float kCostTolerance = 0.01f;
+// How many random tiles to try for each benchmark path before giving up on finding a connected pair.
+constexpr size_t kMaxPairAttempts = 64;
+
+struct QueueBenchmarkNode {
+  float cost;
+  u32 heap_index;
+  bool open;
+  bool reached;
+};
+
+struct QueueBenchmarkCompare {
+  bool operator()(const QueueBenchmarkNode* lhs, const QueueBenchmarkNode* rhs) const { return lhs->cost > rhs->cost; }
+};
+
+struct QueueBenchmarkHeapIndex {
+  u32& operator()(QueueBenchmarkNode* node) const { return node->heap_index; }
+};
+
+struct BenchmarkPair {
+  Vector2f start;
+  Vector2f goal;
+  float cost;
+};
+
+static Vector2f GetRandomTraversable(NodeProcessor& processor, VieRNG& rng) {
+  for (size_t i = 0; i < kMaxPairAttempts; ++i) {
+    u16 x = (u16)(rng.GetNext() % 1024);
+    u16 y = (u16)(rng.GetNext() % 1024);
+
+    const Node* node = processor.PeekNode(x, y);
+
+    if (node && (node->flags & NodeFlag_Traversable)) {
+      return Vector2f(x + 0.5f, y + 0.5f);
+    }
+  }
+
+  return Vector2f(512.5f, 512.5f);
+}
+
+// Searches every tile reachable from the start with the same relaxation rules as Pathfinder::FindPath.
+// Nodes that are lowered after leaving the queue are pushed again, so a queue that breaks the heap order ends up
+// expanding more nodes or finishing with worse costs.
+template <typename Queue>
+static size_t RunQueueSearch(NodeProcessor& processor, std::vector<QueueBenchmarkNode>& nodes, NodePoint start,
+                             QueueBenchmarkType type) {
+  constexpr bool kHasDecreaseKey = requires(Queue queue, QueueBenchmarkNode* node) { queue.Decrease(node); };
+
+  Queue queue;
+  size_t expanded = 0;
+
+  for (QueueBenchmarkNode& node : nodes) {
+    node = {0.0f, 0xFFFFFFFF, false, false};
+  }
+
+  QueueBenchmarkNode* start_node = &nodes[(size_t)start.y * 1024 + start.x];
+
+  start_node->open = true;
+  start_node->reached = true;
+  queue.Push(start_node);
+
+  while (!queue.Empty()) {
+    QueueBenchmarkNode* node = queue.Pop();
+    size_t index = node - nodes.data();
+    NodePoint point((u16)(index % 1024), (u16)(index / 1024));
+    const Node* tile = processor.PeekNode(point.x, point.y);
+    EdgeSet edges = processor.GetEdgeSet(point.x, point.y);
+    bool lowered = false;
+
+    node->open = false;
+    ++expanded;
+
+    for (size_t i = 0; i < 4; ++i) {
+      if (!edges.IsSet(i)) continue;
+
+      CoordOffset offset = CoordOffset::FromIndex(i);
+      NodePoint edge_point(point.x + offset.x, point.y + offset.y);
+      const Node* edge_tile = processor.PeekNode(edge_point.x, edge_point.y);
+
+      if (!edge_tile || !(edge_tile->flags & NodeFlag_Traversable)) continue;
+
+      QueueBenchmarkNode* edge = &nodes[(size_t)edge_point.y * 1024 + edge_point.x];
+      float cost = node->cost + GetEdgeCost(tile, edge_tile);
+
+      if (edge->reached && cost >= edge->cost) continue;
+
+      edge->cost = cost;
+      edge->reached = true;
+
+      if (!edge->open) {
+        edge->open = true;
+        queue.Push(edge);
+      } else if constexpr (kHasDecreaseKey) {
+        queue.Decrease(edge);
+      } else {
+        lowered = true;
+      }
+    }
+
+    if constexpr (!kHasDecreaseKey) {
+      if (lowered && type == QueueBenchmarkType::HeapRebuild) {
+        queue.Update();
+      }
+    }
+  }
+
+  return expanded;
+}
+
+std::vector<QueueBenchmarkResult> RunQueueBenchmark(NodeProcessor& processor, size_t search_count, u32 seed) {
+  using HeapQueue = PriorityQueue<QueueBenchmarkNode*, QueueBenchmarkCompare>;
+  using IndexedQueue = IndexedPriorityQueue<QueueBenchmarkNode*, QueueBenchmarkCompare, QueueBenchmarkHeapIndex>;
+
+  std::vector<QueueBenchmarkResult> results((size_t)QueueBenchmarkType::Count);
+  std::vector<QueueBenchmarkNode> nodes((size_t)1024 * 1024);
+  std::vector<QueueBenchmarkNode> baseline((size_t)1024 * 1024);
+
+  VieRNG rng;
+  rng.Seed(seed);
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    results[i].type = (QueueBenchmarkType)i;
+  }
+
+  for (size_t i = 0; i < search_count; ++i) {
+    Vector2f position = GetRandomTraversable(processor, rng);
+    NodePoint start((u16)position.x, (u16)position.y);
+
+    // Run the indexed queue first so the other queues can be compared against its costs.
+    for (size_t j = (size_t)QueueBenchmarkType::Count; j-- > 0;) {
+      QueueBenchmarkType type = (QueueBenchmarkType)j;
+      QueueBenchmarkResult& result = results[j];
+
+      u64 start_time = GetMicrosecondTick();
+
+      if (type == QueueBenchmarkType::Indexed) {
+        result.nodes_expanded += RunQueueSearch<IndexedQueue>(processor, nodes, start, type);
+      } else {
+        result.nodes_expanded += RunQueueSearch<HeapQueue>(processor, nodes, start, type);
+      }
+
+      result.microseconds += GetMicrosecondTick() - start_time;
+      ++result.search_count;
+
+      if (type == QueueBenchmarkType::Indexed) {
+        baseline.swap(nodes);
+        continue;
+      }
+
+      for (size_t k = 0; k < nodes.size(); ++k) {
+        if (nodes[k].reached && fabsf(nodes[k].cost - baseline[k].cost) > 0.001f) {
+          ++result.cost_mismatches;
+        }
+      }
+    }
+  }
+
+  for (QueueBenchmarkResult& result : results) {
+    Log(LogLevel::Info, "Queue benchmark %s: %zu searches, %zu expanded, %llu us, %zu cost mismatches",
+        to_string(result.type), result.search_count, result.nodes_expanded, (unsigned long long)result.microseconds,
+        result.cost_mismatches);
+  }
+
+  return results;
+}
+
+std::vector<PathBenchmarkResult> RunPathBenchmark(Pathfinder& pathfinder, const Map& map, float radius,
+                                                  size_t path_count, u32 seed) {
+  std::vector<PathBenchmarkResult> results;
+  std::vector<BenchmarkPair> pairs;
+
+  VieRNG rng;
+  rng.Seed(seed);
+
+  // Disable the path cache so every search is measured.
+  size_t cache_size = pathfinder.GetPathCacheSize();
+  pathfinder.SetPathCacheSize(0);
+
+  // Find pairs that have a path between them so each mode is only measured against searches that complete.
+  for (size_t i = 0; i < path_count * kMaxPairAttempts && pairs.size() < path_count; ++i) {
+    Vector2f start = GetRandomTraversable(pathfinder.GetProcessor(), rng);
+    Vector2f goal = GetRandomTraversable(pathfinder.GetProcessor(), rng);
+
+    Path path = pathfinder.FindPath(map, start, goal, radius, 0xFFFF, Pathfinder::SearchMode::AStar);
+    float cost = pathfinder.GetLastSearchStats().cost;
+
+    if (path.Empty() || cost <= 0.0f) continue;
+
+    pairs.push_back({start, goal, cost});
+  }
+
+  for (size_t i = 0; i < (size_t)Pathfinder::SearchMode::Count; ++i) {
+    PathBenchmarkResult result;
+
+    result.mode = (Pathfinder::SearchMode)i;
+
+    for (BenchmarkPair& pair : pairs) {
+      u64 start_time = GetMicrosecondTick();
+      pathfinder.FindPath(map, pair.start, pair.goal, radius, 0xFFFF, result.mode);
+      u64 end_time = GetMicrosecondTick();
+
+      const Pathfinder::SearchStats& stats = pathfinder.GetLastSearchStats();
+
+      ++result.path_count;
+      result.nodes_expanded += stats.nodes_expanded;
+      result.nodes_touched += stats.nodes_touched;
+      result.microseconds += end_time - start_time;
+      result.total_cost += stats.cost;
+
+      if (fabsf(stats.cost - pair.cost) > pair.cost * kCostTolerance) {
+        ++result.cost_mismatches;
+      }
+    }
+
+    Log(LogLevel::Info, "Path benchmark %s: %zu paths, %zu expanded, %zu touched, %llu us, %zu cost mismatches",
+        to_string(result.mode), result.path_count, result.nodes_expanded, result.nodes_touched,
+        (unsigned long long)result.microseconds, result.cost_mismatches);
+
+    results.push_back(result);
+  }
+
+  pathfinder.SetPathCacheSize(cache_size);
+
+  return results;
+}
+
+std::vector<RegionBenchmarkResult> RunRegionBenchmark(const Map& map, float radius) {
+  std::vector<RegionBenchmarkResult> results;
+  RegionRegistry baseline;
+
+  RegionBenchmarkResult flood_result;
+
+  u64 start_time = GetMicrosecondTick();
+  baseline.CreateAllFloodFill(map, radius);
+  flood_result.microseconds = GetMicrosecondTick() - start_time;
+  flood_result.region_count = baseline.GetRegionCount();
+
+  results.push_back(flood_result);
+
+  size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  for (size_t thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+    RegionRegistry registry;
+    RegionBenchmarkResult result;
+
+    result.thread_count = thread_count;
+
+    start_time = GetMicrosecondTick();
+    registry.CreateAll(map, radius, thread_count);
+    result.microseconds = GetMicrosecondTick() - start_time;
+    result.region_count = registry.GetRegionCount();
+
+    for (u16 y = 0; y < 1024; ++y) {
+      for (u16 x = 0; x < 1024; ++x) {
+        if (registry.GetRegionIndex(MapCoord(x, y)) != baseline.GetRegionIndex(MapCoord(x, y))) {
+          ++result.label_mismatches;
+        }
+      }
+    }
+
+    results.push_back(result);
+  }
+
+  for (RegionBenchmarkResult& result : results) {
+    Log(LogLevel::Info, "Region benchmark %zu threads: %u regions, %llu us, %zu label mismatches", result.thread_count,
+        result.region_count, (unsigned long long)result.microseconds, result.label_mismatches);
+  }
+
+  return results;
+}
+
+// These are the tile by tile versions of the occupancy predicates from before the occupancy table.
+// The map should have no solid data attached so each tile is decoded from its id.
+static bool ReferenceCanOverlapTile(const Map& map, const Vector2f& position, float radius, u32 frequency) {
+  u16 d = (u16)(radius * 2.0f);
+  u16 start_x = (u16)position.x;
+  u16 start_y = (u16)position.y;
+
+  u16 far_left = start_x - d;
+  u16 far_right = start_x + d;
+  u16 far_top = start_y - d;
+  u16 far_bottom = start_y + d;
+
+  if (far_left > 1023) far_left = 0;
+  if (far_right > 1023) far_right = 1023;
+  if (far_top > 1023) far_top = 0;
+  if (far_bottom > 1023) far_bottom = 1023;
+
+  bool solid = map.IsSolidEmptyDoors(start_x, start_y, frequency);
+  if (d < 1 || solid) return !solid;
+
+  for (u16 check_y = far_top; check_y <= far_bottom; ++check_y) {
+    s16 dir_y = (start_y - check_y) > 0 ? 1 : (start_y == check_y ? 0 : -1);
+
+    if (dir_y == 0) continue;
+
+    for (u16 check_x = far_left; check_x <= far_right; ++check_x) {
+      s16 dir_x = (start_x - check_x) > 0 ? 1 : (start_x == check_x ? 0 : -1);
+
+      if (dir_x == 0) continue;
+
+      bool can_fit = true;
+
+      for (s16 y = check_y; std::abs(y - check_y) <= d && can_fit; y += dir_y) {
+        for (s16 x = check_x; std::abs(x - check_x) <= d; x += dir_x) {
+          if (map.IsSolidEmptyDoors(x, y, frequency)) {
+            can_fit = false;
+            break;
+          }
+        }
+      }
+
+      if (can_fit) return true;
+    }
+  }
+
+  return false;
+}
+
+static bool ReferenceCanOccupy(const Map& map, const Vector2f& position, float radius, u32 frequency) {
+  u16 position_x = (u16)position.x;
+  u16 position_y = (u16)position.y;
+
+  int radius_check = (int)(radius + 0.5f);
+
+  for (int y = -radius_check; y <= radius_check; ++y) {
+    for (int x = -radius_check; x <= radius_check; ++x) {
+      if (map.IsSolid((u16)(position_x + x), (u16)(position_y + y), frequency)) return false;
+    }
+  }
+
+  return true;
+}
+
+static bool ReferenceCanOccupyRadius(const Map& map, const Vector2f& position, float radius, u32 frequency) {
+  if (map.IsSolid(position, frequency)) return false;
+
+  radius = floorf(radius + 0.5f);
+
+  for (float y = -radius; y <= radius; ++y) {
+    for (float x = -radius; x <= radius; ++x) {
+      if (map.IsSolid((u16)(position.x + x), (u16)(position.y + y), frequency)) return false;
+    }
+  }
+
+  return true;
+}
+
+static bool ReferenceCanFit(const Map& map, const Vector2f& position, float radius, u32 frequency) {
+  for (float y_offset_check = -radius; y_offset_check < radius; ++y_offset_check) {
+    for (float x_offset_check = -radius; x_offset_check < radius; ++x_offset_check) {
+      if (map.IsSolid((u16)(position.x + x_offset_check), (u16)(position.y + y_offset_check), frequency)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+std::vector<OccupancyBenchmarkResult> RunOccupancyBenchmark(const Map& map, u32 frequency, size_t sample_count,
+                                                            u32 seed) {
+  using Predicate = bool (*)(const Map&, const Vector2f&, float, u32);
+
+  struct PredicatePair {
+    Predicate reference;
+    Predicate predicate;
+  };
+
+  const PredicatePair kPredicates[] = {
+      {ReferenceCanOverlapTile,
+       [](const Map& map, const Vector2f& p, float r, u32 f) { return map.CanOverlapTile(p, r, f); }},
+      {ReferenceCanOccupy, [](const Map& map, const Vector2f& p, float r, u32 f) { return map.CanOccupy(p, r, f); }},
+      {ReferenceCanOccupyRadius,
+       [](const Map& map, const Vector2f& p, float r, u32 f) { return map.CanOccupyRadius(p, r, f); }},
+      {ReferenceCanFit, [](const Map& map, const Vector2f& p, float r, u32 f) { return map.CanFit(p, r, f); }},
+  };
+
+  static_assert(ZERO_ARRAY_SIZE(kPredicates) == (size_t)OccupancyPredicate::Count);
+
+  std::vector<OccupancyBenchmarkResult> results;
+
+  if (!map.tiles) return results;
+
+  // The reference map decodes every tile from its id.
+  Map reference = map;
+
+  reference.solid_bits = nullptr;
+  reference.occupancy_table = nullptr;
+
+  VieRNG rng;
+  rng.Seed(seed);
+
+  std::vector<Vector2f> positions(sample_count);
+  std::vector<float> radii(sample_count);
+
+  for (size_t i = 0; i < sample_count; ++i) {
+    float x = (rng.GetNext() % 1024) + (rng.GetNext() % 16) / 16.0f;
+    float y = (rng.GetNext() % 1024) + (rng.GetNext() % 16) / 16.0f;
+
+    positions[i] = Vector2f(x, y);
+    // Ship radii are multiples of a sixteenth of a tile.
+    radii[i] = (rng.GetNext() % 64) / 16.0f;
+  }
+
+  std::vector<u8> reference_results(sample_count);
+
+  for (size_t i = 0; i < (size_t)OccupancyPredicate::Count; ++i) {
+    OccupancyBenchmarkResult result;
+
+    result.predicate = (OccupancyPredicate)i;
+    result.sample_count = sample_count;
+
+    u64 start_time = GetMicrosecondTick();
+
+    for (size_t j = 0; j < sample_count; ++j) {
+      reference_results[j] = kPredicates[i].reference(reference, positions[j], radii[j], frequency);
+    }
+
+    result.reference_microseconds = GetMicrosecondTick() - start_time;
+
+    start_time = GetMicrosecondTick();
+
+    for (size_t j = 0; j < sample_count; ++j) {
+      if (kPredicates[i].predicate(map, positions[j], radii[j], frequency) != (bool)reference_results[j]) {
+        ++result.mismatches;
+      }
+    }
+
+    result.microseconds = GetMicrosecondTick() - start_time;
+
+    Log(LogLevel::Info, "Occupancy benchmark %s: %llu us, reference %llu us, %zu mismatches",
+        to_string(result.predicate), (unsigned long long)result.microseconds,
+        (unsigned long long)result.reference_microseconds, result.mismatches);
+
+    results.push_back(result);
+  }
+
+  return results;
+}
+
+}  // namespace path
+}  // namespace zero
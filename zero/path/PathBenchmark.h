@@ -0,0 +1,105 @@
+#pragma once
+
+#include <zero/path/Pathfinder.h>
+
+#include <vector>
+
+namespace zero {
+namespace path {
+
+struct PathBenchmarkResult {
+  Pathfinder::SearchMode mode = Pathfinder::SearchMode::AStar;
+
+  size_t path_count = 0;
+  size_t nodes_expanded = 0;
+  size_t nodes_touched = 0;
+  u64 microseconds = 0;
+
+  float total_cost = 0.0f;
+  // How many paths had a cost that differed from the AStar path by more than the tolerance.
+  size_t cost_mismatches = 0;
+};
+
+enum class QueueBenchmarkType {
+  // The push_heap queue where lowered nodes are updated in place without restoring the heap order.
+  Heap,
+  // The push_heap queue with the heap rebuilt with make_heap after any node is lowered.
+  HeapRebuild,
+  // The indexed queue that moves lowered nodes with decrease-key.
+  Indexed,
+
+  Count
+};
+
+struct QueueBenchmarkResult {
+  QueueBenchmarkType type = QueueBenchmarkType::Heap;
+
+  size_t search_count = 0;
+  size_t nodes_expanded = 0;
+  u64 microseconds = 0;
+  // How many reached tiles ended with a different cost than the indexed queue.
+  size_t cost_mismatches = 0;
+};
+
+struct RegionBenchmarkResult {
+  // The flood fill that the labeling is compared against has a thread count of zero.
+  size_t thread_count = 0;
+  u64 microseconds = 0;
+  RegionIndex region_count = 0;
+  // How many tiles were given a different region than the flood fill.
+  size_t label_mismatches = 0;
+};
+
+enum class OccupancyPredicate { CanOverlapTile, CanOccupy, CanOccupyRadius, CanFit, Count };
+
+struct OccupancyBenchmarkResult {
+  OccupancyPredicate predicate = OccupancyPredicate::CanOverlapTile;
+
+  size_t sample_count = 0;
+  // The time spent in the tile by tile versions that the occupancy table replaced.
+  u64 reference_microseconds = 0;
+  u64 microseconds = 0;
+  // How many samples had a different result than the tile by tile version.
+  size_t mismatches = 0;
+};
+
+// Runs the same random set of connected start and goal tiles through each search mode.
+// The AStar search is used as the baseline that the other modes are compared against.
+std::vector<PathBenchmarkResult> RunPathBenchmark(Pathfinder& pathfinder, const Map& map, float radius,
+                                                  size_t path_count, u32 seed);
+
+// Runs full weighted searches from random tiles through each open set queue type.
+// The indexed queue is used as the baseline that the other queues are compared against.
+std::vector<QueueBenchmarkResult> RunQueueBenchmark(NodeProcessor& processor, size_t search_count, u32 seed);
+
+// Builds the regions with the flood fill and then with the parallel labeling at each power of two thread count up to
+// the hardware thread count.
+std::vector<RegionBenchmarkResult> RunRegionBenchmark(const Map& map, float radius);
+
+// Checks the occupancy predicates against the tile by tile loops they used before the occupancy table, with random
+// positions and radii. The map's current doors and bricks are used.
+std::vector<OccupancyBenchmarkResult> RunOccupancyBenchmark(const Map& map, u32 frequency, size_t sample_count,
+                                                            u32 seed);
+
+inline const char* to_string(OccupancyPredicate predicate) {
+  const char* kPredicateNames[] = {"CanOverlapTile", "CanOccupy", "CanOccupyRadius", "CanFit"};
+
+  static_assert(ZERO_ARRAY_SIZE(kPredicateNames) == (size_t)OccupancyPredicate::Count);
+
+  if ((size_t)predicate >= ZERO_ARRAY_SIZE(kPredicateNames)) return "Unknown";
+
+  return kPredicateNames[(size_t)predicate];
+}
+
+inline const char* to_string(QueueBenchmarkType type) {
+  const char* kTypeNames[] = {"Heap", "HeapRebuild", "Indexed"};
+
+  static_assert(ZERO_ARRAY_SIZE(kTypeNames) == (size_t)QueueBenchmarkType::Count);
+
+  if ((size_t)type >= ZERO_ARRAY_SIZE(kTypeNames)) return "Unknown";
+
+  return kTypeNames[(size_t)type];
+}
+
+}  // namespace path
+}  // namespace zero
@@ -1,3 +1,4 @@
+#include <zero/game/Clock.h>
 #include <zero/game/Game.h>
 #include <zero/path/NodeProcessor.h>
 #include <zero/path/Pathfinder.h>
@@ -5,14 +6,22 @@
 #include <math.h>
 #include <xmmintrin.h>
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
 #include <thread>
 
 namespace zero {
 namespace path {
 
-// The edge weight for entering a safe zone from a non-safe tile.
-// This is set here instead of stored in a node so traveling through multiple safe tiles isn't very expensive.
-constexpr float kSafetyWeight = 300.0f;
+// How many sectors of a hierarchical path are refined into tiles.
+constexpr size_t kHierarchicalRefineSegments = 3;
+// Each distance field stores a few bytes for every tile, so only a small number are kept at once.
+constexpr size_t kMaxDistanceFields = 4;
+// How many door updates a time expanded search will wait at a closed door for it to open.
+constexpr size_t kMaxDoorWaitSteps = 32;
+// How many of the predicted door updates have their overlays built before they happen.
+constexpr size_t kDoorOverlayLookahead = 8;
 
 static inline float fast_sqrt(float v) {
   __m128 v_x4 = _mm_set1_ps(v);
@@ -53,191 +62,1611 @@ static inline float Euclidean(const NodePoint& __restrict from_p, const NodePoin
   return _mm_cvtss_f32(result);
 }
 
+static inline bool IsVerticalDirection(size_t direction) {
+  return direction == CoordOffset::NorthIndex() || direction == CoordOffset::SouthIndex();
+}
+
+static inline size_t GetDirectionIndex(NodePoint from, NodePoint to) {
+  if (to.x < from.x) return CoordOffset::WestIndex();
+  if (to.x > from.x) return CoordOffset::EastIndex();
+  if (to.y < from.y) return CoordOffset::NorthIndex();
+
+  return CoordOffset::SouthIndex();
+}
+
 Pathfinder::Pathfinder(std::unique_ptr<NodeProcessor> processor, RegionRegistry& regions)
-    : processor_(std::move(processor)), regions_(regions) {}
+    : processor_(std::move(processor)), regions_(regions), door_overlays_(*processor_) {}
+
+Pathfinder::~Pathfinder() {
+  {
+    std::lock_guard<std::mutex> lock(request_mutex_);
+
+    stop_requests_ = true;
+
+    for (PathRequestHandle& request : request_queue_) {
+      request->Cancel();
+    }
+
+    request_queue_.clear();
+  }
+
+  request_convar_.notify_all();
+
+  // Running searches use the processor, so they must finish before anything is destroyed.
+  for (std::thread& thread : request_threads_) {
+    thread.join();
+  }
+}
+
+Path Pathfinder::FindPath(const Map& map, const Vector2f& from, const Vector2f& to, float radius, u16 frequency,
+                          SearchMode mode) {
+  // The state is taken after the versions, so a door change during the search can only make the path look older.
+  u32 door_version = door_version_;
+  u32 brick_version = brick_version_;
+  std::shared_ptr<const DynamicState> dynamic_state = processor_->GetDynamicState();
+
+  return FindCachedPath(map, *dynamic_state, door_version, brick_version, from, to, radius, frequency, mode);
+}
+
+Path Pathfinder::FindCachedPath(const Map& map, const DynamicState& dynamic_state, u32 door_version, u32 brick_version,
+                                const Vector2f& from, const Vector2f& to, float radius, u16 frequency,
+                                SearchMode mode) {
+  SearchStats stats;
+  std::unique_lock<std::mutex> lock(mutex_);
+  ThreatLayer threat = threat_layer_;
+
+  // Time expanded paths depend on when the search starts and threat changes every few ticks, so they aren't cached.
+  if (path_cache_size_ == 0 || mode == SearchMode::TimeExpanded || threat.IsActive()) {
+    lock.unlock();
+
+    Path path = SearchPath(map, dynamic_state, from, to, radius, frequency, mode, threat, &stats, nullptr);
+    SmoothPath(map, path, radius, frequency);
+
+    if (threat.IsActive()) {
+      path.threat = threat.grid->GetPathThreat(path, 0);
+    }
+
+    lock.lock();
+    last_stats_ = stats;
+
+    return path;
+  }
+
+  PathCacheKey key = {ToNodePoint(from), ToNodePoint(to), radius, frequency, mode};
+  auto iter = path_cache_lookup_.find(key);
+
+  if (iter != path_cache_lookup_.end()) {
+    PathCacheList::iterator entry = iter->second;
+
+    if (IsCacheEntryValid(*entry)) {
+      ++path_cache_stats_.hits;
+      last_stats_ = entry->stats;
+
+      // Move it to the front so it's the last to be evicted.
+      path_cache_.splice(path_cache_.begin(), path_cache_, entry);
+      return entry->path;
+    }
+
+    path_cache_.erase(entry);
+    path_cache_lookup_.erase(iter);
+  }
+
+  Path path;
+  std::vector<NodePoint> tiles;
+
+  if (SpliceCachedPath(map, dynamic_state, key, &path, &tiles)) {
+    SmoothPath(map, path, radius, frequency);
+
+    ++path_cache_stats_.splices;
+    last_stats_ = {};
+    InsertCachedPath(key, path, std::move(tiles), last_stats_, door_version, brick_version);
+    return path;
+  }
+
+  ++path_cache_stats_.misses;
+
+  // Release the lock while searching so other threads can use the cache.
+  lock.unlock();
+  path = SearchPath(map, dynamic_state, from, to, radius, frequency, mode, threat, &stats, &tiles);
+  SmoothPath(map, path, radius, frequency);
+  lock.lock();
+
+  last_stats_ = stats;
+
+  if (!path.Empty()) {
+    InsertCachedPath(key, path, std::move(tiles), stats, door_version, brick_version);
+  }
+
+  return path;
+}
+
+Pathfinder::PathRequestHandle Pathfinder::RequestPath(const Map& map, const Vector2f& from, const Vector2f& to,
+                                                      float radius, u16 frequency, SearchMode mode) {
+  // The request threads never read the game's map or the newest state, since the game thread changes them while the
+  // search runs. The state is taken after the versions so the path can only look older than it is.
+  u32 door_version = door_version_;
+  u32 brick_version = brick_version_;
+  std::shared_ptr<const DynamicState> dynamic_state = processor_->GetDynamicState();
+  std::shared_ptr<const MapSnapshot> snapshot = GetRequestMap(map);
+
+  std::unique_lock<std::mutex> lock(request_mutex_);
+
+  NodePoint goal = ToNodePoint(to);
+
+  // Reuse a queued request for the same goal so repeated requests don't search more than once.
+  for (PathRequestHandle& request : request_queue_) {
+    if (request->state != PathRequest::State::Pending) continue;
+
+    if (ToNodePoint(request->to) == goal && request->radius == radius && request->frequency == frequency &&
+        request->mode == mode) {
+      request->map = std::move(snapshot);
+      request->dynamic_state = std::move(dynamic_state);
+      request->door_version = door_version;
+      request->brick_version = brick_version;
+      request->from = from;
+      return request;
+    }
+  }
+
+  PathRequestHandle request = std::make_shared<PathRequest>();
+
+  request->map = std::move(snapshot);
+  request->dynamic_state = std::move(dynamic_state);
+  request->door_version = door_version;
+  request->brick_version = brick_version;
+  request->from = from;
+  request->to = to;
+  request->radius = radius;
+  request->frequency = frequency;
+  request->mode = mode;
+
+  request_queue_.push_back(request);
+
+  if (request_threads_.empty()) {
+    for (size_t i = 0; i < kRequestThreads; ++i) {
+      request_threads_.emplace_back(&Pathfinder::RunRequests, this);
+    }
+  }
+
+  lock.unlock();
+  request_convar_.notify_one();
+
+  return request;
+}
+
+std::shared_ptr<const MapSnapshot> Pathfinder::GetRequestMap(const Map& map) {
+  u32 door_version = door_version_;
+  u32 brick_version = brick_version_;
+
+  if (request_map_ && request_map_source_ == &map && request_map_checksum_ == map.checksum &&
+      request_map_door_version_ == door_version && request_map_brick_version_ == brick_version) {
+    return request_map_;
+  }
+
+  // The copy keeps the bricks so paths aren't smoothed through them.
+  request_map_ = std::make_shared<MapSnapshot>(map, MapSnapshot::Bricks::Keep);
+  request_map_source_ = &map;
+  request_map_checksum_ = map.checksum;
+  request_map_door_version_ = door_version;
+  request_map_brick_version_ = brick_version;
+
+  return request_map_;
+}
+
+void Pathfinder::SetThreatLayer(std::shared_ptr<const ThreatGrid> grid, float weight) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  threat_layer_.grid = std::move(grid);
+  threat_layer_.weight = weight;
+}
+
+void Pathfinder::CancelRequests() {
+  std::lock_guard<std::mutex> lock(request_mutex_);
+
+  for (PathRequestHandle& request : request_queue_) {
+    request->Cancel();
+    // The owner can keep the handle, so the map copy is released now.
+    request->map.reset();
+    request->dynamic_state.reset();
+  }
+
+  request_queue_.clear();
+}
+
+void Pathfinder::RunRequests() {
+  while (true) {
+    PathRequestHandle request;
+    Vector2f from;
+    std::shared_ptr<const MapSnapshot> map;
+    std::shared_ptr<const DynamicState> dynamic_state;
+    u32 door_version = 0;
+    u32 brick_version = 0;
+
+    {
+      std::unique_lock<std::mutex> lock(request_mutex_);
+
+      request_convar_.wait(lock, [this] { return stop_requests_ || !request_queue_.empty(); });
+
+      if (stop_requests_) return;
+
+      request = std::move(request_queue_.front());
+      request_queue_.pop_front();
+
+      PathRequest::State expected = PathRequest::State::Pending;
+
+      // Only pending requests are coalesced, so these are taken under the lock with the start. Owners can keep the
+      // handle after the request finishes, so it doesn't keep the map copy alive.
+      map = std::move(request->map);
+      dynamic_state = std::move(request->dynamic_state);
+
+      // The request was cancelled while it was queued.
+      if (!request->state.compare_exchange_strong(expected, PathRequest::State::Running)) continue;
+
+      from = request->from;
+      door_version = request->door_version;
+      brick_version = request->brick_version;
+    }
+
+    request->path = FindCachedPath(map->map, *dynamic_state, door_version, brick_version, from, request->to,
+                                   request->radius, request->frequency, request->mode);
+
+    // Leave the request cancelled if its owner gave up on it during the search.
+    PathRequest::State expected = PathRequest::State::Running;
+    request->state.compare_exchange_strong(expected, PathRequest::State::Complete);
+  }
+}
+
+std::vector<Path> Pathfinder::FindPaths(const Map& map, const Vector2f& from, const std::vector<Vector2f>& goals,
+                                        float radius, u16 frequency) {
+  std::vector<Path> paths(goals.size());
+
+  size_t thread_count = std::min((size_t)std::thread::hardware_concurrency(), kMaxSearchThreads);
+  thread_count = std::max(std::min(thread_count, goals.size()), (size_t)1);
+
+  std::atomic<size_t> next_goal = 0;
+
+  // Every search uses the same state so the paths can be compared with each other.
+  u32 door_version = door_version_;
+  u32 brick_version = brick_version_;
+  std::shared_ptr<const DynamicState> dynamic_state = processor_->GetDynamicState();
+  SearchMode mode = search_mode_;
+
+  auto run = [&]() {
+    for (size_t i = next_goal++; i < goals.size(); i = next_goal++) {
+      paths[i] = FindCachedPath(map, *dynamic_state, door_version, brick_version, from, goals[i], radius, frequency,
+                                mode);
+    }
+  };
+
+  std::vector<std::thread> threads;
+
+  // The calling thread runs searches too, so one fewer thread is started.
+  for (size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(run);
+  }
+
+  run();
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  return paths;
+}
+
+std::unique_ptr<SearchState> Pathfinder::AcquireSearchState() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  size_t node_count = processor_->GetNodeCount();
+
+  while (!search_states_.empty()) {
+    std::unique_ptr<SearchState> state = std::move(search_states_.back());
+    search_states_.pop_back();
+
+    // States from before the graph was rebuilt are sized for its old blocks.
+    if (state->GetNodeCount() == node_count) return state;
+  }
+
+  return std::make_unique<SearchState>(node_count);
+}
+
+void Pathfinder::ReleaseSearchState(std::unique_ptr<SearchState> state) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Each state is large, so only a few are kept around after parallel searches finish.
+  if (search_states_.size() < kMaxPooledSearchStates) {
+    search_states_.push_back(std::move(state));
+  }
+}
+
+Path Pathfinder::SearchPath(const Map& map, const DynamicState& dynamic_state, const Vector2f& from, const Vector2f& to,
+                            float radius, u16 frequency, SearchMode mode, const ThreatLayer& threat,
+                            SearchStats* stats, std::vector<NodePoint>* tiles) {
+  Path path = {};
+  std::vector<NodePoint> unused_tiles;
+
+  if (!tiles) tiles = &unused_tiles;
+
+  tiles->clear();
+
+  Node* start = GetSearchNode(dynamic_state, from);
+  Node* goal = GetSearchNode(dynamic_state, to);
+
+  *stats = {};
+
+  if (start == nullptr || goal == nullptr) {
+    return path;
+  }
+
+  NodePoint start_p = processor_->GetPoint(start);
+  NodePoint goal_p = processor_->GetPoint(goal);
+
+  if (!regions_.IsConnected(MapCoord(start_p.x, start_p.y), MapCoord(goal_p.x, goal_p.y))) {
+    return path;
+  }
+
+  // These modes reuse costs from earlier searches or skip over tiles, so they can't add the threat of each tile.
+  if (threat.IsActive() && (mode == SearchMode::JumpPoint || mode == SearchMode::Hierarchical ||
+                            mode == SearchMode::Incremental)) {
+    mode = SearchMode::AStar;
+  }
+
+  if (mode == SearchMode::Hierarchical) {
+    // The abstract graph builds its sectors lazily, so only one hierarchical search can use it at a time.
+    std::lock_guard<std::mutex> lock(abstract_mutex_);
+
+    if (!abstract_graph_ || abstract_graph_->GetRadius() != radius) {
+      abstract_graph_ = std::make_unique<AbstractGraph>(*processor_, radius);
+    }
+
+    // Sectors are cached across searches, so they are built with the newest state. It was published before the sectors
+    // that it changes were invalidated under this lock.
+    AbstractPath abstract_path =
+        abstract_graph_->FindPath(start_p, goal_p, kHierarchicalRefineSegments, processor_->GetDynamicState());
+
+    if (!abstract_path.points.empty()) {
+      *tiles = abstract_path.points;
+
+      for (NodePoint point : abstract_path.points) {
+        path.Add(map.ResolveShipCollision(Vector2f(point.x + 0.5f, point.y + 0.5f), radius, 0xFFFF));
+      }
+
+      path.dynamic = abstract_path.dynamic;
+      path.refined_count = abstract_path.refined_count;
+      path.partial = abstract_path.refined_count < abstract_path.points.size();
+
+      stats->nodes_expanded = abstract_path.nodes_expanded;
+      stats->cost = abstract_path.cost;
+
+      return path;
+    }
+
+    // The abstract graph treats bricks as solid, so it can miss paths that exist.
+    mode = SearchMode::AStar;
+  }
+
+  if (mode == SearchMode::Incremental) {
+    std::lock_guard<std::mutex> planner_lock(incremental_mutex_);
+
+    if (!incremental_planner_ || !incremental_planner_->Matches(radius, frequency)) {
+      incremental_planner_ = std::make_unique<IncrementalPlanner>(*processor_, radius, frequency);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      incremental_planner_->InvalidateTiles(incremental_changes_);
+      incremental_changes_.clear();
+      incremental_active_ = true;
+    }
+
+    // The costs are kept across searches, so they are repaired with the newest state. It's taken after the changes so
+    // a state is never used without repairing the tiles that it changed.
+    IncrementalPath incremental_path = incremental_planner_->FindPath(start_p, goal_p, processor_->GetDynamicState());
+
+    *tiles = incremental_path.points;
+
+    for (NodePoint point : incremental_path.points) {
+      path.Add(map.ResolveShipCollision(Vector2f(point.x + 0.5f, point.y + 0.5f), radius, 0xFFFF));
+    }
+
+    path.dynamic = incremental_path.dynamic;
+
+    stats->nodes_expanded = incremental_path.nodes_expanded;
+    stats->cost = incremental_path.cost;
+
+    return path;
+  }
+
+  if (mode == SearchMode::Bidirectional) {
+    bool one_way = false;
+
+    path = SearchBidirectional(map, dynamic_state, start, goal, radius, frequency, threat, stats, tiles, &one_way);
+
+    if (!one_way) return path;
+
+    // The backward search can't tell which side of a door or brick it's on, so search forward from the start instead.
+    // The stats keep the work that was thrown away so the benchmark counts it.
+    path = {};
+    stats->cost = 0.0f;
+    mode = SearchMode::AStar;
+  }
+
+  if (mode == SearchMode::TimeExpanded) {
+    path = SearchTimeExpanded(map, dynamic_state, start, goal, radius, frequency, threat, stats, tiles);
+
+    if (!path.Empty()) return path;
+
+    // Either the doors can't be predicted yet or the door check was too strict for the ship to fit through, so search
+    // with the current door state.
+    path = {};
+    mode = SearchMode::AStar;
+  }
+
+  std::unique_ptr<SearchState> state = AcquireSearchState();
+  SearchState::OpenSet& openset = state->openset;
+
+  state->Begin();
+
+  u32 start_index = processor_->GetStorageIndex(start);
+  u32 goal_index = processor_->GetStorageIndex(goal);
+
+  // Attempts to lower the cost of the edge node by reaching it from the provided node.
+  auto relax = [&](SearchNode* node, Node* edge, NodePoint edge_point, float cost) {
+    if (!CanEnterNode(dynamic_state, edge, edge_point, frequency, &path.dynamic)) return;
+
+    SearchNode* edge_state = state->GetNode(processor_->GetStorageIndex(edge));
+
+    // Compute a heuristic from this neighbor to the end goal.
+    float h = Euclidean(edge_point, goal_p);
+
+    // The path to this node is lower than it was previously, so update its values.
+    if (cost < edge_state->g || !(edge_state->flags & SearchFlag_Touched)) {
+      edge_state->g = cost;
+      edge_state->f = edge_state->g + h;
+
+      edge_state->parent_id = state->GetIndex(node);
+
+      if (!(edge_state->flags & SearchFlag_Touched)) {
+        edge_state->flags |= SearchFlag_Touched;
+        ++stats->nodes_touched;
+      }
+
+      if (!(edge_state->flags & SearchFlag_Openset)) {
+        // The node is not in the openset so add it.
+        edge_state->flags |= SearchFlag_Openset;
+        openset.Push(edge_state);
+      } else {
+        // The node is already in the openset, so move it up to match its lower cost.
+        openset.Decrease(edge_state);
+      }
+    }
+  };
+
+  openset.Push(state->GetNode(start_index));
+
+  // at the start there is only one node here, the start node
+  while (!openset.Empty()) {
+    // grab front item then delete it
+    SearchNode* node_state = openset.Pop();
+    u32 node_index = state->GetIndex(node_state);
+
+    // this is the only way to break the pathfinder
+    if (node_index == goal_index) {
+      break;
+    }
+
+    node_state->flags &= ~SearchFlag_Openset;
+    ++stats->nodes_expanded;
+
+    Node* node = processor_->GetNodeFromStorageIndex(node_index);
+    NodePoint node_point = processor_->GetPoint(node);
+
+    // Returns neighbor nodes that are not solid.
+    EdgeSet edges = processor_->FindEdges(node_point, dynamic_state);
+
+    if (edges.HasDynamic()) {
+      // If we considered any possible dynamic tiles then consider the path to be dynamic.
+      // This will cause it to be cleared and re-evaluated on door update.
+      path.dynamic = true;
+    }
+
+    if (mode == SearchMode::JumpPoint) {
+      // Prune the directions that can be reached by a path of equal cost that doesn't go through this node.
+      // Paths move horizontally before vertically, so a vertical arrival only continues forward unless a neighbor
+      // is forced by an obstacle or weighted tile.
+      bool prune =
+          node != start && node_state->parent_id != ~0 && IsUniformNode(dynamic_state, node, node_point, edges);
+      size_t arrival = 0;
+
+      if (prune) {
+        NodePoint parent_point = processor_->GetPoint(processor_->GetNodeFromStorageIndex(node_state->parent_id));
+        arrival = GetDirectionIndex(parent_point, node_point);
+      }
+
+      for (size_t i = 0; i < 4; ++i) {
+        if (!edges.IsSet(i)) continue;
+
+        if (prune) {
+          CoordOffset arrival_offset = CoordOffset::FromIndex(arrival);
+          CoordOffset offset = CoordOffset::FromIndex(i);
+
+          // Never go back toward the parent.
+          if (offset.x == -arrival_offset.x && offset.y == -arrival_offset.y) continue;
+
+          // Horizontal neighbors are only visited after a vertical move when they are forced.
+          if (IsVerticalDirection(arrival) && i != arrival &&
+              !IsForcedNeighbor(dynamic_state, node_point, arrival, i)) {
+            continue;
+          }
+        }
+
+        JumpResult jump = Jump(dynamic_state, node_point, i, goal);
+
+        if (jump.node) {
+          relax(node_state, jump.node, processor_->GetPoint(jump.node), node_state->g + jump.cost);
+        }
+      }
+
+      continue;
+    }
+
+    for (size_t i = 0; i < 8; ++i) {
+      if (!edges.IsSet(i)) continue;
+
+      CoordOffset offset = CoordOffset::FromIndex(i);
+
+      NodePoint edge_point(node_point.x + offset.x, node_point.y + offset.y);
+      Node* edge = processor_->GetNode(edge_point);
+
+      // The cost to this neighbor is the cost to the current node plus the edge weight times the distance between the
+      // nodes.
+      // Euclidean could be calculated based on edge index if all 8 are considered again.
+      relax(node_state, edge, edge_point, node_state->g + GetEdgeCost(node, edge) + threat.GetCost(edge_point));
+    }
+  }
+
+  SearchNode* goal_state = state->GetNode(goal_index);
+
+  if (goal_state->parent_id != ~0) {
+    path.Add(Vector2f(start_p.x + 0.5f, start_p.y + 0.5f));
+    tiles->push_back(start_p);
+    stats->cost = goal_state->g;
+  }
+
+  // Construct path backwards from goal node
+  std::vector<NodePoint> points;
+  u32 current_index = goal_index;
+
+  while (current_index != start_index) {
+    NodePoint p = processor_->GetPoint(processor_->GetNodeFromStorageIndex(current_index));
+    u32 parent_index = state->GetNode(current_index)->parent_id;
+    Node* parent = processor_->GetNodeFromStorageIndex(parent_index);
+
+    points.push_back(p);
+
+    if (!parent) break;
+
+    // Jump point search can skip over tiles, so walk back toward the parent to fill them in.
+    NodePoint parent_p = processor_->GetPoint(parent);
+
+    while (abs(p.x - parent_p.x) + abs(p.y - parent_p.y) > 1) {
+      CoordOffset offset = CoordOffset::FromIndex(GetDirectionIndex(p, parent_p));
+
+      p = NodePoint(p.x + offset.x, p.y + offset.y);
+      points.push_back(p);
+    }
+
+    current_index = parent_index;
+  }
+
+  ReleaseSearchState(std::move(state));
+
+  // Reverse and store as vector
+  for (std::size_t i = 0; i < points.size(); ++i) {
+    std::size_t index = points.size() - i - 1;
+    Vector2f pos(points[index].x + 0.5f, points[index].y + 0.5f);
+
+    pos = map.ResolveShipCollision(pos, radius, 0xFFFF);
+
+    path.Add(pos);
+    tiles->push_back(points[index]);
+  }
+
+  return path;
+}
+
+// Runs one A* search forward from the start and another backward from the goal, expanding whichever has the smaller
+// open set. Every time a node is reached by both, the best total through it is kept. The search stops once the lowest
+// key of either open set can't beat that total, since both heuristics are consistent.
+// The backward search moves into a node from the neighbors whose edges lead to it, so it uses the same edges and costs
+// as the forward search. Dynamic edges and bricks can be open in one direction and closed in the other, so the search
+// stops and sets one_way when it reaches one.
+Path Pathfinder::SearchBidirectional(const Map& map, const DynamicState& dynamic_state, Node* start, Node* goal,
+                                     float radius, u16 frequency, const ThreatLayer& threat, SearchStats* stats,
+                                     std::vector<NodePoint>* tiles, bool* one_way) {
+  constexpr float kNoPath = std::numeric_limits<float>::max();
+
+  Path path = {};
+  NodePoint start_p = processor_->GetPoint(start);
+  NodePoint goal_p = processor_->GetPoint(goal);
+  u32 start_index = processor_->GetStorageIndex(start);
+  u32 goal_index = processor_->GetStorageIndex(goal);
+
+  std::unique_ptr<SearchState> forward = AcquireSearchState();
+  std::unique_ptr<SearchState> backward = AcquireSearchState();
+
+  forward->Begin();
+  backward->Begin();
+
+  float best_cost = kNoPath;
+  u32 meeting_index = start_index;
+
+  // Lowers the cost of reaching the edge node from the node in one direction of the search.
+  auto relax = [&](SearchState& state, SearchState& other, SearchNode* node, u32 edge_index, NodePoint edge_point,
+                   NodePoint target, float cost) {
+    SearchNode* edge_state = state.GetNode(edge_index);
+
+    if ((edge_state->flags & SearchFlag_Touched) && cost >= edge_state->g) return;
+
+    edge_state->g = cost;
+    edge_state->f = cost + Euclidean(edge_point, target);
+    edge_state->parent_id = state.GetIndex(node);
+
+    if (!(edge_state->flags & SearchFlag_Touched)) {
+      edge_state->flags |= SearchFlag_Touched;
+      ++stats->nodes_touched;
+    }
+
+    if (!(edge_state->flags & SearchFlag_Openset)) {
+      edge_state->flags |= SearchFlag_Openset;
+      state.openset.Push(edge_state);
+    } else {
+      state.openset.Decrease(edge_state);
+    }
+
+    SearchNode* other_state = other.GetNode(edge_index);
+
+    if ((other_state->flags & SearchFlag_Touched) && cost + other_state->g < best_cost) {
+      best_cost = cost + other_state->g;
+      meeting_index = edge_index;
+    }
+  };
+
+  SearchNode* start_state = forward->GetNode(start_index);
+  SearchNode* goal_state = backward->GetNode(goal_index);
+
+  start_state->flags |= SearchFlag_Touched | SearchFlag_Openset;
+  goal_state->flags |= SearchFlag_Touched | SearchFlag_Openset;
+  forward->openset.Push(start_state);
+  backward->openset.Push(goal_state);
+
+  if (start_index == goal_index) {
+    best_cost = 0.0f;
+  }
+
+  while (!forward->openset.Empty() && !backward->openset.Empty() && !*one_way) {
+    if (forward->openset.Top()->f >= best_cost || backward->openset.Top()->f >= best_cost) break;
+
+    bool is_forward = forward->openset.Size() <= backward->openset.Size();
+    SearchState& state = is_forward ? *forward : *backward;
+    SearchState& other = is_forward ? *backward : *forward;
+    NodePoint target = is_forward ? goal_p : start_p;
+
+    SearchNode* node_state = state.openset.Pop();
+    u32 node_index = state.GetIndex(node_state);
+
+    node_state->flags &= ~SearchFlag_Openset;
+    ++stats->nodes_expanded;
+
+    Node* node = processor_->GetNodeFromStorageIndex(node_index);
+    NodePoint node_point = processor_->GetPoint(node);
+    EdgeSet edges = processor_->FindEdges(node_point, dynamic_state);
+
+    if (edges.HasDynamic()) {
+      *one_way = true;
+      break;
+    }
+
+    for (size_t i = 0; i < 4; ++i) {
+      CoordOffset offset = CoordOffset::FromIndex(i);
+      NodePoint edge_point(node_point.x + offset.x, node_point.y + offset.y);
+      Node* edge = processor_->GetNode(edge_point);
+
+      if (!edge) continue;
+
+      bool dynamic = false;
+
+      if (is_forward) {
+        if (!edges.IsSet(i)) continue;
+        if (!CanEnterNode(dynamic_state, edge, edge_point, frequency, &dynamic)) continue;
+      } else {
+        // The backward search travels the edge from the neighbor into this node, so it must exist on the neighbor.
+        if (!CanEnterNode(dynamic_state, edge, edge_point, frequency, &dynamic)) continue;
+
+        EdgeSet edge_edges = processor_->FindEdges(edge_point, dynamic_state);
+
+        if (edge_edges.HasDynamic()) dynamic = true;
+        if (!edge_edges.IsSet(i ^ 1)) continue;
+      }
+
+      if (dynamic) {
+        *one_way = true;
+        break;
+      }
+
+      // The threat is paid when entering a tile, so the backward search pays for the tile it's leaving.
+      float cost = node_state->g + (is_forward ? GetEdgeCost(node, edge) + threat.GetCost(edge_point)
+                                               : GetEdgeCost(edge, node) + threat.GetCost(node_point));
+
+      relax(state, other, node_state, processor_->GetStorageIndex(edge), edge_point, target, cost);
+    }
+  }
+
+  if (!*one_way && best_cost != kNoPath) {
+    std::vector<NodePoint> points;
+
+    // Walk from the meeting node back to the start, then forward from the meeting node to the goal.
+    for (u32 index = meeting_index; index != start_index; index = forward->GetNode(index)->parent_id) {
+      points.push_back(processor_->GetPoint(processor_->GetNodeFromStorageIndex(index)));
+    }
+
+    points.push_back(start_p);
+    std::reverse(points.begin(), points.end());
+
+    for (u32 index = meeting_index; index != goal_index;) {
+      index = backward->GetNode(index)->parent_id;
+      points.push_back(processor_->GetPoint(processor_->GetNodeFromStorageIndex(index)));
+    }
+
+    for (NodePoint point : points) {
+      path.Add(map.ResolveShipCollision(Vector2f(point.x + 0.5f, point.y + 0.5f), radius, 0xFFFF));
+    }
+
+    *tiles = std::move(points);
+    stats->cost = best_cost;
+  }
+
+  ReleaseSearchState(std::move(forward));
+  ReleaseSearchState(std::move(backward));
+
+  return path;
+}
+
+// Runs A* where each node also stores the tick that the ship reaches it when traveling at the travel speed.
+// Nodes that doors can block are checked against the door forecast at that tick instead of the current door state, so
+// the path can go through doors that open before the ship gets there. When the doors at a node will be closed, the search
+// waits at the previous node for the next update that opens them and adds the waiting time to the cost.
+// A node is only open if every door that the ship overlaps while centered on it is open. This is stricter than the
+// occupied rects that the graph is built from, but it's only used for tiles next to doors.
+Path Pathfinder::SearchTimeExpanded(const Map& map, const DynamicState& dynamic_state, Node* start, Node* goal,
+                                    float radius, u16 frequency, const ThreatLayer& threat, SearchStats* stats,
+                                    std::vector<NodePoint>* tiles) {
+  Path path = {};
+  std::shared_ptr<const DoorSchedule::Forecast> forecast = door_schedule_.GetForecast();
+  float speed = travel_speed_;
+
+  if (!forecast || speed <= 0.0f) return path;
+
+  Tick start_tick = GetCurrentTick();
+  float ticks_per_tile = 100.0f / speed;
+  s32 door_extent = (s32)ceilf(radius - 0.5f);
+
+  NodePoint start_p = processor_->GetPoint(start);
+  NodePoint goal_p = processor_->GetPoint(goal);
+  u32 start_index = processor_->GetStorageIndex(start);
+  u32 goal_index = processor_->GetStorageIndex(goal);
+
+  // Returns true if every door around the point is open after the number of door updates.
+  auto is_open = [&](NodePoint point, size_t step) {
+    for (s32 y = point.y - door_extent; y <= point.y + door_extent; ++y) {
+      for (s32 x = point.x - door_extent; x <= point.x + door_extent; ++x) {
+        if (x < 0 || y < 0 || x >= 1024 || y >= 1024) continue;
+
+        s32 door_index = door_schedule_.GetDoorIndex((u16)x, (u16)y);
+
+        if (door_index >= 0 && !door_schedule_.IsOpen(*forecast, door_index, step)) return false;
+      }
+    }
+
+    return true;
+  };
+
+  std::unique_ptr<SearchState> state = AcquireSearchState();
+  SearchState::OpenSet& openset = state->openset;
+
+  state->Begin();
+  openset.Push(state->GetNode(start_index));
+
+  while (!openset.Empty()) {
+    SearchNode* node_state = openset.Pop();
+    u32 node_index = state->GetIndex(node_state);
+
+    if (node_index == goal_index) break;
+
+    node_state->flags &= ~SearchFlag_Openset;
+    ++stats->nodes_expanded;
+
+    Node* node = processor_->GetNodeFromStorageIndex(node_index);
+    NodePoint node_point = processor_->GetPoint(node);
+    // The stored edges are the ones the node has with every door open. Doors are checked with the forecast instead.
+    EdgeSet edges = processor_->GetEdgeSet(node_point.x, node_point.y);
+
+    for (size_t i = 0; i < 4; ++i) {
+      if (!edges.IsSet(i)) continue;
+
+      CoordOffset offset = CoordOffset::FromIndex(i);
+      NodePoint edge_point(node_point.x + offset.x, node_point.y + offset.y);
+      Node* edge = processor_->GetNode(edge_point);
+
+      if (!edge) continue;
+
+      // Bricks can't be predicted, so they are checked with the state that the search started with.
+      const u16* brick_team = dynamic_state.GetBrickTeam(edge_point.x, edge_point.y);
+
+      if (brick_team) {
+        path.dynamic = true;
+
+        if (*brick_team != frequency) continue;
+      }
+
+      float cost = node_state->g + GetEdgeCost(node, edge) + threat.GetCost(edge_point);
+      float arrival = node_state->arrival + ticks_per_tile;
+
+      if (processor_->IsDynamicPoint(edge_point.x, edge_point.y)) {
+        Tick arrival_tick = start_tick + (Tick)arrival;
+        size_t step = forecast->GetStep(arrival_tick);
+        size_t last_step = step + kMaxDoorWaitSteps;
+
+        while (step <= last_step && !is_open(edge_point, step)) {
+          ++step;
+        }
+
+        if (step > last_step) continue;
+
+        Tick open_tick = forecast->GetStepTick(step);
+
+        if (TICK_GT(open_tick, arrival_tick)) {
+          float wait = (float)TICK_DIFF(open_tick, arrival_tick);
+
+          // Waiting costs the same as traveling the distance the ship could cover in that time.
+          cost += wait / ticks_per_tile;
+          arrival += wait;
+        }
+      } else if (!(edge->flags & NodeFlag_Traversable)) {
+        continue;
+      }
+
+      SearchNode* edge_state = state->GetNode(processor_->GetStorageIndex(edge));
+
+      if ((edge_state->flags & SearchFlag_Touched) && cost >= edge_state->g) continue;
+
+      edge_state->g = cost;
+      edge_state->f = cost + Euclidean(edge_point, goal_p);
+      edge_state->arrival = (u16)std::min(arrival, 65535.0f);
+      edge_state->parent_id = node_index;
+
+      if (!(edge_state->flags & SearchFlag_Touched)) {
+        edge_state->flags |= SearchFlag_Touched;
+        ++stats->nodes_touched;
+      }
+
+      if (!(edge_state->flags & SearchFlag_Openset)) {
+        edge_state->flags |= SearchFlag_Openset;
+        openset.Push(edge_state);
+      } else {
+        openset.Decrease(edge_state);
+      }
+    }
+  }
+
+  SearchNode* goal_state = state->GetNode(goal_index);
+
+  if (goal_state->parent_id != ~0 || start_index == goal_index) {
+    std::vector<NodePoint> points;
+
+    for (u32 index = goal_index; index != start_index; index = state->GetNode(index)->parent_id) {
+      points.push_back(processor_->GetPoint(processor_->GetNodeFromStorageIndex(index)));
+    }
+
+    points.push_back(start_p);
+
+    for (auto iter = points.rbegin(); iter != points.rend(); ++iter) {
+      if (processor_->IsDynamicPoint(iter->x, iter->y)) {
+        path.scheduled = true;
+      }
+
+      path.Add(map.ResolveShipCollision(Vector2f(iter->x + 0.5f, iter->y + 0.5f), radius, 0xFFFF));
+      tiles->push_back(*iter);
+    }
+
+    stats->cost = goal_state->g;
+  }
+
+  ReleaseSearchState(std::move(state));
+
+  return path;
+}
 
-Path Pathfinder::FindPath(const Map& map, const Vector2f& from, const Vector2f& to, float radius, u16 frequency) {
-  Path path = {};
-  Node* start = processor_->GetNode(ToNodePoint(from));
-  Node* goal = processor_->GetNode(ToNodePoint(to));
+std::vector<Pathfinder::NearestTarget> Pathfinder::FindNearest(const Map& map, const Vector2f& from,
+                                                               const std::vector<Vector2f>& targets, float radius,
+                                                               u16 frequency, size_t count, bool build_paths,
+                                                               size_t max_expansions) {
+  std::vector<NearestTarget> results;
+  std::shared_ptr<const DynamicState> dynamic_state = processor_->GetDynamicState();
+  Node* start = GetSearchNode(*dynamic_state, from);
 
-  if (start == nullptr || goal == nullptr) {
-    return path;
+  if (!start || count == 0) return results;
+
+  NodePoint start_p = processor_->GetPoint(start);
+  u32 start_index = processor_->GetStorageIndex(start);
+
+  // Multiple targets can share a tile, so each tile stores the first of its targets and the rest are linked.
+  std::unordered_map<u32, size_t> target_tiles;
+  std::vector<size_t> next_target(targets.size(), ~(size_t)0);
+  std::vector<u32> target_indices(targets.size(), ~0u);
+  size_t remaining = 0;
+
+  for (size_t i = 0; i < targets.size(); ++i) {
+    Node* target = GetSearchNode(*dynamic_state, targets[i]);
+
+    if (!target) continue;
+
+    NodePoint target_p = processor_->GetPoint(target);
+
+    if (!regions_.IsConnected(MapCoord(start_p.x, start_p.y), MapCoord(target_p.x, target_p.y))) continue;
+
+    u32 target_index = processor_->GetStorageIndex(target);
+    auto iter = target_tiles.find(target_index);
+
+    if (iter != target_tiles.end()) {
+      next_target[i] = iter->second;
+      iter->second = i;
+    } else {
+      target_tiles[target_index] = i;
+    }
+
+    target_indices[i] = target_index;
+    ++remaining;
   }
 
-  // Try to select a new start/goal if they aren't traversable.
+  if (remaining == 0) return results;
 
-  if (!(start->flags & NodeFlag_Traversable)) {
-    Vector2f from_center(floorf(from.x) + 0.5f, floorf(from.y) + 0.5f);
-    Vector2f new_start = from_center + Normalize(from - from_center);
-    start = processor_->GetNode(ToNodePoint(new_start));
+  count = std::min(count, remaining);
 
-    if (!(start->flags & NodeFlag_Traversable)) {
-      return path;
+  std::unique_ptr<SearchState> state = AcquireSearchState();
+  SearchState::OpenSet& openset = state->openset;
+  bool dynamic = false;
+
+  size_t expansions = 0;
+  float settled_cost = 0.0f;
+
+  state->Begin();
+
+  SearchNode* start_state = state->GetNode(start_index);
+
+  start_state->flags |= SearchFlag_Touched | SearchFlag_Openset;
+  openset.Push(start_state);
+
+  // Dijkstra without a heuristic, so nodes are settled in order of their cost from the start.
+  while (!openset.Empty() && results.size() < count && expansions < max_expansions) {
+    SearchNode* node_state = openset.Pop();
+    u32 node_index = state->GetIndex(node_state);
+
+    node_state->flags &= ~SearchFlag_Openset;
+    settled_cost = node_state->g;
+    ++expansions;
+
+    auto iter = target_tiles.find(node_index);
+
+    if (iter != target_tiles.end()) {
+      for (size_t i = iter->second; i != ~(size_t)0 && results.size() < count; i = next_target[i]) {
+        NearestTarget result;
+
+        result.index = i;
+        result.cost = node_state->g;
+
+        results.push_back(result);
+      }
+
+      target_tiles.erase(iter);
+    }
+
+    Node* node = processor_->GetNodeFromStorageIndex(node_index);
+    NodePoint node_point = processor_->GetPoint(node);
+    EdgeSet edges = processor_->FindEdges(node_point, *dynamic_state);
+
+    if (edges.HasDynamic()) {
+      dynamic = true;
+    }
+
+    for (size_t i = 0; i < 8; ++i) {
+      if (!edges.IsSet(i)) continue;
+
+      CoordOffset offset = CoordOffset::FromIndex(i);
+      NodePoint edge_point(node_point.x + offset.x, node_point.y + offset.y);
+      Node* edge = processor_->GetNode(edge_point);
+
+      if (!CanEnterNode(*dynamic_state, edge, edge_point, frequency, &dynamic)) continue;
+
+      SearchNode* edge_state = state->GetNode(processor_->GetStorageIndex(edge));
+      float cost = node_state->g + GetEdgeCost(node, edge);
+
+      if (!(edge_state->flags & SearchFlag_Touched)) {
+        edge_state->flags |= SearchFlag_Touched | SearchFlag_Openset;
+        edge_state->g = edge_state->f = cost;
+        edge_state->parent_id = node_index;
+        openset.Push(edge_state);
+      } else if ((edge_state->flags & SearchFlag_Openset) && cost < edge_state->g) {
+        edge_state->g = edge_state->f = cost;
+        edge_state->parent_id = node_index;
+        openset.Decrease(edge_state);
+      }
     }
   }
 
-  if (!(goal->flags & NodeFlag_Traversable)) {
-    Vector2f to_center(floorf(to.x) + 0.5f, floorf(to.y) + 0.5f);
-    Vector2f new_goal = to_center + Normalize(to - to_center);
-    goal = processor_->GetNode(ToNodePoint(new_goal));
+  size_t reached_count = results.size();
 
-    if (!(goal->flags & NodeFlag_Traversable)) {
-      return path;
+  // The search stopped early, so the targets it didn't reach are ordered by straight-line distance instead.
+  // Their path costs are at least the cost of the last settled node, so they stay after the reached targets.
+  if (results.size() < count && expansions >= max_expansions) {
+    size_t first_unreached = results.size();
+
+    for (auto& [tile_index, first] : target_tiles) {
+      for (size_t i = first; i != ~(size_t)0; i = next_target[i]) {
+        NearestTarget result;
+        float distance = targets[i].Distance(from);
+
+        result.index = i;
+        result.cost = std::max(distance, settled_cost);
+        result.distance = distance;
+        result.reached = false;
+
+        results.push_back(result);
+      }
     }
+
+    std::sort(results.begin() + first_unreached, results.end(),
+              [](const NearestTarget& a, const NearestTarget& b) { return a.distance < b.distance; });
+
+    results.resize(count);
   }
 
-  NodePoint start_p = processor_->GetPoint(start);
-  NodePoint goal_p = processor_->GetPoint(goal);
+  // Walk back from each reached target to count its tiles and build the path if requested.
+  for (size_t result_index = 0; result_index < reached_count; ++result_index) {
+    NearestTarget& result = results[result_index];
+    u32 current_index = target_indices[result.index];
+    std::vector<NodePoint> points;
 
-  if (!regions_.IsConnected(MapCoord(start_p.x, start_p.y), MapCoord(goal_p.x, goal_p.y))) {
-    return path;
+    while (current_index != start_index) {
+      points.push_back(processor_->GetPoint(processor_->GetNodeFromStorageIndex(current_index)));
+      current_index = state->GetNode(current_index)->parent_id;
+    }
+
+    result.distance = (float)points.size();
+
+    if (!build_paths) continue;
+
+    result.path.Add(Vector2f(start_p.x + 0.5f, start_p.y + 0.5f));
+
+    for (size_t i = points.size(); i-- > 0;) {
+      Vector2f pos(points[i].x + 0.5f, points[i].y + 0.5f);
+
+      result.path.Add(map.ResolveShipCollision(pos, radius, 0xFFFF));
+    }
+
+    result.path.dynamic = dynamic;
+    SmoothPath(map, result.path, radius, frequency);
   }
 
-  // clear vector then add start node
-  openset_.Clear();
-  openset_.Push(start);
+  ReleaseSearchState(std::move(state));
 
-  // at the start there is only one node here, the start node
-  while (!openset_.Empty()) {
-    // grab front item then delete it
-    Node* node = openset_.Pop();
+  return results;
+}
 
-    // this is the only way to break the pathfinder
-    if (node == goal) {
-      break;
+void Pathfinder::SetPathCacheSize(size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  path_cache_size_ = size;
+
+  while (path_cache_.size() > path_cache_size_) {
+    path_cache_lookup_.erase(path_cache_.back().key);
+    path_cache_.pop_back();
+  }
+}
+
+void Pathfinder::ClearPathCache() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  path_cache_.clear();
+  path_cache_lookup_.clear();
+}
+
+Pathfinder::MemoryUsage Pathfinder::GetMemoryUsage() {
+  MemoryUsage usage;
+
+  usage.graph = processor_->GetMemoryUsage() + door_schedule_.GetMemoryUsage() + door_overlays_.GetMemoryUsage();
+  usage.wall_distances = wall_distances_.GetMemoryUsage();
+
+  // Distance fields are only created and released on the game thread.
+  for (const DistanceFieldEntry& entry : distance_fields_) {
+    usage.distance_fields += entry.field->GetMemoryUsage();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (const auto& state : search_states_) {
+      usage.search_states += state->GetMemoryUsage();
     }
 
-    node->flags &= ~NodeFlag_Openset;
+    if (threat_layer_.grid) {
+      usage.graph += threat_layer_.grid->GetMemoryUsage();
+    }
 
-    NodePoint node_point = processor_->GetPoint(node);
+    for (const PathCacheEntry& entry : path_cache_) {
+      usage.path_cache += sizeof(PathCacheEntry) + entry.path.points.capacity() * sizeof(Vector2f) +
+                          entry.tiles.capacity() * sizeof(NodePoint) + entry.path.corners.capacity() * sizeof(size_t) +
+                          entry.path.corner_distances.capacity() * sizeof(float);
+    }
+  }
 
-    // Returns neighbor nodes that are not solid.
-    EdgeSet edges = processor_->FindEdges(node, radius);
+  {
+    std::lock_guard<std::mutex> lock(abstract_mutex_);
 
-    if (edges.dynamic != 0) {
-      // If we considered any possible dynamic tiles then consider the path to be dynamic.
-      // This will cause it to be cleared and re-evaluated on door update.
-      path.dynamic = true;
+    if (abstract_graph_) {
+      usage.abstract_graph = abstract_graph_->GetMemoryUsage();
     }
+  }
 
-    for (size_t i = 0; i < 8; ++i) {
-      if (!edges.IsSet(i)) continue;
+  {
+    std::lock_guard<std::mutex> lock(incremental_mutex_);
 
-      CoordOffset offset = CoordOffset::FromIndex(i);
+    if (incremental_planner_) {
+      usage.incremental = incremental_planner_->GetMemoryUsage();
+    }
+  }
 
-      NodePoint edge_point(node_point.x + offset.x, node_point.y + offset.y);
-      Node* edge = processor_->GetNode(edge_point);
+  return usage;
+}
 
-      if (!(edge->flags & NodeFlag_Traversable)) continue;
+// Paths that never considered a door stay valid when doors change, but any brick change could block a path.
+bool Pathfinder::IsCacheEntryValid(const PathCacheEntry& entry) const {
+  if (entry.brick_version != brick_version_) return false;
 
-      // This edge has a dynamic brick, so we need to check the state
-      if (edge->flags & NodeFlag_Brick) {
-        path.dynamic = true;
+  return entry.door_version == door_version_ || !entry.path.dynamic;
+}
 
-        if (map.IsSolid(edge_point.x, edge_point.y, frequency)) {
-          continue;
-        }
+// Looks for a cached path to the same goal that passes through or next to the start tile.
+// The end of a path that passes through the start tile is the best path from there. A path that only passes next to it
+// is reused with a step onto it first, which can be longer than the best path from the start.
+bool Pathfinder::SpliceCachedPath(const Map& map, const DynamicState& dynamic_state, const PathCacheKey& key,
+                                  Path* path, std::vector<NodePoint>* tiles) {
+  const Node* start = processor_->PeekNode(key.start.x, key.start.y);
+
+  if (!start || !(start->flags & NodeFlag_Traversable)) return false;
+
+  EdgeSet start_edges = processor_->FindEdges(key.start, dynamic_state);
+
+  for (const PathCacheEntry& entry : path_cache_) {
+    const PathCacheKey& other = entry.key;
+
+    if (!(other.goal == key.goal) || other.radius != key.radius || other.frequency != key.frequency ||
+        other.mode != key.mode) {
+      continue;
+    }
+
+    if (!IsCacheEntryValid(entry)) continue;
+
+    // The points are moved out of walls, so the tiles that they were built from are matched instead.
+    const std::vector<NodePoint>& entry_tiles = entry.tiles;
+    // Partial paths can only be spliced inside of the refined tiles.
+    size_t end = entry.path.partial ? std::min(entry.path.refined_count, entry_tiles.size()) : entry_tiles.size();
+
+    // Search from the goal end so the shortest remaining path is used.
+    for (size_t i = end; i-- > 0;) {
+      NodePoint point = entry_tiles[i];
+      bool prepend = false;
+
+      if (!(point == key.start)) {
+        s32 dx = (s32)point.x - (s32)key.start.x;
+        s32 dy = (s32)point.y - (s32)key.start.y;
+
+        if (abs(dx) + abs(dy) != 1) continue;
+        if (!start_edges.IsSet(GetDirectionIndex(key.start, point))) continue;
+
+        prepend = true;
       }
 
-      // This edge is dynamically empty and dirty. We should update its traversability.
-      if (edge->flags & NodeFlag_DynamicEmpty) {
-        bool traversable = processor_->UpdateDynamicNode(edge, radius, frequency);
+      path->Clear();
+      tiles->clear();
 
-        if (!traversable) {
-          continue;
-        }
+      if (prepend) {
+        tiles->push_back(key.start);
       }
 
-      touched_.push_back(edge);
+      tiles->insert(tiles->end(), entry_tiles.begin() + i, entry_tiles.end());
 
-      // The cost to this neighbor is the cost to the current node plus the edge weight times the distance between the
-      // nodes.
-      // Euclidean could be calculated based on edge index if all 8 are considered again.
-      float cost = node->g + edge->GetWeight();
+      for (NodePoint tile : *tiles) {
+        path->Add(map.ResolveShipCollision(Vector2f(tile.x + 0.5f, tile.y + 0.5f), key.radius, 0xFFFF));
+      }
 
-      // Only set a very high movement cost upon first entering a safety tile.
-      if ((edge->flags & NodeFlag_Safety) && !(node->flags & NodeFlag_Safety)) {
-        cost = node->g + kSafetyWeight;
+      path->dynamic = entry.path.dynamic;
+      path->partial = entry.path.partial;
+
+      if (entry.path.partial) {
+        path->refined_count = entry.path.refined_count - i + (prepend ? 1 : 0);
       }
 
-      // Compute a heuristic from this neighbor to the end goal.
-      float h = Euclidean(edge_point, goal_p);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void Pathfinder::InsertCachedPath(const PathCacheKey& key, const Path& path, std::vector<NodePoint> tiles,
+                                  const SearchStats& stats, u32 door_version, u32 brick_version) {
+  if (path_cache_size_ == 0) return;
 
-      // The path to this node is lower than it was previously, so update its values.
-      if (cost < edge->g || !(edge->flags & NodeFlag_Touched)) {
-        edge->g = cost;
-        edge->f = edge->g + h;
+  if (path_cache_.size() >= path_cache_size_) {
+    path_cache_lookup_.erase(path_cache_.back().key);
+    path_cache_.pop_back();
+  }
 
-        edge->parent_id = processor_->GetNodeIndex(node);
+  PathCacheEntry entry = {key, path, std::move(tiles), stats, door_version, brick_version};
 
-        if (!(edge->flags & NodeFlag_Touched)) {
-          touched_.push_back(edge);
-          edge->flags |= NodeFlag_Touched;
-        }
+  path_cache_.push_front(std::move(entry));
+  path_cache_lookup_[key] = path_cache_.begin();
+}
 
-        if (!(edge->flags & NodeFlag_Openset)) {
-          // The node is not in the openset so add it.
-          edge->flags |= NodeFlag_Openset;
-          openset_.Push(edge);
-        }
+void Pathfinder::SetDoorSolidMethod(DoorSolidMethod method) {
+  if (processor_->GetDoorSolidMethod() == method) return;
+
+  processor_->SetDoorSolidMethod(method);
+  InvalidateDynamicPoints();
+}
+
+void Pathfinder::SetBrick(u16 x, u16 y, u16 team) {
+  if (!processor_ || x >= 1024 || y >= 1024) return;
+
+  std::shared_ptr<const BrickSet> current = processor_->GetDynamicState()->bricks;
+  const u16* current_team = current ? current->GetTeam(x, y) : nullptr;
+
+  if (current_team && *current_team == team) return;
+
+  // Searches may still be reading the current set, so the change is made to a copy.
+  auto bricks = current ? std::make_shared<BrickSet>(*current) : std::make_shared<BrickSet>();
+
+  bricks->Set(x, y, team);
+  processor_->SetBricks(std::move(bricks));
+
+  InvalidateBricks({NodePoint(x, y)});
+}
+
+void Pathfinder::ClearBrick(u16 x, u16 y) {
+  if (!processor_) return;
+
+  std::shared_ptr<const BrickSet> current = processor_->GetDynamicState()->bricks;
+
+  if (!current || !current->Contains(x, y)) return;
+
+  auto bricks = std::make_shared<BrickSet>(*current);
+
+  bricks->Erase(x, y);
+  processor_->SetBricks(std::move(bricks));
+
+  InvalidateBricks({NodePoint(x, y)});
+}
+
+void Pathfinder::SetBricks(BrickManager& brick_manager) {
+  if (!processor_) return;
+
+  std::shared_ptr<const BrickSet> current = processor_->GetDynamicState()->bricks;
+  auto bricks = std::make_shared<BrickSet>();
+  std::vector<NodePoint> changes;
+
+  for (Brick* brick = brick_manager.bricks; brick; brick = brick->next) {
+    u16 x = brick->tile.x;
+    u16 y = brick->tile.y;
+
+    if (x >= 1024 || y >= 1024) continue;
+
+    const u16* current_team = current ? current->GetTeam(x, y) : nullptr;
+
+    if (!current_team || *current_team != brick->team) {
+      changes.emplace_back(x, y);
+    }
+
+    bricks->Set(x, y, brick->team);
+  }
+
+  // Bricks that expired while this graph wasn't getting events are still in its set.
+  if (current) {
+    current->ForEach([&](u16 x, u16 y, u16) {
+      if (!bricks->Contains(x, y)) {
+        changes.emplace_back(x, y);
+      }
+    });
+  }
+
+  if (changes.empty()) return;
+
+  processor_->SetBricks(std::move(bricks));
+  InvalidateBricks(changes);
+}
+
+void Pathfinder::InvalidateBricks(const std::vector<NodePoint>& points) {
+  ++brick_version_;
+
+  {
+    std::lock_guard<std::mutex> lock(abstract_mutex_);
+
+    if (abstract_graph_) {
+      for (NodePoint point : points) {
+        abstract_graph_->InvalidateTile(point.x, point.y);
       }
     }
   }
 
-  if (goal->parent_id != ~0) {
-    path.Add(Vector2f(start_p.x + 0.5f, start_p.y + 0.5f));
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (incremental_active_) {
+      incremental_changes_.insert(incremental_changes_.end(), points.begin(), points.end());
+    }
   }
 
-  // Construct path backwards from goal node
-  std::vector<NodePoint> points;
-  Node* current = goal;
+  for (DistanceFieldEntry& entry : distance_fields_) {
+    entry.field->InvalidateTiles(points);
+  }
+}
 
-  while (current != nullptr && current != start) {
-    NodePoint p = processor_->GetPoint(current);
-    points.push_back(p);
-    current = processor_->GetNodeFromIndex(current->parent_id);
+void Pathfinder::MarkDynamicNodes() {
+  const Map& map = processor_->GetGame().GetMap();
+  u8 open_mask = GetOpenDoorMask(map);
+  std::shared_ptr<const DoorOverlay> overlay = door_overlays_.Get(open_mask);
+
+  // Searches only read the overlay, so one that wasn't predicted is built now.
+  if (!overlay) {
+    overlay = door_overlays_.Build(map, open_mask, config.ship_radius);
   }
 
-  // Reverse and store as vector
-  for (std::size_t i = 0; i < points.size(); ++i) {
-    std::size_t index = points.size() - i - 1;
-    Vector2f pos(points[index].x + 0.5f, points[index].y + 0.5f);
+  processor_->SetDoorOverlay(std::move(overlay));
+  InvalidateDynamicPoints();
+}
 
-    pos = map.ResolveShipCollision(pos, radius, 0xFFFF);
+void Pathfinder::InvalidateDynamicPoints() {
+  ++door_version_;
 
-    path.Add(pos);
+  {
+    std::lock_guard<std::mutex> lock(abstract_mutex_);
+
+    if (abstract_graph_) {
+      abstract_graph_->InvalidateDynamicSectors();
+    }
   }
 
-  for (Node* node : touched_) {
-    node->flags &= ~NodeFlag_Initialized;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (incremental_active_) {
+      incremental_changes_.insert(incremental_changes_.end(), processor_->dynamic_points.begin(),
+                                  processor_->dynamic_points.end());
+    }
   }
-  touched_.clear();
 
-  return path;
+  for (DistanceFieldEntry& entry : distance_fields_) {
+    entry.field->InvalidateTiles(processor_->dynamic_points);
+  }
 }
 
-// This is pretty expensive to happen on a ship change.
-// TODO: It could be faster by using simd solid checks.
-inline static float GetWallDistance(const Map& map, u16 x, u16 y, u16 radius) {
-  float closest_sq = std::numeric_limits<float>::max();
+void Pathfinder::UpdateDoorSchedule(const Map& map, const ArenaSettings& settings) {
+  if (!door_schedule_.Update(map, settings)) return;
 
-  for (s16 offset_y = -radius; offset_y <= radius; ++offset_y) {
-    for (s16 offset_x = -radius; offset_x <= radius; ++offset_x) {
-      u16 check_x = x + offset_x;
-      u16 check_y = y + offset_y;
+  std::shared_ptr<const DoorSchedule::Forecast> forecast = door_schedule_.GetForecast();
 
-      if (map.IsSolidEmptyDoors(check_x, check_y, 0xFFFF)) {
-        float dist_sq = (float)(offset_x * offset_x + offset_y * offset_y);
+  if (!forecast) return;
 
-        if (dist_sq < closest_sq) {
-          closest_sq = dist_sq;
-        }
+  size_t count = std::min(kDoorOverlayLookahead, forecast->open_masks.size());
+
+  for (size_t i = 0; i < count; ++i) {
+    door_overlays_.Request(map, forecast->open_masks[i], config.ship_radius);
+  }
+}
+
+void Pathfinder::ResetDynamicState() {
+  CancelRequests();
+  processor_->SetBricks(nullptr);
+  ++brick_version_;
+  MarkDynamicNodes();
+  request_map_.reset();
+
+  {
+    std::lock_guard<std::mutex> lock(abstract_mutex_);
+    abstract_graph_.reset();
+  }
+
+  {
+    std::lock_guard<std::mutex> planner_lock(incremental_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    incremental_planner_.reset();
+    incremental_changes_.clear();
+    incremental_active_ = false;
+  }
+
+  distance_fields_.clear();
+  ClearPathCache();
+}
+
+const WallDistanceField& Pathfinder::GetWallDistances(const Map& map) {
+  if (!wall_distances_.IsBuilt() || wall_distances_.GetMapChecksum() != map.checksum) {
+    wall_distances_.Build(map);
+  }
+
+  return wall_distances_;
+}
+
+DistanceField& Pathfinder::GetDistanceField(const Map& map, const Vector2f& goal, float radius, u16 frequency) {
+  NodePoint goal_point = ToNodePoint(goal);
+  const Node* goal_node = processor_->PeekNode(goal_point.x, goal_point.y);
+
+  // Move the goal out of a wall the same way FindPath does so the field can reach it.
+  if (goal_node && !(goal_node->flags & NodeFlag_Traversable)) {
+    Vector2f goal_center(floorf(goal.x) + 0.5f, floorf(goal.y) + 0.5f);
+    goal_point = ToNodePoint(goal_center + Normalize(goal - goal_center));
+  }
+
+  ++distance_field_uses_;
+
+  for (DistanceFieldEntry& entry : distance_fields_) {
+    if (entry.field->Matches(goal_point, radius, frequency)) {
+      entry.last_use = distance_field_uses_;
+      return *entry.field;
+    }
+  }
+
+  // Replace the field that was used the longest time ago.
+  if (distance_fields_.size() >= kMaxDistanceFields) {
+    auto oldest = std::min_element(
+        distance_fields_.begin(), distance_fields_.end(),
+        [](const DistanceFieldEntry& lhs, const DistanceFieldEntry& rhs) { return lhs.last_use < rhs.last_use; });
+
+    distance_fields_.erase(oldest);
+  }
+
+  DistanceFieldEntry entry;
+
+  entry.field = std::make_unique<DistanceField>(*processor_, map, goal_point, radius, frequency);
+  entry.last_use = distance_field_uses_;
+
+  distance_fields_.push_back(std::move(entry));
+
+  return *distance_fields_.back().field;
+}
+
+Node* Pathfinder::GetSearchNode(const DynamicState& dynamic_state, const Vector2f& position) {
+  NodePoint point = ToNodePoint(position);
+  Node* node = processor_->GetNode(point);
+
+  if (node == nullptr) return nullptr;
+
+  // Try to select a nearby node if this one isn't traversable.
+  if (!processor_->IsTraversable(node, point, dynamic_state)) {
+    Vector2f center(floorf(position.x) + 0.5f, floorf(position.y) + 0.5f);
+    Vector2f nearby = center + Normalize(position - center);
+
+    point = ToNodePoint(nearby);
+    node = processor_->GetNode(point);
+
+    if (node == nullptr || !processor_->IsTraversable(node, point, dynamic_state)) {
+      return nullptr;
+    }
+  }
+
+  return node;
+}
+
+bool Pathfinder::CanEnterNode(const DynamicState& dynamic_state, Node* node, NodePoint point, u16 frequency,
+                              bool* dynamic) {
+  if (!processor_->IsTraversable(node, point, dynamic_state)) return false;
+
+  // This node has a dynamic brick, so we need to check the state
+  const u16* brick_team = dynamic_state.GetBrickTeam(point.x, point.y);
+
+  if (brick_team) {
+    *dynamic = true;
+
+    if (*brick_team != frequency) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// A node is uniform when moving through it costs the same as any other open tile and its edges can't change.
+// Jump point search can only skip over uniform nodes.
+bool Pathfinder::IsUniformNode(const DynamicState& dynamic_state, const Node* node, NodePoint point,
+                               EdgeSet edges) const {
+  constexpr NodeFlags kWeightedFlags = NodeFlag_Safety | NodeFlag_DynamicEmpty;
+
+  if (!(node->flags & NodeFlag_Traversable)) return false;
+  if (node->flags & kWeightedFlags) return false;
+  if (edges.HasDynamic()) return false;
+  if (dynamic_state.GetBrickTeam(point.x, point.y)) return false;
+
+  return node->GetWeight() == 1.0f;
+}
+
+// Checks if a vertical move into this point forces the neighbor on the provided side to be expanded.
+// A neighbor is forced when the equal cost path that goes around this point is blocked or weighted.
+bool Pathfinder::IsForcedNeighbor(const DynamicState& dynamic_state, NodePoint point, size_t direction,
+                                  size_t side_index) const {
+  if (!processor_->GetEdgeSet(point.x, point.y).IsSet(side_index)) return false;
+
+  CoordOffset forward = CoordOffset::FromIndex(direction);
+  CoordOffset side = CoordOffset::FromIndex(side_index);
+  const Node* neighbor = processor_->PeekNode(point.x + side.x, point.y + side.y);
+
+  if (!neighbor || !(neighbor->flags & NodeFlag_Traversable)) return false;
+
+  NodePoint prev(point.x - forward.x, point.y - forward.y);
+  NodePoint around(prev.x + side.x, prev.y + side.y);
+  const Node* around_node = processor_->PeekNode(around.x, around.y);
+
+  if (!around_node || !processor_->GetEdgeSet(prev.x, prev.y).IsSet(side_index)) return true;
+
+  EdgeSet around_edges = processor_->GetEdgeSet(around.x, around.y);
+
+  return !IsUniformNode(dynamic_state, around_node, around, around_edges) || !around_edges.IsSet(direction);
+}
+
+// Travels in a straight line from the provided point until a node is found that must be expanded.
+// Horizontal jumps also scan vertically from every node, since paths are allowed to turn vertical at any point.
+Pathfinder::JumpResult Pathfinder::Jump(const DynamicState& dynamic_state, NodePoint from, size_t direction,
+                                        const Node* goal) {
+  JumpResult result;
+  CoordOffset offset = CoordOffset::FromIndex(direction);
+  NodePoint current = from;
+  const Node* previous = processor_->PeekNode(from.x, from.y);
+  float cost = 0.0f;
+
+  while (true) {
+    if (!processor_->GetEdgeSet(current.x, current.y).IsSet(direction)) return result;
+
+    NodePoint next(current.x + offset.x, current.y + offset.y);
+    const Node* next_node = processor_->PeekNode(next.x, next.y);
+
+    if (!next_node || !(next_node->flags & NodeFlag_Traversable)) return result;
+
+    cost += GetEdgeCost(previous, next_node);
+
+    bool found =
+        next_node == goal || !IsUniformNode(dynamic_state, next_node, next, processor_->GetEdgeSet(next.x, next.y));
+
+    if (!found) {
+      if (IsVerticalDirection(direction)) {
+        found = IsForcedNeighbor(dynamic_state, next, direction, CoordOffset::WestIndex()) ||
+                IsForcedNeighbor(dynamic_state, next, direction, CoordOffset::EastIndex());
+      } else {
+        found = Jump(dynamic_state, next, CoordOffset::NorthIndex(), goal).node ||
+                Jump(dynamic_state, next, CoordOffset::SouthIndex(), goal).node;
       }
     }
+
+    if (found) {
+      result.node = processor_->GetNode(next);
+      result.cost = cost;
+      return result;
+    }
+
+    previous = next_node;
+    current = next;
   }
 
-  return sqrt(closest_sq);
+  return result;
 }
 
 static void CalculateTraversables(std::vector<NodePoint>& dynamic_points, const Map& map, NodeProcessor& processor,
@@ -255,7 +1684,8 @@ static void CalculateTraversables(std::vector<NodePoint>& dynamic_points, const
       if (map.CanOverlapTile(Vector2f(x, y), ship_radius, frequency)) {
         node->flags |= NodeFlag_Traversable;
 
-        size_t rect_count = map.GetAllOccupiedRects(Vector2f(x, y), ship_radius, frequency, scratch_rects);
+        size_t rect_count =
+            processor.GetOccupiedRectIndex().GetRects(map, Vector2f(x, y), ship_radius, frequency, scratch_rects);
 
         // This might be a diagonal tile
         if (rect_count == 2) {
@@ -293,8 +1723,9 @@ static void CalculateTraversables(std::vector<NodePoint>& dynamic_points, const
   }
 }
 
-static void CalculateEdges(const Map& map, NodeProcessor& processor, float ship_radius, Pathfinder::WeightConfig config,
-                           s16 x_start, s16 y_start, s16 x_end, s16 y_end) {
+static void CalculateEdges(const Map& map, NodeProcessor& processor, const WallDistanceField& wall_distances,
+                           float ship_radius, Pathfinder::WeightConfig config, s16 x_start, s16 y_start, s16 x_end,
+                           s16 y_end) {
   u32 frequency = 0xFFFF;
 
   OccupiedRect* occupied_scratch = (OccupiedRect*)malloc(sizeof(OccupiedRect) * 2048);
@@ -305,7 +1736,7 @@ static void CalculateEdges(const Map& map, NodeProcessor& processor, float ship_
 
       Node* node = processor.GetNode(NodePoint(x, y));
       NodePoint current_point = processor.GetPoint(node);
-      EdgeSet edges = processor.CalculateEdges(node, ship_radius, occupied_scratch);
+      EdgeSet edges = processor.CalculateEdges(map, node, ship_radius, occupied_scratch);
 
       node->SetWeight(1.0f);
 
@@ -313,7 +1744,7 @@ static void CalculateEdges(const Map& map, NodeProcessor& processor, float ship_
 
       if (config.weight_type != Pathfinder::WeightType::Flat) {
         int close_distance = config.wall_distance;
-        float distance = GetWallDistance(map, x, y, close_distance);
+        float distance = wall_distances.GetDistance(x, y);
 
         if (distance < 1) distance = 1;
 
@@ -345,6 +1776,20 @@ void Pathfinder::CreateMapWeights(MemoryArena& temp_arena, const Map& map, Weigh
   OccupiedRect* scratch_rects = memory_arena_push_type_count(&temp_arena, OccupiedRect, 256);
 
   this->config = config;
+  CancelRequests();
+  door_overlays_.Clear();
+  processor_->AllocateBlocks(map);
+  processor_->BuildOccupiedRectIndex(map, ship_radius);
+  abstract_graph_.reset();
+  incremental_planner_.reset();
+  incremental_changes_.clear();
+  incremental_active_ = false;
+  distance_fields_.clear();
+  ClearPathCache();
+
+  if (config.weight_type != WeightType::Flat) {
+    wall_distances_.Build(map);
+  }
 
   constexpr size_t kThreadCount = 12;
   std::thread threads[kThreadCount];
@@ -401,13 +1846,15 @@ void Pathfinder::CreateMapWeights(MemoryArena& temp_arena, const Map& map, Weigh
       x_end += remainder;
     }
 
-    threads[i] =
-        std::thread(CalculateEdges, map, std::ref(*processor_), ship_radius, config, x_start, y_start, x_end, y_end);
+    threads[i] = std::thread(CalculateEdges, map, std::ref(*processor_), std::cref(wall_distances_), ship_radius, config,
+                             x_start, y_start, x_end, y_end);
   }
 
   for (size_t i = 0; i < kThreadCount; ++i) {
     threads[i].join();
   }
+
+  processor_->IndexDynamicPoints();
 }
 
 }  // namespace path
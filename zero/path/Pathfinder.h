@@ -2,81 +2,414 @@
 
 #include <zero/RegionRegistry.h>
 #include <zero/game/Memory.h>
+#include <zero/path/AbstractGraph.h>
+#include <zero/path/DistanceField.h>
+#include <zero/path/DoorOverlayCache.h>
+#include <zero/path/DoorSchedule.h>
+#include <zero/path/IncrementalPlanner.h>
+#include <zero/path/MapSnapshot.h>
 #include <zero/path/NodeProcessor.h>
 #include <zero/path/Path.h>
+#include <zero/path/PriorityQueue.h>
+#include <zero/path/SearchState.h>
+#include <zero/path/ThreatGrid.h>
+#include <zero/path/WallDistanceField.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 namespace zero {
 namespace path {
 
-template <typename T, typename Compare, typename Container = std::vector<T>>
-class PriorityQueue {
+struct Pathfinder {
  public:
-  using const_iterator = typename Container::const_iterator;
+  enum class WeightType { Flat, Linear, Exponential };
+  struct WeightConfig {
+    float ship_radius = 0.0f;
+    WeightType weight_type = WeightType::Flat;
+    s32 wall_distance = 1;
+  };
 
-  const_iterator begin() const { return container_.cbegin(); }
-  const_iterator end() const { return container_.cend(); }
+  enum class SearchMode {
+    // Expands every neighbor of every node that is visited.
+    AStar,
+    // Jumps over runs of uniform weight tiles and only pushes the nodes where the path could turn.
+    // Weighted, safe, brick and dynamic tiles are expanded the same as AStar.
+    JumpPoint,
+    // Searches the sector abstraction first and only refines the start of the path into tiles.
+    // The returned path is partial and should be rebuilt before reaching the unrefined points.
+    // Falls back to AStar when the start and goal share a sector.
+    Hierarchical,
+    // Keeps the search tree from the previous search to the same goal and only repairs the parts that door and brick
+    // changes affect. This is best for goals that don't move while the bot travels through doors.
+    Incremental,
+    // Searches forward from the start and backward from the goal at the same time until they meet, which expands fewer
+    // nodes on long paths. Falls back to AStar when it reaches a door or brick.
+    Bidirectional,
+    // Predicts when the ship reaches each tile at its travel speed and checks doors against the door schedule at that
+    // tick, waiting for doors that open soon. Falls back to AStar when doors can't be predicted or no path is found.
+    TimeExpanded,
 
-  void Push(T item) {
-    container_.push_back(item);
-    std::push_heap(container_.begin(), container_.end(), comparator_);
-  }
+    Count
+  };
 
-  T Pop() {
-    T item = container_.front();
-    std::pop_heap(container_.begin(), container_.end(), comparator_);
-    container_.pop_back();
-    return item;
-  }
+  // Information about the most recent search so different search modes can be compared.
+  struct SearchStats {
+    size_t nodes_expanded = 0;
+    size_t nodes_touched = 0;
+    // The total cost to the goal node or zero if no path was found.
+    float cost = 0.0f;
+  };
 
-  // sort from highest at beginning to lowest at end
-  void Update() { std::make_heap(container_.begin(), container_.end(), comparator_); }
+  // The path to one of the targets given to FindNearest.
+  struct NearestTarget {
+    // The index of the target in the list given to FindNearest.
+    size_t index = 0;
+    // The total travel cost to the target including tile weights.
+    float cost = 0.0f;
+    // The number of tiles traveled to reach the target.
+    float distance = 0.0f;
+    // This is only built when FindNearest is asked for paths.
+    Path path;
+    // False if the search stopped expanding before it reached the target. The cost and distance are then the
+    // straight-line distance and there's no path.
+    bool reached = true;
+  };
 
-  void Clear() { container_.clear(); }
-  std::size_t Size() const { return container_.size(); }
-  bool Empty() const { return container_.empty(); }
+  // Counters for the path cache so its size can be tuned.
+  struct PathCacheStats {
+    u64 hits = 0;
+    // Misses that were answered by reusing the end of a cached path that passes next to the start tile.
+    u64 splices = 0;
+    u64 misses = 0;
+  };
 
- private:
-  Container container_;
-  Compare comparator_;
-};
+  // A path search that runs on the pathfinder's request threads.
+  // The requester keeps the handle and checks it on later updates until the path is ready.
+  struct PathRequest {
+    enum class State { Pending, Running, Complete, Cancelled };
 
-struct Pathfinder {
- public:
-  enum class WeightType { Flat, Linear, Exponential };
-  struct WeightConfig {
-    float ship_radius = 0.0f;
-    WeightType weight_type = WeightType::Flat;
-    s32 wall_distance = 1;
+    inline bool IsReady() const { return state == State::Complete; }
+    inline bool IsPending() const {
+      State current = state;
+      return current == State::Pending || current == State::Running;
+    }
+
+    // Stops the request from being searched. A search that is already running will finish, but the path is dropped.
+    inline void Cancel() { state = State::Cancelled; }
+
+    inline const Vector2f& GetGoal() const { return to; }
+    inline SearchMode GetMode() const { return mode; }
+
+    std::atomic<State> state = State::Pending;
+    // The found path. This is only valid after the request is complete and is empty if no path exists.
+    Path path;
+
+   private:
+    friend struct Pathfinder;
+
+    // The start, map and state are guarded by the request mutex since coalesced requests move them to the newest ones.
+    // The map and state are released once the search starts.
+    Vector2f from;
+    std::shared_ptr<const MapSnapshot> map;
+    std::shared_ptr<const DynamicState> dynamic_state;
+    u32 door_version = 0;
+    u32 brick_version = 0;
+    Vector2f to;
+    float radius = 0.0f;
+    u16 frequency = 0;
+    SearchMode mode = SearchMode::AStar;
+  };
+
+  using PathRequestHandle = std::shared_ptr<PathRequest>;
+
+  // The number of bytes used by each part of the pathfinder.
+  struct MemoryUsage {
+    size_t graph = 0;
+    size_t search_states = 0;
+    size_t abstract_graph = 0;
+    size_t incremental = 0;
+    size_t distance_fields = 0;
+    size_t wall_distances = 0;
+    size_t path_cache = 0;
+
+    inline size_t GetTotal() const {
+      return graph + search_states + abstract_graph + incremental + distance_fields + wall_distances + path_cache;
+    }
   };
 
+  static constexpr size_t kDefaultPathCacheSize = 64;
+  // The most threads that FindPaths will search with at once.
+  static constexpr size_t kMaxSearchThreads = 4;
+  // Each search state stores every allocated node, so only this many are kept after searches finish.
+  static constexpr size_t kMaxPooledSearchStates = 2;
+  // How many threads run the searches submitted with RequestPath.
+  static constexpr size_t kRequestThreads = 2;
+  // FindNearest runs every tick for target selection, so it stops after this many nodes by default.
+  static constexpr size_t kDefaultNearestExpansions = 32768;
+
   WeightConfig config;
 
   Pathfinder(std::unique_ptr<NodeProcessor> processor, RegionRegistry& regions);
-  Path FindPath(const Map& map, const Vector2f& from, const Vector2f& to, float radius, u16 frequency);
+  ~Pathfinder();
 
-  void CreateMapWeights(MemoryArena& temp_arena, const Map& map, WeightConfig config);
-  void SetDoorSolidMethod(DoorSolidMethod method) { processor_->SetDoorSolidMethod(method); }
-  inline void SetBrickNode(s32 x, s32 y, bool exists) {
-    if (processor_) processor_->SetBrickNode(x, y, exists);
+  Path FindPath(const Map& map, const Vector2f& from, const Vector2f& to, float radius, u16 frequency) {
+    return FindPath(map, from, to, radius, frequency, search_mode_);
   }
+  Path FindPath(const Map& map, const Vector2f& from, const Vector2f& to, float radius, u16 frequency,
+                SearchMode mode);
+
+  // Finds a path from the start to each goal, splitting the searches across multiple threads.
+  // This is useful for scoring several candidate targets at once. Each search uses its own search state, but the map
+  // and graph are shared, so they must not change until this returns.
+  std::vector<Path> FindPaths(const Map& map, const Vector2f& from, const std::vector<Vector2f>& goals, float radius,
+                              u16 frequency);
+
+  // Queues a search to run on a request thread and returns immediately, so the caller can keep following its old path.
+  // The search uses a copy of the map and the door and brick state from when it was requested, so this must be called
+  // from the game thread. A pending request with the same goal tile, radius, frequency and mode is reused with the new
+  // start position and state.
+  PathRequestHandle RequestPath(const Map& map, const Vector2f& from, const Vector2f& to, float radius, u16 frequency,
+                                SearchMode mode);
+  // Cancels every request that hasn't started searching yet.
+  void CancelRequests();
+
+  // Runs a single search outward from the start that stops once the closest count targets are reached.
+  // Returns the reached targets sorted from closest to farthest by path cost. Targets that aren't connected to the
+  // start are skipped. This is much cheaper than a separate FindPath for every candidate when choosing a target.
+  // The search stops after max_expansions nodes. Connected targets that it didn't reach by then fill the rest of the
+  // results by straight-line distance after every reached target, so blocked targets can't make it search the map.
+  std::vector<NearestTarget> FindNearest(const Map& map, const Vector2f& from, const std::vector<Vector2f>& targets,
+                                         float radius, u16 frequency, size_t count, bool build_paths = false,
+                                         size_t max_expansions = kDefaultNearestExpansions);
+
+  void CreateMapWeights(MemoryArena& temp_arena, const Map& map, WeightConfig config);
+  void SetDoorSolidMethod(DoorSolidMethod method);
+  // These publish a new brick set for searches to use. The team's own bricks aren't solid to it.
+  void SetBrick(u16 x, u16 y, u16 team);
+  void ClearBrick(u16 x, u16 y);
+  // Replaces the brick set with the bricks in the manager. Graphs that aren't ready miss brick events, so this
+  // happens when one is activated.
+  void SetBricks(BrickManager& brick_manager);
+
+  // Publishes the door overlay for the current doors to the processor, building it first if it wasn't predicted.
+  // Also invalidates the sectors that contain dynamic points. This should happen on door updates.
+  void MarkDynamicNodes();
+  // Removes the bricks and door state left over from a previous arena so the graph can be reused.
+  void ResetDynamicState();
+
+  // Predicts the doors from the map's current door state. This must be called from the game thread after doors update.
+  // The door overlays for the next few door updates are built ahead of time from the prediction.
+  void UpdateDoorSchedule(const Map& map, const ArenaSettings& settings);
+  inline const DoorSchedule& GetDoorSchedule() const { return door_schedule_; }
+
+  // Sets the speed in tiles per second that time expanded searches use to predict when the ship reaches each tile.
+  inline void SetTravelSpeed(float speed) { travel_speed_ = speed; }
+
+  // Sets the threat grid that searches add to the cost of each tile they enter, scaled by the weight.
+  // A null grid or a weight of zero turns it off. While it's on, paths aren't cached and the jump point, hierarchical
+  // and incremental modes search as AStar since they assume tile costs only change with doors and bricks.
+  void SetThreatLayer(std::shared_ptr<const ThreatGrid> grid, float weight);
+
+  // Returns the distance field for the goal, creating it if it doesn't exist yet.
+  // The field is computed on its first query and shared by every caller with the same goal tile, radius and frequency.
+  DistanceField& GetDistanceField(const Map& map, const Vector2f& goal, float radius, u16 frequency);
+
+  // Returns the distance from each tile to the closest wall, building it if it doesn't exist for this map yet.
+  // This is shared with anything else that needs wall clearance, such as steering and collision checks.
+  const WallDistanceField& GetWallDistances(const Map& map);
+
+  // Sets how many paths are kept in the cache. A size of zero disables the cache.
+  void SetPathCacheSize(size_t size);
+  void ClearPathCache();
+  inline size_t GetPathCacheSize() const { return path_cache_size_; }
+  inline size_t GetPathCacheCount() const { return path_cache_.size(); }
+  inline const PathCacheStats& GetPathCacheStats() const { return path_cache_stats_; }
+
+  inline void SetSearchMode(SearchMode mode) { search_mode_ = mode; }
+  inline SearchMode GetSearchMode() const { return search_mode_; }
+  inline const SearchStats& GetLastSearchStats() const { return last_stats_; }
 
   inline NodeProcessor& GetProcessor() { return *processor_; }
 
+  // Sums up the memory of the graph and everything cached for searches.
+  MemoryUsage GetMemoryUsage();
+
  private:
-  struct NodeCompare {
-    bool operator()(const Node* lhs, const Node* rhs) const { return lhs->f > rhs->f; }
+  struct JumpResult {
+    Node* node = nullptr;
+    // The cost of traveling from the jump origin to the found node.
+    float cost = 0.0f;
+  };
+
+  struct PathCacheKey {
+    NodePoint start;
+    NodePoint goal;
+    float radius;
+    u16 frequency;
+    SearchMode mode;
+
+    bool operator==(const PathCacheKey& other) const {
+      return start == other.start && goal == other.goal && radius == other.radius && frequency == other.frequency &&
+             mode == other.mode;
+    }
+  };
+
+  struct PathCacheKeyHash {
+    size_t operator()(const PathCacheKey& key) const {
+      size_t start = (size_t)key.start.y * 1024 + key.start.x;
+      size_t goal = (size_t)key.goal.y * 1024 + key.goal.x;
+
+      return (start * 31 + goal) * 31 + key.frequency;
+    }
+  };
+
+  struct PathCacheEntry {
+    PathCacheKey key;
+    Path path;
+    // The tile of each path point. The points are moved out of walls, so they can be on a different tile.
+    std::vector<NodePoint> tiles;
+    SearchStats stats;
+    // The door and brick versions when the path was found.
+    u32 door_version;
+    u32 brick_version;
+  };
+
+  using PathCacheList = std::list<PathCacheEntry>;
+
+  struct ThreatLayer {
+    std::shared_ptr<const ThreatGrid> grid;
+    float weight = 0.0f;
+
+    inline bool IsActive() const { return grid && weight > 0.0f; }
+    inline float GetCost(NodePoint point) const {
+      return IsActive() ? weight * grid->GetThreat(point.x, point.y) : 0.0f;
+    }
   };
 
+  // Answers the search from the path cache or searches with the state. The path is cached with the versions that the
+  // state was taken at, so it's searched again once a door or brick changes.
+  Path FindCachedPath(const Map& map, const DynamicState& dynamic_state, u32 door_version, u32 brick_version,
+                      const Vector2f& from, const Vector2f& to, float radius, u16 frequency, SearchMode mode);
+  // Returns the copy of the map that requests search with, copying it again when the doors or bricks have changed.
+  std::shared_ptr<const MapSnapshot> GetRequestMap(const Map& map);
+
+  // The tile that each path point was built from is stored in tiles if it isn't null.
+  Path SearchPath(const Map& map, const DynamicState& dynamic_state, const Vector2f& from, const Vector2f& to,
+                  float radius, u16 frequency, SearchMode mode, const ThreatLayer& threat, SearchStats* stats,
+                  std::vector<NodePoint>* tiles);
+
+  std::unique_ptr<SearchState> AcquireSearchState();
+  void ReleaseSearchState(std::unique_ptr<SearchState> state);
+
+  bool IsCacheEntryValid(const PathCacheEntry& entry) const;
+  bool SpliceCachedPath(const Map& map, const DynamicState& dynamic_state, const PathCacheKey& key, Path* path,
+                        std::vector<NodePoint>* tiles);
+  void InsertCachedPath(const PathCacheKey& key, const Path& path, std::vector<NodePoint> tiles,
+                        const SearchStats& stats, u32 door_version, u32 brick_version);
+
+  // Searches from both ends at once. Sets one_way and returns an empty path if it reaches a dynamic tile.
+  Path SearchBidirectional(const Map& map, const DynamicState& dynamic_state, Node* start, Node* goal, float radius,
+                           u16 frequency, const ThreatLayer& threat, SearchStats* stats, std::vector<NodePoint>* tiles,
+                           bool* one_way);
+
+  // Searches forward while predicting the door state at the tick each tile is reached.
+  // Returns an empty path if doors can't be predicted or no path is found.
+  Path SearchTimeExpanded(const Map& map, const DynamicState& dynamic_state, Node* start, Node* goal, float radius,
+                          u16 frequency, const ThreatLayer& threat, SearchStats* stats, std::vector<NodePoint>* tiles);
+
+  void RunRequests();
+
+  // Gets the traversable node that a search should use for the position. Positions inside of walls use the tile that
+  // the position is leaning toward.
+  Node* GetSearchNode(const DynamicState& dynamic_state, const Vector2f& position);
+  // Checks if a search can move into the node with the doors and bricks of its state.
+  bool CanEnterNode(const DynamicState& dynamic_state, Node* node, NodePoint point, u16 frequency, bool* dynamic);
+  // Bumps the door version and marks the dynamic points as changed for everything that caches costs through them.
+  void InvalidateDynamicPoints();
+  // Bumps the brick version and marks the tiles as changed for everything that caches costs through them.
+  void InvalidateBricks(const std::vector<NodePoint>& points);
+
+  bool IsUniformNode(const DynamicState& dynamic_state, const Node* node, NodePoint point, EdgeSet edges) const;
+  bool IsForcedNeighbor(const DynamicState& dynamic_state, NodePoint point, size_t direction, size_t side_index) const;
+  JumpResult Jump(const DynamicState& dynamic_state, NodePoint from, size_t direction, const Node* goal);
+
   std::vector<Vector2f> path_;
   std::unique_ptr<NodeProcessor> processor_;
   RegionRegistry& regions_;
-  PriorityQueue<Node*, NodeCompare> openset_;
-  std::vector<Node*> touched_;
+  SearchMode search_mode_ = SearchMode::AStar;
+  SearchStats last_stats_;
+  std::unique_ptr<AbstractGraph> abstract_graph_;
+
+  // Guards the path cache, last search stats and search state pool so searches can run on multiple threads.
+  std::mutex mutex_;
+  std::mutex abstract_mutex_;
+
+  // The incremental planner is only used by one search at a time. Tile changes are collected under the path cache
+  // mutex and given to the planner when it next searches, so door and brick updates never wait on a search.
+  std::mutex incremental_mutex_;
+  std::unique_ptr<IncrementalPlanner> incremental_planner_;
+  std::vector<NodePoint> incremental_changes_;
+  // Changes are only collected once there's a planner to give them to.
+  bool incremental_active_ = false;
+  std::vector<std::unique_ptr<SearchState>> search_states_;
+
+  // The request threads are started on the first request and stopped when the pathfinder is destroyed.
+  std::mutex request_mutex_;
+  std::condition_variable request_convar_;
+  std::deque<PathRequestHandle> request_queue_;
+  std::vector<std::thread> request_threads_;
+  bool stop_requests_ = false;
+
+  // The newest copy of the map for requests. This is only used on the game thread.
+  std::shared_ptr<const MapSnapshot> request_map_;
+  const Map* request_map_source_ = nullptr;
+  u32 request_map_checksum_ = 0;
+  u32 request_map_door_version_ = 0;
+  u32 request_map_brick_version_ = 0;
+
+  struct DistanceFieldEntry {
+    std::unique_ptr<DistanceField> field;
+    u64 last_use = 0;
+  };
+
+  DoorSchedule door_schedule_;
+  DoorOverlayCache door_overlays_;
+  std::atomic<float> travel_speed_ = 0.0f;
+  // Guarded by mutex_. Each search copies it when it starts so the grid can be replaced while searches run.
+  ThreatLayer threat_layer_;
+
+  std::vector<DistanceFieldEntry> distance_fields_;
+  WallDistanceField wall_distances_;
+  u64 distance_field_uses_ = 0;
+
+  // The most recently used path is at the front of the list.
+  PathCacheList path_cache_;
+  std::unordered_map<PathCacheKey, PathCacheList::iterator, PathCacheKeyHash> path_cache_lookup_;
+  size_t path_cache_size_ = kDefaultPathCacheSize;
+  PathCacheStats path_cache_stats_;
+  // These are incremented when doors or bricks change so older cached paths can be discarded.
+  std::atomic<u32> door_version_ = 0;
+  std::atomic<u32> brick_version_ = 0;
 };
 
+inline const char* to_string(Pathfinder::SearchMode mode) {
+  const char* kModeNames[] = {"AStar", "JumpPoint", "Hierarchical", "Incremental", "Bidirectional", "TimeExpanded"};
+
+  static_assert(ZERO_ARRAY_SIZE(kModeNames) == (size_t)Pathfinder::SearchMode::Count);
+
+  if ((size_t)mode >= ZERO_ARRAY_SIZE(kModeNames)) return "Unknown";
+
+  return kModeNames[(size_t)mode];
+}
+
 }  // namespace path
 }  // namespace zero
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <zero/Types.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace zero {
+namespace path {
+
+template <typename T, typename Compare, typename Container = std::vector<T>>
+class PriorityQueue {
+ public:
+  using const_iterator = typename Container::const_iterator;
+
+  const_iterator begin() const { return container_.cbegin(); }
+  const_iterator end() const { return container_.cend(); }
+
+  void Push(T item) {
+    container_.push_back(item);
+    std::push_heap(container_.begin(), container_.end(), comparator_);
+  }
+
+  T Pop() {
+    T item = container_.front();
+    std::pop_heap(container_.begin(), container_.end(), comparator_);
+    container_.pop_back();
+    return item;
+  }
+
+  // sort from highest at beginning to lowest at end
+  void Update() { std::make_heap(container_.begin(), container_.end(), comparator_); }
+
+  void Clear() { container_.clear(); }
+  std::size_t Size() const { return container_.size(); }
+  bool Empty() const { return container_.empty(); }
+
+ private:
+  Container container_;
+  Compare comparator_;
+};
+
+// Binary heap that stores each item's position in the heap inside of the item.
+// This allows the priority of an item to be changed after it's pushed without rebuilding the entire heap.
+// HeapIndex is a functor that returns a reference to the u32 index stored in the item.
+template <typename T, typename Compare, typename HeapIndex>
+class IndexedPriorityQueue {
+ public:
+  static constexpr u32 kInvalidIndex = 0xFFFFFFFF;
+
+  void Push(T item) {
+    container_.push_back(item);
+    index_(item) = (u32)(container_.size() - 1);
+    SiftUp(container_.size() - 1);
+  }
+
+  T Pop() {
+    T item = container_.front();
+    T last = container_.back();
+
+    container_.pop_back();
+    index_(item) = kInvalidIndex;
+
+    if (!container_.empty()) {
+      container_[0] = last;
+      index_(last) = 0;
+      SiftDown(0);
+    }
+
+    return item;
+  }
+
+  // Returns the item with the highest priority without removing it. The queue must not be empty.
+  T Top() const { return container_[0]; }
+
+  // Moves the item toward the front after its priority was raised, such as lowering the cost of an A* node.
+  void Decrease(T item) { SiftUp(index_(item)); }
+
+  // Restores the heap order after the item's priority changed in either direction.
+  void Update(T item) {
+    SiftUp(index_(item));
+    SiftDown(index_(item));
+  }
+
+  void Clear() {
+    for (T item : container_) {
+      index_(item) = kInvalidIndex;
+    }
+
+    container_.clear();
+  }
+
+  std::size_t Size() const { return container_.size(); }
+  bool Empty() const { return container_.empty(); }
+
+ private:
+  void SiftUp(size_t index) {
+    T item = container_[index];
+
+    while (index > 0) {
+      size_t parent = (index - 1) / 2;
+
+      if (!comparator_(container_[parent], item)) break;
+
+      container_[index] = container_[parent];
+      index_(container_[index]) = (u32)index;
+      index = parent;
+    }
+
+    container_[index] = item;
+    index_(item) = (u32)index;
+  }
+
+  void SiftDown(size_t index) {
+    T item = container_[index];
+    size_t size = container_.size();
+
+    while (true) {
+      size_t child = index * 2 + 1;
+
+      if (child >= size) break;
+
+      // Pick the child with the highest priority.
+      if (child + 1 < size && comparator_(container_[child], container_[child + 1])) {
+        ++child;
+      }
+
+      if (!comparator_(item, container_[child])) break;
+
+      container_[index] = container_[child];
+      index_(container_[index]) = (u32)index;
+      index = child;
+    }
+
+    container_[index] = item;
+    index_(item) = (u32)index;
+  }
+
+  std::vector<T> container_;
+  Compare comparator_;
+  HeapIndex index_;
+};
+
+}  // namespace path
+}  // namespace zero
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <zero/Types.h>
+#include <zero/path/NodeProcessor.h>
+#include <zero/path/PriorityQueue.h>
+
+#include <vector>
+
+namespace zero {
+namespace path {
+
+enum SearchFlag {
+  SearchFlag_Openset = (1 << 0),
+  SearchFlag_Touched = (1 << 1),
+};
+
+// The data that a single search stores for a node.
+struct SearchNode {
+  u32 parent_id;
+
+  float g;
+  float f;
+
+  // The position of this node in the open set heap. This is only valid while SearchFlag_Openset is set.
+  u32 heap_index;
+  // The generation of the search that last reset this node.
+  u32 generation;
+
+  u8 flags;
+  // The ticks from the start of a time expanded search until the ship reaches this node. This fits in the padding after
+  // the flags, so it doesn't make the node larger.
+  u16 arrival;
+};
+
+// Holds the scratch data for one search over the graph, so multiple searches can run at the same time.
+// Nodes are indexed by their position in the processor's block storage, so only the allocated blocks take up space.
+// Nodes are stamped with the search generation when they are first reached. Starting a new search increments the
+// generation, which invalidates every node from the previous search without clearing the buffer.
+class SearchState {
+ public:
+  struct NodeCompare {
+    bool operator()(const SearchNode* lhs, const SearchNode* rhs) const { return lhs->f > rhs->f; }
+  };
+
+  struct NodeHeapIndex {
+    u32& operator()(SearchNode* node) const { return node->heap_index; }
+  };
+
+  using OpenSet = IndexedPriorityQueue<SearchNode*, NodeCompare, NodeHeapIndex>;
+
+  SearchState(size_t node_count) : nodes_(node_count) {}
+
+  void Begin() {
+    openset.Clear();
+
+    if (++generation_ == 0) {
+      // The generation wrapped around, so old stamps could match again.
+      for (SearchNode& node : nodes_) {
+        node.generation = 0;
+      }
+
+      generation_ = 1;
+    }
+  }
+
+  // Returns the search data for the node, resetting it if this search hasn't reached it yet.
+  inline SearchNode* GetNode(u32 index) {
+    SearchNode* node = &nodes_[index];
+
+    if (node->generation != generation_) {
+      node->parent_id = ~0;
+      node->g = node->f = 0.0f;
+      node->heap_index = OpenSet::kInvalidIndex;
+      node->generation = generation_;
+      node->flags = 0;
+      node->arrival = 0;
+    }
+
+    return node;
+  }
+
+  inline u32 GetIndex(const SearchNode* node) const { return (u32)(node - nodes_.data()); }
+  inline size_t GetNodeCount() const { return nodes_.size(); }
+
+  inline size_t GetMemoryUsage() const { return sizeof(*this) + nodes_.capacity() * sizeof(SearchNode); }
+
+  OpenSet openset;
+
+ private:
+  std::vector<SearchNode> nodes_;
+  u32 generation_ = 0;
+};
+
+}  // namespace path
+}  // namespace zero
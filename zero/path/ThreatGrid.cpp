@@ -0,0 +1,42 @@
+#include "ThreatGrid.h"
+
+#include <algorithm>
+
+namespace zero {
+namespace path {
+
+void ThreatGrid::Build(const InfluenceMap& influence) {
+  max_threat_ = 0.0f;
+
+  for (size_t cell_y = 0; cell_y < kCellsPerRow; ++cell_y) {
+    for (size_t cell_x = 0; cell_x < kCellsPerRow; ++cell_x) {
+      float threat = 0.0f;
+
+      for (size_t y = cell_y * kCellSize; y < (cell_y + 1) * kCellSize; ++y) {
+        const float* row = influence.tiles + y * 1024 + cell_x * kCellSize;
+
+        for (size_t x = 0; x < kCellSize; ++x) {
+          threat = std::max(threat, row[x]);
+        }
+      }
+
+      cells_[cell_y * kCellsPerRow + cell_x] = threat;
+      max_threat_ = std::max(max_threat_, threat);
+    }
+  }
+}
+
+float ThreatGrid::GetPathThreat(const Path& path, size_t index) const {
+  float threat = 0.0f;
+
+  for (size_t i = index; i < path.points.size(); ++i) {
+    const Vector2f& point = path.points[i];
+
+    threat = std::max(threat, GetThreat((u16)point.x, (u16)point.y));
+  }
+
+  return threat;
+}
+
+}  // namespace path
+}  // namespace zero
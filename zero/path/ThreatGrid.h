@@ -0,0 +1,43 @@
+#pragma once
+
+#include <zero/InfluenceMap.h>
+#include <zero/Types.h>
+#include <zero/path/Path.h>
+
+#include <vector>
+
+namespace zero {
+namespace path {
+
+// A coarse copy of the influence map that searches add to the cost of each tile they enter.
+// Each cell stores the highest threat of the tiles it covers, so searches only touch a small grid that stays in cache
+// instead of the full influence map.
+class ThreatGrid {
+ public:
+  static constexpr size_t kCellSize = 4;
+  static constexpr size_t kCellsPerRow = 1024 / kCellSize;
+
+  ThreatGrid() : cells_(kCellsPerRow * kCellsPerRow, 0.0f) {}
+
+  void Build(const InfluenceMap& influence);
+
+  inline float GetThreat(u16 x, u16 y) const {
+    if (x >= 1024 || y >= 1024) return 0.0f;
+
+    return cells_[(y / kCellSize) * kCellsPerRow + (x / kCellSize)];
+  }
+
+  // Returns the highest threat along the path from the point at the index to the goal.
+  float GetPathThreat(const Path& path, size_t index) const;
+
+  inline bool IsEmpty() const { return max_threat_ <= 0.0f; }
+
+  inline size_t GetMemoryUsage() const { return sizeof(*this) + cells_.capacity() * sizeof(float); }
+
+ private:
+  std::vector<float> cells_;
+  float max_threat_ = 0.0f;
+};
+
+}  // namespace path
+}  // namespace zero
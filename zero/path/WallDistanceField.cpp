@@ -0,0 +1,139 @@
+#include "WallDistanceField.h"
+
+#include <zero/game/Map.h>
+//
+#include <emmintrin.h>
+#include <math.h>
+
+#include <limits>
+
+namespace zero {
+namespace path {
+
+// The row pass includes a solid tile on each side of the map.
+constexpr s32 kPaddedSize = 1024 + 2;
+
+// Finds the squared distance to the closest solid tile in each row using the lower envelope of the parabolas that
+// are centered on each tile with the column distance as their height.
+static void TransformRow(const s32* f, s32* output, s32* v, float* z) {
+  s32 k = 0;
+
+  v[0] = 0;
+  z[0] = -std::numeric_limits<float>::max();
+  z[1] = std::numeric_limits<float>::max();
+
+  for (s32 q = 1; q < kPaddedSize; ++q) {
+    float s = 0.0f;
+
+    while (true) {
+      s32 p = v[k];
+
+      s = ((f[q] + q * q) - (f[p] + p * p)) / (float)(2 * q - 2 * p);
+
+      if (s > z[k]) break;
+
+      --k;
+    }
+
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = std::numeric_limits<float>::max();
+  }
+
+  k = 0;
+
+  for (s32 q = 1; q < kPaddedSize - 1; ++q) {
+    while (z[k + 1] < q) {
+      ++k;
+    }
+
+    s32 dx = q - v[k];
+
+    output[q - 1] = dx * dx + f[v[k]];
+  }
+}
+
+void WallDistanceField::Build(const Map& map) {
+  // The vertical distance to the closest solid tile in the same column.
+  // These are processed a full row at a time so eight columns can be updated together.
+  std::vector<u16> columns((size_t)1024 * 1024);
+
+  const __m128i kOne = _mm_set1_epi16(1);
+  __m128i* previous = nullptr;
+
+  for (u16 y = 0; y < 1024; ++y) {
+    u16* row = columns.data() + (size_t)y * 1024;
+
+    // Store a mask of the empty tiles in the row first, then combine it with the row above.
+    for (u16 x = 0; x < 1024; ++x) {
+      row[x] = map.IsSolidEmptyDoors(x, y, 0xFFFF) ? 0 : 0xFFFF;
+    }
+
+    __m128i* current = (__m128i*)row;
+
+    for (size_t i = 0; i < 1024 / 8; ++i) {
+      __m128i mask = _mm_loadu_si128(current + i);
+      // The row above the map is solid.
+      __m128i above = previous ? _mm_loadu_si128(previous + i) : _mm_setzero_si128();
+
+      _mm_storeu_si128(current + i, _mm_and_si128(mask, _mm_add_epi16(above, kOne)));
+    }
+
+    previous = current;
+  }
+
+  // Sweep back up so the solid tiles below are considered. The row below the map is solid.
+  __m128i* below = nullptr;
+
+  for (s32 y = 1023; y >= 0; --y) {
+    __m128i* current = (__m128i*)(columns.data() + (size_t)y * 1024);
+
+    for (size_t i = 0; i < 1024 / 8; ++i) {
+      __m128i value = _mm_loadu_si128(current + i);
+      __m128i next = below ? _mm_loadu_si128(below + i) : _mm_setzero_si128();
+
+      _mm_storeu_si128(current + i, _mm_min_epi16(value, _mm_add_epi16(next, kOne)));
+    }
+
+    below = current;
+  }
+
+  distances_.resize((size_t)1024 * 1024);
+
+  s32 f[kPaddedSize];
+  s32 output[1024];
+  s32 v[kPaddedSize];
+  float z[kPaddedSize + 1];
+
+  f[0] = 0;
+  f[kPaddedSize - 1] = 0;
+
+  for (size_t y = 0; y < 1024; ++y) {
+    const u16* row = columns.data() + y * 1024;
+
+    for (size_t x = 0; x < 1024; ++x) {
+      s32 distance = row[x];
+      f[x + 1] = distance * distance;
+    }
+
+    TransformRow(f, output, v, z);
+
+    float* distances = distances_.data() + y * 1024;
+
+    for (size_t x = 0; x < 1024; ++x) {
+      distances[x] = sqrtf((float)output[x]);
+    }
+  }
+
+  map_checksum_ = map.checksum;
+}
+
+void WallDistanceField::Clear() {
+  distances_.clear();
+  distances_.shrink_to_fit();
+  map_checksum_ = 0;
+}
+
+}  // namespace path
+}  // namespace zero
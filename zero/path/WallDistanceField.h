@@ -0,0 +1,41 @@
+#pragma once
+
+#include <zero/Math.h>
+#include <zero/Types.h>
+
+#include <vector>
+
+namespace zero {
+
+struct Map;
+
+namespace path {
+
+// Stores the exact euclidean distance from every tile to the closest solid tile.
+// Doors are treated as empty and anything outside of the map is treated as solid.
+// This is computed once per map with a separable distance transform, so it can be queried for any radius.
+class WallDistanceField {
+ public:
+  void Build(const Map& map);
+  void Clear();
+
+  // Returns the distance to the closest wall. Solid tiles have a distance of zero.
+  inline float GetDistance(u16 x, u16 y) const {
+    if (x >= 1024 || y >= 1024 || distances_.empty()) return 0.0f;
+
+    return distances_[(size_t)y * 1024 + x];
+  }
+
+  inline float GetDistance(const Vector2f& position) const { return GetDistance((u16)position.x, (u16)position.y); }
+
+  inline bool IsBuilt() const { return !distances_.empty(); }
+  inline u32 GetMapChecksum() const { return map_checksum_; }
+  inline size_t GetMemoryUsage() const { return sizeof(*this) + distances_.capacity() * sizeof(float); }
+
+ private:
+  std::vector<float> distances_;
+  u32 map_checksum_ = 0;
+};
+
+}  // namespace path
+}  // namespace zero
@@ -54,7 +54,8 @@ struct ZoneController : EventHandler<ZeroBot::JoinRequestEvent>,
     }
 
     // Update the pathfinder before we create our behaviors so we can use that data to make decisions.
-    bot->bot_controller->UpdatePathfinder(radius);
+    // This waits for the graph to finish building since the behaviors can't be created without it.
+    bot->bot_controller->UpdatePathfinder(radius, true);
 
     bot->commands->Reset();
     CreateBehaviors(event.name);
@@ -9,23 +9,27 @@ namespace deva {
 
 void BaseManager::HandleEvent(const RegionBuildEvent& event) {
   base_points.clear();
+
+  auto& map = bot.bot_controller->game.GetMap();
+
+  for (const RegionDescriptor& descriptor : event.registry.GetDescriptors()) {
+    descriptor.ForEachTile([&](MapCoord coord) { AddSpawnTile(map, descriptor.index, coord); });
+  }
 }
 
-void BaseManager::HandleEvent(const RegionTileAddEvent& event) {
+void BaseManager::AddSpawnTile(const Map& map, RegionIndex region_index, MapCoord coord) {
   Rectangle center_rect = Rectangle::FromPositionRadius(Vector2f(512, 512), 64.0f);
 
-  Vector2f coord_center(event.coord.x + 0.5f, event.coord.y + 0.5f);
+  Vector2f coord_center(coord.x + 0.5f, coord.y + 0.5f);
 
   if (center_rect.Contains(coord_center)) return;
 
-  auto& map = bot.bot_controller->game.GetMap();
-
-  if (map.GetTileId(event.coord.x, event.coord.y) == kTileIdSafe) {
+  if (map.GetTileId(coord.x, coord.y) == kTileIdSafe) {
     MapCoord surrounding[] = {
-        MapCoord(event.coord.x - 1, event.coord.y),
-        MapCoord(event.coord.x + 1, event.coord.y),
-        MapCoord(event.coord.x, event.coord.y - 1),
-        MapCoord(event.coord.x, event.coord.y + 1),
+        MapCoord(coord.x - 1, coord.y),
+        MapCoord(coord.x + 1, coord.y),
+        MapCoord(coord.x, coord.y - 1),
+        MapCoord(coord.x, coord.y + 1),
     };
 
     // Check if there are safe tiles around this coord and mark it as this region's base spawn point.
@@ -35,17 +39,17 @@ void BaseManager::HandleEvent(const RegionTileAddEvent& event) {
       }
     }
 
-    auto iter = base_points.find(event.region_index);
+    auto iter = base_points.find(region_index);
 
     if (iter == base_points.end()) {
-      BasePoints points = {event.coord, {}};
-      base_points[event.region_index] = points;
+      BasePoints points = {coord, {}};
+      base_points[region_index] = points;
     } else {
       if (iter->second.second.x != 0 || iter->second.second.y != 0) {
-        Log(LogLevel::Warning, "Found too many base spawns at %d, %d", (s32)event.coord.x, (s32)event.coord.y);
+        Log(LogLevel::Warning, "Found too many base spawns at %d, %d", (s32)coord.x, (s32)coord.y);
       }
 
-      iter->second.second = event.coord;
+      iter->second.second = coord;
     }
   }
 }
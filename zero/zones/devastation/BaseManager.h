@@ -25,8 +25,7 @@ struct BaseInfo {
   BaseInfo() : region(kUndefinedRegion) {}
 };
 
-struct BaseManager : EventHandler<RegionTileAddEvent>,
-                     EventHandler<RegionBuildEvent>,
+struct BaseManager : EventHandler<RegionBuildEvent>,
                      EventHandler<TeleportEvent>,
                      EventHandler<PlayerAttachEvent>,
                      EventHandler<PlayerFreqAndShipChangeEvent> {
@@ -43,13 +42,13 @@ struct BaseManager : EventHandler<RegionTileAddEvent>,
   }
 
   void HandleEvent(const RegionBuildEvent& event) override;
-  void HandleEvent(const RegionTileAddEvent& event) override;
   void HandleEvent(const TeleportEvent& event) override;
   void HandleEvent(const PlayerAttachEvent& event) override;
   void HandleEvent(const PlayerFreqAndShipChangeEvent& event) override;
 
  private:
   void UpdateActiveBase(const Vector2f& position);
+  void AddSpawnTile(const Map& map, RegionIndex region_index, MapCoord coord);
 
   ZeroBot& bot;
 
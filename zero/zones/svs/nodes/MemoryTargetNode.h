@@ -20,7 +20,7 @@ struct NearestMemoryTargetNode : public behavior::BehaviorNode {
     Player* self = ctx.bot->game->player_manager.GetSelf();
     if (!self) return behavior::ExecuteResult::Failure;
 
-    Player* nearest = GetNearestTarget(*ctx.bot->game, *self, *ctx.bot->bot_controller->region_registry);
+    Player* nearest = GetNearestTarget(*ctx.bot, *self, *ctx.bot->bot_controller->region_registry);
 
     if (!nearest) return behavior::ExecuteResult::Failure;
 
@@ -30,9 +30,10 @@ struct NearestMemoryTargetNode : public behavior::BehaviorNode {
   }
 
  private:
-  Player* GetNearestTarget(Game& game, Player& self, RegionRegistry& region_registry) {
-    Player* best_target = nullptr;
-    float closest_dist_sq = std::numeric_limits<float>::max();
+  Player* GetNearestTarget(ZeroBot& bot, Player& self, RegionRegistry& region_registry) {
+    Game& game = *bot.game;
+    std::vector<Player*> targets;
+    std::vector<Vector2f> positions;
 
     for (size_t i = 0; i < game.player_manager.player_count; ++i) {
       Player* player = game.player_manager.players + i;
@@ -49,14 +50,13 @@ struct NearestMemoryTargetNode : public behavior::BehaviorNode {
 
       if (obey_stealth && !behavior::NearestTargetNode::IsVisible(game.connection.settings, self, *player)) continue;
 
-      float dist_sq = player->position.DistanceSq(self.position);
-      if (dist_sq < closest_dist_sq) {
-        closest_dist_sq = dist_sq;
-        best_target = player;
-      }
+      targets.push_back(player);
+      positions.push_back(player->position);
     }
 
-    return best_target;
+    int nearest_index = behavior::GetNearestByPath(bot, self, positions);
+
+    return nearest_index >= 0 ? targets[nearest_index] : nullptr;
   }
 
   inline bool IsSynchronized(Game& game, Player& player) {
@@ -216,9 +216,9 @@ void TwController::CreateFlagroomBitset() {
   constexpr s32 kMaxFlagroomDoorTraverse = 2;
   constexpr s32 kCorridorInclusion = 6;
 
-  // Open the doors in the pathfinder so the dynamic edge sets don't consider the doors to be dynamic.
-  auto old_door_method = pathfinder.GetProcessor().GetDoorSolidMethod();
-  pathfinder.GetProcessor().SetDoorSolidMethod(path::DoorSolidMethod::AlwaysOpen);
+  // Open the doors in a copy of the door state so the dynamic edge sets don't consider the doors to be dynamic.
+  path::DynamicState open_doors = *pathfinder.GetProcessor().GetDynamicState();
+  open_doors.door_method = path::DoorSolidMethod::AlwaysOpen;
 
   while (!stack.empty()) {
     VisitState current = stack.front();
@@ -283,8 +283,7 @@ void TwController::CreateFlagroomBitset() {
     MapCoord north(coord.x, coord.y - 1);
     MapCoord south(coord.x, coord.y + 1);
 
-    path::EdgeSet edgeset = pathfinder.GetProcessor().FindEdges(
-        pathfinder.GetProcessor().GetNode(path::NodePoint(coord.x, coord.y)), kShipRadius);
+    path::EdgeSet edgeset = pathfinder.GetProcessor().FindEdges(path::NodePoint(coord.x, coord.y), open_doors);
 
     if (edgeset.IsSet(path::CoordOffset::WestIndex()) && !visited(west)) {
       stack.emplace_back(west, current.depth + 1, door_traverse_count, current.corridor_count);
@@ -307,8 +306,6 @@ void TwController::CreateFlagroomBitset() {
     }
   }
 
-  pathfinder.GetProcessor().SetDoorSolidMethod(old_door_method);
-
 #if TW_RENDER_FR
   Log(LogLevel::Debug, "TrenchWars: Flag room position count: %zu", tw->fr_positions.size());
 #endif
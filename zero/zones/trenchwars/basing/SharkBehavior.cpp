@@ -340,7 +340,7 @@ static std::unique_ptr<behavior::BehaviorNode> CreateFlagroomTravelBehavior() {
                     .End()
                 .Sequence() // Go directly to the flag room if we aren't there.
                     .InvertChild<InFlagroomNode>("self_position")
-                    .Child<GoToNode>("tw_flag_position")
+                    .Child<GoToNode>("tw_flag_position", PathQueryType::DistanceField)
                     .Child<RenderPathNode>(Vector3f(0.0f, 1.0f, 0.5f))
                     .End()
     #if 0 // TODO: Enable this once a smarter version is created. As it is, sharks will just circle around it not attacking each other.
@@ -491,7 +491,7 @@ static std::unique_ptr<behavior::BehaviorNode> CreateEntranceBehavior() {
                     .End()
                 .Sequence()
                     .InvertChild<ShipTraverseQueryNode>("tw_entrance_position")
-                    .Child<GoToNode>("tw_entrance_position")
+                    .Child<GoToNode>("tw_entrance_position", PathQueryType::DistanceField)
                     .Child<RenderPathNode>(Vector3f(1.0f, 0.0f, 0.0f))
                     .End()
                 .Child<ArriveNode>("tw_entrance_position", 1.25f)
@@ -526,7 +526,7 @@ static std::unique_ptr<behavior::BehaviorNode> CreateEntranceWaitBehavior() {
             .Child<GoToNode>(east_position)
             .End()
         .Sequence()
-            .Child<GoToNode>("tw_entrance_position")
+            .Child<GoToNode>("tw_entrance_position", PathQueryType::DistanceField)
             .End()
         .End();
   // clang-format on
@@ -580,7 +580,7 @@ static std::unique_ptr<behavior::BehaviorNode> CreateBelowEntranceBehavior() {
                     .End()
                 .Child<EmptyEntranceNode>()
                 .Child<SafeRectNode>(kEntranceBottomShaftRect, kDangerousEntranceDamage)
-                .Child<GoToNode>("tw_entrance_position") // Move into entrance area so other tree takes over.
+                .Child<GoToNode>("tw_entrance_position", PathQueryType::DistanceField) // Move into entrance area so other tree takes over.
                 .End()
             .Selector(CompositeDecorator::Success) // Above area is not yet safe, stay below and dodge.
                 .Child<DodgeIncomingDamage>(0.1f, 15.0f, 0.0f)
@@ -609,7 +609,7 @@ static std::unique_ptr<behavior::BehaviorNode> CreateFlagroomTravelBehavior() {
             .InvertChild<InFlagroomNode>("self_position")
             .Child<AfterburnerThresholdNode>(0.5f, 0.95f)
             .End()
-        .Child<GoToNode>("tw_flag_position")
+        .Child<GoToNode>("tw_flag_position", PathQueryType::DistanceField)
         .Child<RenderPathNode>(Vector3f(1, 0, 0))
         .End();
   // clang-format on
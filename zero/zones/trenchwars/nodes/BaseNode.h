@@ -4,6 +4,7 @@
 #include <zero/ZeroBot.h>
 #include <zero/behavior/BehaviorBuilder.h>
 #include <zero/behavior/BehaviorTree.h>
+#include <zero/behavior/nodes/TargetNode.h>
 #include <zero/zones/trenchwars/TrenchWars.h>
 
 namespace zero {
@@ -41,7 +42,7 @@ inline FlagroomQuadrantRegion GetQuadrantRegion(Vector2f center, Vector2f positi
 }
 
 // Find an enemy in the base while traveling.
-// This will only find enemies that are within our direct view.
+// This will only find enemies that are within our direct view. The closest one by path is chosen.
 struct FindBaseEnemyNode : public behavior::BehaviorNode {
   FindBaseEnemyNode(const char* output_key) : output_key(output_key) {}
 
@@ -59,8 +60,8 @@ struct FindBaseEnemyNode : public behavior::BehaviorNode {
     // fighting people on the side.
     constexpr float kSearchX = 40.0f;
 
-    Player* nearest_player = nullptr;
-    float best_dist_sq = 1024.0f * 1024.0f;
+    std::vector<Player*> targets;
+    std::vector<Vector2f> positions;
 
     for (size_t i = 0; i < pm.player_count; ++i) {
       Player* player = pm.players + i;
@@ -73,19 +74,18 @@ struct FindBaseEnemyNode : public behavior::BehaviorNode {
       if (player->position == Vector2f(0, 0)) continue;
       if (!pm.IsSynchronized(*player)) continue;
 
-      float dist_sq = self->position.DistanceSq(player->position);
-      if (dist_sq > best_dist_sq) continue;
-
       CastResult result = ctx.bot->game->GetMap().CastShip(self, radius, player->position);
       if (result.hit) continue;
 
-      nearest_player = player;
-      best_dist_sq = dist_sq;
+      targets.push_back(player);
+      positions.push_back(player->position);
     }
 
-    if (nearest_player == nullptr) return behavior::ExecuteResult::Failure;
+    int nearest_index = behavior::GetNearestByPath(*ctx.bot, *self, positions);
+
+    if (nearest_index < 0) return behavior::ExecuteResult::Failure;
 
-    ctx.blackboard.Set<Player*>(output_key, nearest_player);
+    ctx.blackboard.Set<Player*>(output_key, targets[nearest_index]);
 
     return behavior::ExecuteResult::Success;
   }
@@ -38,26 +38,22 @@ std::unique_ptr<behavior::BehaviorNode> SoloBehavior::CreateTree(behavior::Execu
             auto& processor = pathfinder.GetProcessor();
             
             auto pos = self->position;
-            const float kShipRadius = 14.0f / 16.0f;
             const u16 radius = 30;
 
             //processor.SetDoorSolidMethod(path::DoorSolidMethod::AlwaysSolid);
+            auto dynamic_state = processor.GetDynamicState();
 
             for (u16 y = pos.y - radius; y < pos.y + radius; ++y) {
               for (u16 x = pos.x - radius; x < pos.x + radius; ++x) {
-                auto node = processor.GetNode(path::NodePoint(x, y));
-                path::EdgeSet set = processor.FindEdges(node, kShipRadius);
+                path::EdgeSet set = processor.FindEdges(path::NodePoint(x, y), *dynamic_state);
 
-                //processor.UpdateDynamicNode(node, kShipRadius, 0xFFFF);
                 Vector2f start(x + 0.5f, y + 0.5f);
                 Vector3f color(0, 1, 0);
 
                 for (size_t i = 0; i < 4; ++i) {
                   path::CoordOffset offset = path::CoordOffset::FromIndex(i);
-                  auto other_node = processor.GetNode(path::NodePoint(x + offset.x, y + offset.y));
-                  path::EdgeSet other_set = processor.FindEdges(other_node, kShipRadius);
-
-                  processor.UpdateDynamicNode(other_node, kShipRadius, 0xFFFF);
+                  path::EdgeSet other_set =
+                      processor.FindEdges(path::NodePoint(x + offset.x, y + offset.y), *dynamic_state);
 
                   size_t opposite_i = i ^ 1;
 